@@ -1,5 +1,6 @@
 #include "work_functions.hpp"
 
+#include <cmath>
 #include <filesystem>
 #include <fstream>
 #include <map>
@@ -11,8 +12,12 @@
 #include "daltools/common/konst.h"
 #include "daltools/dmd/exporter.h"
 #include "daltools/dmd/parser.h"
+#include "daltools/dmd/view.h"
 #include "daltools/json/parser.h"
+#include "daltools/scene/bvh.h"
+#include "daltools/scene/collision.h"
 #include "daltools/scene/modifier.h"
+#include "daltools/scene/tiling.h"
 
 
 namespace {
@@ -53,8 +58,263 @@ namespace {
         throw std::runtime_error{ "Invalid compression method: " + str };
     }
 
+    struct CompileConfig {
+        dal::parser::SceneOptimizeOptions optimize_;
+        dal::parser::ModelExportConfig export_;
+        bool optimize_vertex_cache_ = true;
+        // Off by default since only newer readers understand these sections
+        std::optional<dal::parser::LodOptions> lods_;
+        std::optional<dal::parser::MeshletOptions> meshlets_;
+        // Applied to every indexed unit
+        std::optional<dal::parser::VertexFormat> vertex_format_;
+        std::optional<dal::parser::SkinFormatOptions> skin_format_;
+        std::optional<dal::parser::BvhOptions> bvh_;
+        dal::parser::ModelConvertOptions convert_;
+        // Written to a .dcol file next to the .dmd
+        std::optional<dal::parser::CollisionOptions> collision_;
+        // Also write a zero copy .dmdv next to the .dmd
+        bool model_view_ = false;
+        // One DMD per tile and an index instead of one DMD
+        std::optional<dal::parser::TilingOptions> tiling_;
+    };
+
+    dal::parser::CollisionShape interpret_collision_shape(
+        const std::string& str
+    ) {
+        using Shape = dal::parser::CollisionShape;
+        if ("hull" == str)
+            return Shape::convex_hull;
+        else if ("decomp" == str)
+            return Shape::convex_decomposition;
+        else if ("trimesh" == str)
+            return Shape::trimesh;
+
+        throw std::runtime_error{ "Invalid collision shape: " + str };
+    }
+
+    // Written as `!(x > 0)` so that NaN is rejected too
+    float interpret_tile_size(const float size) {
+        if (!(size > 0))
+            throw std::runtime_error{
+                "Tile size must be positive: " + std::to_string(size)
+            };
+        return size;
+    }
+
+    size_t calc_skin_size(const dal::parser::VertexFormat& format) {
+        using Format = dal::parser::VertexFormat;
+
+        size_t index_size = 4;
+        if (Format::JointIndex::uint8 == format.joint_index_)
+            index_size = 1;
+        else if (Format::JointIndex::uint16 == format.joint_index_)
+            index_size = 2;
+
+        size_t weight_size = 4;
+        if (Format::JointWeight::unorm8 == format.joint_weight_)
+            weight_size = 1;
+        else if (Format::JointWeight::unorm16 == format.joint_weight_)
+            weight_size = 2;
+
+        return format.influences_ * (index_size + weight_size);
+    }
+
+
+    // Writes `output_path` and optional sidecar files next to it
+    void compile_scene(
+        const dal::parser::SceneIntermediate& scene,
+        const std::filesystem::path& output_path,
+        const ::CompileConfig& config
+    ) {
+        using namespace dal::parser;
+
+        const auto label = output_path.filename().u8string();
+        auto model = convert_to_model_dmd(scene, config.convert_);
+
+        if (config.convert_.instancing_.has_value()) {
+            size_t unit_count = 0, instance_count = 0;
+            for (auto& unit : model.units_indexed_) {
+                if (unit.instances_.empty())
+                    continue;
+                ++unit_count;
+                instance_count += unit.instances_.size();
+            }
+            fmt::print(
+                "{}: {} instanced units with {} instances\n",
+                label,
+                unit_count,
+                instance_count
+            );
+        }
+
+        if (config.export_.compact_indices_)
+            split_large_units(model);
+
+        if (config.optimize_vertex_cache_) {
+            const auto report = optimize_vertex_cache(
+                model, config.optimize_.thread_count_
+            );
+            fmt::print(
+                "{}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}\n",
+                label,
+                report.before_.acmr(),
+                report.after_.acmr(),
+                report.before_.atvr(),
+                report.after_.atvr()
+            );
+        }
+
+        if (config.lods_.has_value()) {
+            generate_lods(
+                model, config.lods_.value(), config.optimize_.thread_count_
+            );
+        }
+
+        // Vertices follow the triangle order from above
+        const auto cleanup = cleanup_meshes(
+            model, config.optimize_.thread_count_
+        );
+        fmt::print(
+            "{}: removed {} degenerate, {} duplicate triangles, {} vertices\n",
+            label,
+            cleanup.degenerate_triangles_,
+            cleanup.duplicate_triangles_,
+            cleanup.unused_vertices_
+        );
+
+        if (config.meshlets_.has_value()) {
+            build_meshlets(
+                model, config.meshlets_.value(), config.optimize_.thread_count_
+            );
+        }
+
+        // Units were split and trimmed since conversion
+        compute_bounds(model, config.optimize_.thread_count_);
+
+        if (config.vertex_format_.has_value()) {
+            for (auto& unit : model.units_indexed_)
+                unit.mesh_.vertex_format_ = config.vertex_format_.value();
+            for (auto& unit : model.units_indexed_joint_)
+                unit.mesh_.vertex_format_ = config.vertex_format_.value();
+
+            const auto error = measure_quantization_error(model);
+            fmt::print(
+                "{}: quantization error pos {:.6f}, normal {:.4f} deg, "
+                "uv {:.6f}\n",
+                label,
+                error.pos_,
+                error.normal_deg_,
+                error.uv_
+            );
+        }
+
+        // After the vertex format above since that overwrites skin fields
+        if (config.skin_format_.has_value()) {
+            size_t before = 0, after = 0;
+            for (auto& unit : model.units_indexed_joint_) {
+                const auto vert_count = unit.mesh_.vertices_.size();
+                before += vert_count * ::calc_skin_size(VertexFormat{});
+            }
+            select_skin_format(
+                model,
+                config.skin_format_.value(),
+                config.optimize_.thread_count_
+            );
+            for (auto& unit : model.units_indexed_joint_) {
+                const auto vert_count = unit.mesh_.vertices_.size();
+                after += vert_count *
+                         ::calc_skin_size(unit.mesh_.vertex_format_);
+            }
+            fmt::print(
+                "{}: skin data {} -> {} bytes\n",
+                label,
+                before,
+                after
+            );
+        }
+
+        if (config.bvh_.has_value()) {
+            auto options = config.bvh_.value();
+            // Readers may decode quantized positions, so stay conservative
+            if (config.vertex_format_.has_value())
+                options.margin_ = measure_quantization_error(model).pos_;
+
+            model.bvh_ = build_bvh(model, options);
+            fmt::print(
+                "{}: BVH with {} nodes over {} triangles\n",
+                label,
+                model.bvh_.nodes_.size(),
+                model.bvh_.triangles_.size()
+            );
+        }
+
+        const auto bin_built = build_binary_model(model, config.export_);
+
+        std::ofstream file(output_path.u8string().c_str(), std::ios::binary);
+        file.write((const char*)bin_built->data(), bin_built->size());
+        file.close();
+
+        if (config.model_view_) {
+            const auto view_built = build_binary_model_view(
+                model, config.export_.compact_indices_
+            );
+            if (view_built.has_value()) {
+                auto view_path = output_path;
+                view_path.replace_extension("dmdv");
+                std::ofstream view_file(
+                    view_path.u8string().c_str(), std::ios::binary
+                );
+                view_file.write(
+                    (const char*)view_built->data(), view_built->size()
+                );
+                view_file.close();
+            } else {
+                fmt::print(
+                    "{}: no .dmdv since only static indexed models fit it\n",
+                    label
+                );
+            }
+        }
+
+        if (config.collision_.has_value()) {
+            const auto collision = build_collision(
+                scene,
+                config.collision_.value(),
+                config.optimize_.thread_count_
+            );
+            const auto col_built = build_binary_collision(
+                collision, config.export_.comp_method_
+            );
+
+            size_t hull_count = 0, trimesh_count = 0;
+            for (auto& mesh : collision.meshes_) {
+                hull_count += mesh.hulls_.size();
+                if (!mesh.trimesh_.empty())
+                    ++trimesh_count;
+            }
+            fmt::print(
+                "{}: collision of {} meshes with {} hulls and {} trimeshes, "
+                "{} bytes\n",
+                label,
+                collision.meshes_.size(),
+                hull_count,
+                trimesh_count,
+                col_built->size()
+            );
+
+            auto col_path = output_path;
+            col_path.replace_extension("dcol");
+            std::ofstream col_file(
+                col_path.u8string().c_str(), std::ios::binary
+            );
+            col_file.write((const char*)col_built->data(), col_built->size());
+            col_file.close();
+        }
+    }
+
+
     void do_file(
-        const std::filesystem::path& src_path, dal::CompressMethod comp_method
+        const std::filesystem::path& src_path, const ::CompileConfig& config
     ) {
         using namespace dal::parser;
 
@@ -74,18 +334,37 @@ namespace {
         for (auto& scene : scenes) {
             flip_uv_vertically(scene);
             clear_collection_info(scene);
-            optimize_scene(scene, src_path);
+            optimize_scene(scene, src_path, config.optimize_);
         }
 
-        const auto model = convert_to_model_dmd(scenes.at(0));
-        const auto bin_built = build_binary_model(model, comp_method);
+        if (!config.tiling_.has_value()) {
+            std::filesystem::path output_path = src_path;
+            output_path.replace_extension("dmd");
+            ::compile_scene(scenes.at(0), output_path, config);
+            return;
+        }
 
-        std::filesystem::path output_path = src_path;
-        output_path.replace_extension("dmd");
+        auto tiles = split_into_tiles(scenes.at(0), config.tiling_.value());
+        const auto stem = src_path.stem().u8string();
+        for (size_t i = 0; i < tiles.scenes_.size(); ++i) {
+            auto& tile = tiles.index_.tiles_[i];
+            tile.file_name_ = stem + '_' + tile.name_ + ".dmd";
+            const auto tile_path = src_path.parent_path() / tile.file_name_;
+            ::compile_scene(tiles.scenes_[i], tile_path, config);
+        }
 
-        std::ofstream file(output_path.u8string().c_str(), std::ios::binary);
-        file.write((const char*)bin_built->data(), bin_built->size());
-        file.close();
+        auto index_path = src_path;
+        index_path.replace_extension("tiles.json");
+        const auto index_json = build_tile_index_json(tiles.index_);
+        std::ofstream index_file(index_path.u8string().c_str());
+        index_file << index_json;
+        index_file.close();
+
+        fmt::print(
+            "{}: {} tiles\n",
+            index_path.filename().u8string(),
+            tiles.scenes_.size()
+        );
     }
 
 }  // namespace
@@ -99,17 +378,246 @@ namespace dal {
         parser.add_argument("-c", "--compress")
             .help("Select compression method (0: none, 1: zip, 2: brotli)")
             .default_value("2");
+        parser.add_argument("--weld")
+            .help("Weld vertices closer than this distance (off by default)")
+            .scan<'g', float>();
+        parser.add_argument("--weld-normal")
+            .help("Max normal difference of welded vertices")
+            .scan<'g', float>();
+        parser.add_argument("--weld-uv")
+            .help("Max uv difference of welded vertices")
+            .scan<'g', float>();
+        parser.add_argument("--weld-weight")
+            .help("Max joint weight difference of welded vertices")
+            .scan<'g', float>();
+        parser.add_argument("-j", "--threads")
+            .help("Number of threads for per-mesh passes (0: all cores)")
+            .default_value(0u)
+            .scan<'u', uint32_t>();
+        parser.add_argument("--no-vertex-cache")
+            .help("Keep the original triangle order")
+            .default_value(false)
+            .implicit_value(true);
+        parser.add_argument("--lods")
+            .help("Number of LODs to generate, each with half the triangles")
+            .default_value(0u)
+            .scan<'u', uint32_t>();
+        parser.add_argument("--lod-error")
+            .help("Max LOD error relative to the mesh size")
+            .scan<'g', float>();
+        parser.add_argument("--meshlets")
+            .help("Build meshlets for per-cluster culling")
+            .default_value(false)
+            .implicit_value(true);
+        parser.add_argument("--meshlet-vertices")
+            .help("Max vertices per meshlet")
+            .default_value(64u)
+            .scan<'u', uint32_t>();
+        parser.add_argument("--meshlet-triangles")
+            .help("Max triangles per meshlet")
+            .default_value(124u)
+            .scan<'u', uint32_t>();
+        parser.add_argument("--index16")
+            .help("Write 16-bit indices, splitting units that don't fit")
+            .default_value(false)
+            .implicit_value(true);
+        parser.add_argument("--unit-bounds")
+            .help("Store per-unit bounds, which needs readers of DMD sections")
+            .default_value(false)
+            .implicit_value(true);
+        parser.add_argument("--toc")
+            .help("Compress DMD sections separately for selective loading")
+            .default_value(false)
+            .implicit_value(true);
+        parser.add_argument("--block-size")
+            .help("Compress in blocks of this many MiB to unzip in parallel")
+            .scan<'u', uint32_t>();
+        parser.add_argument("--quantize")
+            .help("Store 16-bit positions and UVs, and octahedral normals")
+            .default_value(false)
+            .implicit_value(true);
+        parser.add_argument("--quantize-uv16")
+            .help("With --quantize, normalized UVs instead of half floats")
+            .default_value(false)
+            .implicit_value(true);
+        parser.add_argument("--skin-format")
+            .help("Pick the smallest joint encodings for each skinned unit")
+            .default_value(false)
+            .implicit_value(true);
+        parser.add_argument("--skin-weight-error")
+            .help("Max joint weight error with --skin-format")
+            .scan<'g', float>();
+        parser.add_argument("--bvh")
+            .help("Store a ray query hierarchy over indexed units")
+            .default_value(false)
+            .implicit_value(true);
+        parser.add_argument("--bvh-leaf-size")
+            .help("Max triangles per BVH leaf")
+            .default_value(4u)
+            .scan<'u', uint32_t>();
+        parser.add_argument("--instancing")
+            .help("Store meshes placed several times once with transforms")
+            .default_value(false)
+            .implicit_value(true);
+        parser.add_argument("--instance-min")
+            .help("Min references for a mesh to be instanced")
+            .scan<'u', uint32_t>();
+        parser.add_argument("--instance-bake-vertices")
+            .help("Bake meshes whose copies total at most this many vertices")
+            .scan<'u', uint32_t>();
+        parser.add_argument("--batch-grid")
+            .help("Merge static meshes by material within grid cells this big")
+            .scan<'g', float>();
+        parser.add_argument("--batch-kmeans")
+            .help("Merge static meshes by material within this many clusters")
+            .scan<'u', uint32_t>();
+        parser.add_argument("--batch-vertices")
+            .help("Max vertices per batch with --batch-grid or --batch-kmeans")
+            .scan<'u', uint32_t>();
+        parser.add_argument("--collision")
+            .help("Write collision proxies (hull, decomp or trimesh) to .dcol");
+        parser.add_argument("--collision-hull-vertices")
+            .help("Max vertices per collision hull")
+            .scan<'u', uint32_t>();
+        parser.add_argument("--collision-hulls")
+            .help("Max hulls per mesh with --collision decomp")
+            .scan<'u', uint32_t>();
+        parser.add_argument("--view")
+            .help("Also write a memory mappable .dmdv of static models")
+            .default_value(false)
+            .implicit_value(true);
+        parser.add_argument("--tile-grid")
+            .help("Write one DMD per grid tile this big and a .tiles.json")
+            .scan<'g', float>();
+        parser.add_argument("--tile-quadtree")
+            .help("Write quadtree tiles with at most this many actors each")
+            .scan<'u', uint32_t>();
+        parser.add_argument("--tile-size")
+            .help("Smallest tile size with --tile-quadtree")
+            .scan<'g', float>();
         parser.add_argument("files").help("Input model file paths").remaining();
         parser.parse_args(argc, argv);
 
-        const auto comp_method = ::interpret_comp_method(
+        ::CompileConfig config;
+        config.export_.comp_method_ = ::interpret_comp_method(
             parser.get<std::string>("--compress")
         );
 
+        config.optimize_.thread_count_ = parser.get<uint32_t>("--threads");
+        config.optimize_vertex_cache_ = !parser.get<bool>("--no-vertex-cache");
+        config.export_.compact_indices_ = parser.get<bool>("--index16");
+        config.export_.unit_bounds_ = parser.get<bool>("--unit-bounds");
+        config.export_.table_of_contents_ = parser.get<bool>("--toc");
+        config.model_view_ = parser.get<bool>("--view");
+        if (const auto v = parser.present<uint32_t>("--block-size")) {
+            config.export_.block_size_ = size_t{ v.value() } << 20;
+            config.export_.thread_count_ = config.optimize_.thread_count_;
+        }
+
+        if (const auto weld_pos = parser.present<float>("--weld")) {
+            auto& tolerance = config.optimize_.weld_tolerance_.emplace();
+            tolerance.pos_ = weld_pos.value();
+            if (const auto v = parser.present<float>("--weld-normal"))
+                tolerance.normal_ = v.value();
+            if (const auto v = parser.present<float>("--weld-uv"))
+                tolerance.uv_ = v.value();
+            if (const auto v = parser.present<float>("--weld-weight"))
+                tolerance.weight_ = v.value();
+        }
+
+        if (const auto lod_count = parser.get<uint32_t>("--lods")) {
+            auto& lods = config.lods_.emplace();
+            lods.ratios_.clear();
+            for (uint32_t i = 0; i < lod_count; ++i)
+                lods.ratios_.push_back(std::pow(0.5f, i + 1.f));
+            if (const auto v = parser.present<float>("--lod-error"))
+                lods.max_error_ = v.value();
+        }
+
+        if (parser.get<bool>("--meshlets")) {
+            auto& meshlets = config.meshlets_.emplace();
+            meshlets.max_vertices_ = parser.get<uint32_t>("--meshlet-vertices");
+            meshlets.max_triangles_ = parser.get<uint32_t>(
+                "--meshlet-triangles"
+            );
+        }
+
+        if (parser.get<bool>("--quantize")) {
+            using Format = dal::parser::VertexFormat;
+            auto& format = config.vertex_format_.emplace();
+            format.pos_ = Format::Position::unorm16;
+            format.normal_ = Format::Normal::oct16;
+            format.uv_ = parser.get<bool>("--quantize-uv16")
+                             ? Format::Uv::unorm16
+                             : Format::Uv::float16;
+        }
+
+        if (parser.get<bool>("--skin-format")) {
+            auto& skin = config.skin_format_.emplace();
+            if (const auto v = parser.present<float>("--skin-weight-error"))
+                skin.max_weight_error_ = v.value();
+        }
+
+        if (parser.get<bool>("--bvh")) {
+            auto& bvh = config.bvh_.emplace();
+            bvh.max_leaf_size_ = parser.get<uint32_t>("--bvh-leaf-size");
+        }
+
+        if (parser.get<bool>("--instancing")) {
+            auto& instancing = config.convert_.instancing_.emplace();
+            if (const auto v = parser.present<uint32_t>("--instance-min"))
+                instancing.min_instances_ = v.value();
+            const auto bake_vertices = parser.present<uint32_t>(
+                "--instance-bake-vertices"
+            );
+            if (bake_vertices.has_value())
+                instancing.max_baked_vertices_ = bake_vertices.value();
+        }
+
+        using Clustering = dal::parser::BatchingOptions::Clustering;
+        if (const auto v = parser.present<float>("--batch-grid")) {
+            auto& batching = config.convert_.batching_.emplace();
+            batching.clustering_ = Clustering::grid;
+            batching.cell_size_ = v.value();
+        } else if (const auto v = parser.present<uint32_t>("--batch-kmeans")) {
+            auto& batching = config.convert_.batching_.emplace();
+            batching.clustering_ = Clustering::kmeans;
+            batching.cluster_count_ = v.value();
+        }
+        if (const auto v = parser.present<uint32_t>("--batch-vertices")) {
+            if (config.convert_.batching_.has_value())
+                config.convert_.batching_->max_vertices_ = v.value();
+        }
+
+        if (const auto shape = parser.present<std::string>("--collision")) {
+            auto& collision = config.collision_.emplace();
+            collision.shape_ = ::interpret_collision_shape(shape.value());
+            const auto hull_vertices = parser.present<uint32_t>(
+                "--collision-hull-vertices"
+            );
+            if (hull_vertices.has_value())
+                collision.max_hull_vertices_ = hull_vertices.value();
+            if (const auto v = parser.present<uint32_t>("--collision-hulls"))
+                collision.max_hulls_ = v.value();
+        }
+
+        using Partition = dal::parser::TilingOptions::Partition;
+        if (const auto v = parser.present<float>("--tile-grid")) {
+            auto& tiling = config.tiling_.emplace();
+            tiling.partition_ = Partition::grid;
+            tiling.tile_size_ = ::interpret_tile_size(v.value());
+        } else if (const auto v = parser.present<uint32_t>("--tile-quadtree")) {
+            auto& tiling = config.tiling_.emplace();
+            tiling.partition_ = Partition::quadtree;
+            tiling.max_actors_ = v.value();
+            if (const auto size = parser.present<float>("--tile-size"))
+                tiling.tile_size_ = ::interpret_tile_size(size.value());
+        }
+
         const auto files = parser.get<std::vector<std::string>>("files");
         for (const auto& src_path_str : files) {
             const std::filesystem::path src_path{ src_path_str };
-            ::do_file(src_path, comp_method);
+            ::do_file(src_path, config);
         }
     }
 
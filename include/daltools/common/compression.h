@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
@@ -67,6 +68,29 @@ namespace dal {
     std::optional<binvec_t> decomp_bro(const BinDataView& src, size_t hint);
 
 
+    // Pulls decompressed bytes out of `src` a chunk at a time, so the
+    // whole output never needs to be in memory. `src` must outlive it.
+    class DecompressStream {
+
+    public:
+        DecompressStream(
+            CompressMethod method, const uint8_t* src, size_t src_size
+        );
+        ~DecompressStream();
+
+        // Returns the number of bytes written to `dst`, which is less than
+        // `size` only at the end of the stream or on failure
+        size_t read(uint8_t* dst, size_t size);
+
+        // Corrupted or truncated input, or an unknown method
+        bool failed() const;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_;
+    };
+
+
     std::optional<std::vector<uint8_t>> compress_with_header(
         const BinDataView& src
     );
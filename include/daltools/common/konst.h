@@ -1,9 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
 
 namespace dal::parser {
 
     constexpr int MAGIC_NUMBER_SIZE = 6;
 
     constexpr char MAGIC_NUMBERS_DAL_MODEL[] = "dalmdl";
+    constexpr char MAGIC_NUMBERS_DAL_COLLISION[] = "dalcol";
+    constexpr char MAGIC_NUMBERS_DAL_MODEL_VIEW[] = "dalmdv";
+
+    // Stored in the upper 16 bits of the compression method field, so
+    // readers that predate revisions fail with `decompression_failed`.
+    // 1: Index width before index data of indexed meshes
+    // 2: Vertex format of indexed meshes, see `VertexFormat`
+    // 3: Skin encodings in the vertex format
+    // 4: Instanced units, see `DMD_SECTION_INSTANCES`. Skipping the section
+    //    would draw them at the origin, so it's tied to a revision.
+    // 5: Table of contents, see `DMD_REVISION_TOC`
+    constexpr int32_t DMD_REVISION_LATEST = 5;
+
+    // From this revision the int64 after the compression method field is
+    // the number of entries of a table of contents that follows it. Each
+    // entry is { int32 tag, int32 compression method, int64 offset from
+    // the file start, int64 stored size, int64 decompressed size }, and
+    // every section is compressed on its own, so they can be loaded
+    // separately. Sections are the `DMD_SECTION_*` ones below in file
+    // order, without the tag and size prefixes.
+    constexpr int32_t DMD_REVISION_TOC = 5;
+
+    // Or'ed into the compression method of files without a table of
+    // contents when the payload is split into blocks compressed on their
+    // own. After the decompressed size come { int64 block size, int64 block
+    // count, int64 stored size of each block } and then the blocks. Every
+    // block but the last decompresses to the block size. Readers that
+    // predate it see an unknown compression method.
+    constexpr int32_t DMD_FRAMED_PAYLOAD = 0x100;
+
+    constexpr int32_t make_dmd_section_tag(const char (&name)[5]) {
+        return static_cast<int32_t>(
+            static_cast<uint32_t>(name[0]) |
+            static_cast<uint32_t>(name[1]) << 8 |
+            static_cast<uint32_t>(name[2]) << 16 |
+            static_cast<uint32_t>(name[3]) << 24
+        );
+    }
+
+    // Parts every payload has in this order. Only files with a table of
+    // contents tag them.
+    constexpr int32_t DMD_SECTION_AABB = make_dmd_section_tag("AABB");
+    constexpr int32_t DMD_SECTION_SKELETON = make_dmd_section_tag("SKEL");
+    constexpr int32_t DMD_SECTION_ANIMATIONS = make_dmd_section_tag("ANIM");
+    constexpr int32_t DMD_SECTION_UNITS_STRAIGHT = make_dmd_section_tag(
+        "USTR"
+    );
+    constexpr int32_t DMD_SECTION_UNITS_STRAIGHT_JOINT = make_dmd_section_tag(
+        "USTJ"
+    );
+    constexpr int32_t DMD_SECTION_UNITS_INDEXED = make_dmd_section_tag("UIDX");
+    constexpr int32_t DMD_SECTION_UNITS_INDEXED_JOINT = make_dmd_section_tag(
+        "UIDJ"
+    );
+
+    // Optional sections after the render units, each stored as
+    // { int32 tag, int64 payload size, payload }. Readers skip unknown tags.
+    constexpr int32_t DMD_SECTION_LODS = make_dmd_section_tag("LODS");
+    constexpr int32_t DMD_SECTION_MESHLETS = make_dmd_section_tag("MSHL");
+    constexpr int32_t DMD_SECTION_BOUNDS = make_dmd_section_tag("BNDS");
+    constexpr int32_t DMD_SECTION_BVH = make_dmd_section_tag("BVHT");
+    constexpr int32_t DMD_SECTION_INSTANCES = make_dmd_section_tag("INST");
+
+    // Of collision files, stored like `DMD_REVISION_LATEST`
+    constexpr int32_t DCOL_REVISION_LATEST = 0;
+
+    // Of zero copy model files, see `build_binary_model_view`
+    constexpr uint16_t DMDV_REVISION_LATEST = 0;
 
 }
 
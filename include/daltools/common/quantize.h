@@ -0,0 +1,34 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+
+namespace dal {
+
+    // IEEE 754 binary16, rounded to nearest even
+    uint16_t float_to_half(float v);
+    float half_to_float(uint16_t v);
+
+    // Linear in [min, max], out of range values are clamped
+    uint16_t encode_unorm16(float v, float min, float max);
+    float decode_unorm16(uint16_t v, float min, float max);
+
+    // Octahedral mapping to two snorm16 values. Input needs not be unit length.
+    std::array<int16_t, 2> encode_oct16(const glm::vec3& normal);
+    glm::vec3 decode_oct16(const std::array<int16_t, 2>& v);
+
+    // Normalizes `weights` and scales them to integers that sum to exactly
+    // `max_value`, using the largest remainder method. All zero if their sum
+    // is not positive.
+    void encode_unorm_weights(
+        const float* weights,
+        size_t count,
+        uint32_t max_value,
+        uint32_t* output
+    );
+
+}  // namespace dal
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <filesystem>
+#include <functional>
 #include <optional>
 #include <vector>
 
@@ -22,6 +23,26 @@ namespace dal {
     };
 
 
+    // Mixes `value` into `seed` the way `boost::hash_combine` does
+    inline void hash_combine(size_t& seed, const size_t value) {
+        seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+
+
+    // 0 means one thread per hardware thread
+    uint32_t resolve_thread_count(uint32_t requested);
+
+    // Calls `func(i)` once for every i in [0, count), spread over up to
+    // `thread_count` threads including the caller. Indices are handed out
+    // dynamically, so write results into per-index slots to keep the output
+    // deterministic. The first exception thrown by `func` is rethrown here.
+    void parallel_for(
+        size_t count,
+        uint32_t thread_count,
+        const std::function<void(size_t)>& func
+    );
+
+
     namespace fs = std::filesystem;
 
     std::optional<fs::path> find_git_repo_root(const fs::path& start_path);
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "daltools/common/compression.h"
+#include "daltools/scene/collision.h"
 #include "daltools/scene/struct.h"
 
 
@@ -12,9 +13,56 @@ namespace dal::parser {
     enum class ModelExportResult {
         success,
         compression_failure,
+        // Joint indices that don't fit `VertexFormat::joint_index_`
+        invalid_vertex_format,
         unknown_error,
     };
 
+    struct ModelExportConfig {
+        CompressMethod comp_method_ = CompressMethod::brotli;
+        // Writes 16-bit indices for meshes with at most 65536 vertices. Needs
+        // DMD revision 1, which older readers reject.
+        bool compact_indices_ = false;
+        // AABB and bounding sphere of every unit, in a section that readers
+        // predating sections reject. Written only if there is any unit.
+        bool unit_bounds_ = false;
+        // Compresses every part separately and indexes them so readers can
+        // load some of them with `parse_dmd_sections`. Needs DMD revision
+        // 5, which older readers reject, and compresses slightly worse.
+        bool table_of_contents_ = false;
+        // Splits the payload into blocks of this many bytes that readers
+        // decompress in parallel, at a small cost in compression ratio. 0
+        // writes one stream. Ignored without compression or with
+        // `table_of_contents_`. See `DMD_FRAMED_PAYLOAD`.
+        size_t block_size_ = 0;
+        // For compressing blocks, where 0 means one per hardware thread
+        uint32_t thread_count_ = 0;
+    };
+
+    // Largest differences between original and decoded vertex attributes
+    // caused by `TMesh_Indexed::vertex_format_`. Any quantized unit makes
+    // the file DMD revision 2, which older readers reject.
+    struct VertexQuantizationError {
+        // Distance in model space
+        float pos_ = 0;
+        // Angle in degrees
+        float normal_deg_ = 0;
+        // Per component
+        float uv_ = 0;
+    };
+
+    VertexQuantizationError measure_quantization_error(const Model& model);
+
+    ModelExportResult build_binary_model(
+        std::vector<uint8_t>& output,
+        const Model& input,
+        const ModelExportConfig& config
+    );
+
+    std::optional<std::vector<uint8_t>> build_binary_model(
+        const Model& input, const ModelExportConfig& config
+    );
+
     ModelExportResult build_binary_model(
         std::vector<uint8_t>& output,
         const Model& input,
@@ -25,4 +73,10 @@ namespace dal::parser {
         const Model& input, CompressMethod comp_method
     );
 
+    // Collision sidecar file, which has the same header as DMD but with
+    // `MAGIC_NUMBERS_DAL_COLLISION`
+    std::optional<std::vector<uint8_t>> build_binary_collision(
+        const CollisionScene& input, CompressMethod comp_method
+    );
+
 }  // namespace dal::parser
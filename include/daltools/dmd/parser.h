@@ -1,8 +1,11 @@
 #pragma once
 
 #include <optional>
+#include <vector>
 
 #include "daltools/common/bin_data.h"
+#include "daltools/common/compression.h"
+#include "daltools/scene/collision.h"
 #include "daltools/scene/struct.h"
 
 
@@ -13,18 +16,78 @@ namespace dal::parser {
         magic_numbers_dont_match,
         decompression_failed,
         corrupted_content,
+        unsupported_revision,
     };
 
+    // Blocks of a framed payload are decompressed by `thread_count`
+    // threads, where 0 means one per hardware thread. See
+    // `DMD_FRAMED_PAYLOAD`.
     ModelParseResult parse_dmd(
         Model& output,
         const uint8_t* const file_content,
-        const size_t content_size
+        const size_t content_size,
+        uint32_t thread_count = 0
     );
 
     std::optional<Model> parse_dmd(
+        const uint8_t* const file_content,
+        const size_t content_size,
+        uint32_t thread_count = 0
+    );
+
+    std::optional<Model> parse_dmd(
+        const BinDataView& src, uint32_t thread_count = 0
+    );
+
+
+    // Parts of a model for `parse_dmd_sections` to load
+    struct DmdSectionMask {
+        bool aabb_ = false;
+        bool skeleton_ = false;
+        bool animations_ = false;
+        // All render units, with their bounds and instances
+        bool units_ = false;
+        // These extend render units, so they need `units_`
+        bool lods_ = false;
+        bool meshlets_ = false;
+        bool bvh_ = false;
+    };
+
+    // Entry of the table of contents, see `DMD_REVISION_TOC`
+    struct DmdSectionInfo {
+        // One of `DMD_SECTION_*`, or a tag unknown to this reader
+        int32_t tag_ = 0;
+        CompressMethod compression_ = CompressMethod::none;
+        // From the start of the file
+        size_t offset_ = 0;
+        size_t stored_size_ = 0;
+        size_t decompressed_size_ = 0;
+    };
+
+    // Empty for files older than `DMD_REVISION_TOC`. Nullopt if it is not
+    // a DMD or the table points outside of the file.
+    std::optional<std::vector<DmdSectionInfo>> parse_dmd_toc(
         const uint8_t* const file_content, const size_t content_size
     );
 
-    std::optional<Model> parse_dmd(const BinDataView& src);
+    // Decompresses and parses only the sections `mask` asks for, and the
+    // rest of `output` stays default. Files older than `DMD_REVISION_TOC`
+    // are one stream, so they are parsed as a whole and trimmed after.
+    ModelParseResult parse_dmd_sections(
+        Model& output,
+        const uint8_t* const file_content,
+        const size_t content_size,
+        const DmdSectionMask& mask
+    );
+
+    std::optional<Model> parse_dmd_sections(
+        const BinDataView& src, const DmdSectionMask& mask
+    );
+
+
+    // Of files written by `build_binary_collision`
+    std::optional<CollisionScene> parse_collision(
+        const uint8_t* const file_content, const size_t content_size
+    );
 
 }  // namespace dal::parser
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+#include "daltools/scene/struct.h"
+
+
+namespace dal::parser {
+
+    // Non-owning contiguous array, valid as long as the viewed buffer is
+    template <typename T>
+    class TArrayView {
+
+    public:
+        TArrayView() = default;
+
+        TArrayView(const T* data, const size_t size)
+            : data_(data), size_(size) {}
+
+        const T* data() const { return this->data_; }
+        size_t size() const { return this->size_; }
+        bool empty() const { return 0 == this->size_; }
+
+        const T* begin() const { return this->data_; }
+        const T* end() const { return this->data_ + this->size_; }
+
+        const T& operator[](const size_t index) const {
+            return this->data_[index];
+        }
+
+    private:
+        const T* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+
+    // Strings are null terminated, so `data()` works as a C string
+    struct MaterialView {
+        std::string_view name_;
+        std::string_view albedo_map_;
+        std::string_view roughness_map_;
+        std::string_view metallic_map_;
+        std::string_view normal_map_;
+        float roughness_ = 0.5;
+        float metallic_ = 0;
+        bool transparency_ = false;
+    };
+
+
+    struct UnitView {
+        std::string_view name_;
+        MaterialView material_;
+        AABB3 aabb_;
+        BoundingSphere sphere_;
+        // Same memory layout as `Mesh_Indexed::vertices_`
+        TArrayView<Vertex> vertices_;
+        // One of them is empty depending on the index width of the unit
+        TArrayView<uint16_t> indices16_;
+        TArrayView<uint32_t> indices32_;
+        // See `RenderUnit::instances_`
+        TArrayView<glm::mat4> instances_;
+    };
+
+
+    // Read only access to a file made by `build_binary_model_view`, which
+    // is meant to be memory mapped. Nothing is copied or allocated.
+    class ModelView {
+
+    public:
+        // Checks the header and that every block lies inside the buffer, in
+        // O(unit count). Index values are not checked. Nullopt if invalid,
+        // if `data` is not 16 byte aligned, or on big endian hosts.
+        static std::optional<ModelView> open(
+            const uint8_t* data, size_t size
+        );
+
+        AABB3 aabb() const;
+
+        size_t unit_count() const;
+
+        UnitView unit(size_t index) const;
+
+    private:
+        ModelView(const uint8_t* data, size_t size)
+            : data_(data), size_(size) {}
+
+        const uint8_t* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+
+    // Zero copy layout of `units_indexed_` of a static model: a header,
+    // a table of offsets, and 16 byte aligned blocks of vertices, indices
+    // and instance transforms in their in-memory layout. It is never
+    // compressed and vertices are always 32-bit floats. LODs, meshlets and
+    // the BVH are not stored. Nullopt if the model has a skeleton,
+    // animations, or units of any other kind. 16-bit indices are written
+    // for units with at most 65536 vertices if `compact_indices`.
+    std::optional<std::vector<uint8_t>> build_binary_model_view(
+        const Model& input, bool compact_indices = false
+    );
+
+}  // namespace dal::parser
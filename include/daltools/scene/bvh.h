@@ -0,0 +1,56 @@
+#pragma once
+
+#include <optional>
+
+#include "daltools/scene/struct.h"
+
+
+namespace dal::parser {
+
+    struct BvhOptions {
+        // Leaves hold at most this many triangles unless they can't be split
+        uint32_t max_leaf_size_ = 4;
+        // Candidate split planes per axis for the surface area heuristic
+        uint32_t bin_count_ = 16;
+        // Grows leaf boxes, such as by `VertexQuantizationError::pos_` so
+        // the hierarchy stays conservative for quantized positions
+        float margin_ = 0;
+    };
+
+    // Binned SAH build over triangles of indexed units, skinned ones in bind
+    // pose. Straight and instanced units are skipped.
+    Bvh build_bvh(const Model& model, const BvhOptions& options = {});
+
+
+    struct RayHit {
+        // Along the ray direction in its units, so the hit point is
+        // `origin + direction * distance_`
+        float distance_ = 0;
+        BvhTriangle triangle_;
+        // Weights of the 2nd and 3rd vertices of the triangle
+        glm::vec2 barycentric_{ 0 };
+    };
+
+    // `model.bvh_` must be built from the current indexed units. Triangles
+    // are double sided. Only hits within [0, `max_distance`] count.
+    std::optional<RayHit> intersect_closest(
+        const Model& model,
+        const glm::vec3& origin,
+        const glm::vec3& direction,
+        float max_distance
+    );
+
+    // Cheaper than `intersect_closest` since it stops at the first hit, for
+    // occlusion and shadow rays
+    bool intersect_any(
+        const Model& model,
+        const glm::vec3& origin,
+        const glm::vec3& direction,
+        float max_distance
+    );
+
+    // Whether child offsets, leaf ranges, depth and triangle references of
+    // `bvh` are safe to traverse against the indexed units of `model`
+    bool is_valid_bvh(const Bvh& bvh, const Model& model);
+
+}  // namespace dal::parser
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "daltools/scene/struct.h"
+
+
+namespace dal::parser {
+
+    // Positions only, counter clockwise seen from outside for hulls
+    struct CollisionGeometry {
+        std::vector<glm::vec3> vertices_;
+        std::vector<uint32_t> indices_;
+
+        bool empty() const { return this->indices_.empty(); }
+    };
+
+
+    // Proxies of one `SceneIntermediate::Mesh`, in its local space
+    struct CollisionMesh {
+        std::string name_;
+        // One hull, or several whose union approximates a concave mesh
+        std::vector<CollisionGeometry> hulls_;
+        // Simplified triangles. Also used for flat meshes without a hull.
+        CollisionGeometry trimesh_;
+    };
+
+
+    struct CollisionActor {
+        std::string name_;
+        // Hierarchy transform of the mesh actor, in model space
+        glm::mat4 transform_{ 1 };
+        // Indices into `CollisionScene::meshes_`
+        std::vector<uint32_t> meshes_;
+    };
+
+
+    // Shared meshes are stored once and referenced by actors
+    struct CollisionScene {
+        std::vector<CollisionMesh> meshes_;
+        std::vector<CollisionActor> actors_;
+    };
+
+
+    enum class CollisionShape {
+        convex_hull,
+        convex_decomposition,
+        trimesh,
+    };
+
+    struct CollisionOptions {
+        CollisionShape shape_ = CollisionShape::convex_hull;
+        // At most this many vertices per hull, 4 or more
+        uint32_t max_hull_vertices_ = 64;
+        // Parts of a decomposition at most
+        uint32_t max_hulls_ = 16;
+        // Decomposition stops splitting parts whose surface is at most this
+        // deep inside their hull, relative to the mesh extent
+        float max_concavity_ = 0.02f;
+        // Target triangle count of trimeshes relative to the render mesh
+        float trimesh_ratio_ = 0.25f;
+        // Relative to the mesh extent, see `LodOptions::max_error_`
+        float trimesh_max_error_ = 0.01f;
+    };
+
+    // Quickhull over `points`, adding the farthest point first so stopping
+    // at `max_vertices` keeps the most significant ones. Empty if all
+    // points are coplanar.
+    CollisionGeometry build_convex_hull(
+        const std::vector<glm::vec3>& points, uint32_t max_vertices = 0
+    );
+
+    // Proxies of static meshes referenced by mesh actors, built in parallel
+    // by `thread_count` threads where 0 means one per hardware thread.
+    // Skinned meshes are skipped. Meshes without volume get a trimesh
+    // whatever `options.shape_` is.
+    CollisionScene build_collision(
+        const SceneIntermediate& scene,
+        const CollisionOptions& options,
+        uint32_t thread_count = 0
+    );
+
+}  // namespace dal::parser
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "daltools/scene/struct.h"
+
+
+namespace dal::parser {
+
+    // Affine transforms as a structure of arrays so several instances fit in
+    // one SIMD register. The bottom row is always (0, 0, 0, 1).
+    class InstanceTransforms {
+
+    public:
+        void push_back(const glm::mat4& transform);
+
+        void reserve(size_t count);
+
+        void clear();
+
+        size_t size() const { return this->elements_[0].size(); }
+
+        // Row `row` < 3, column `col` < 4 of every instance
+        const float* data(size_t row, size_t col) const {
+            return this->elements_[4 * row + col].data();
+        }
+
+    private:
+        std::array<std::vector<float>, 12> elements_;
+    };
+
+
+    // Bit i of `visible[i / 64]` is set if instance i may be in the view
+    // frustum. `bounds` is in the local space shared by all instances, such
+    // as `Model::aabb_` or `RenderUnit::aabb_`. Conservative for both
+    // [-1, 1] and [0, 1] clip space depth. Uses AVX2 or SSE if the build
+    // targets them, and splits work into blocks for `thread_count` threads
+    // where 0 means one per hardware thread. Returns the visible count.
+    size_t cull_instances(
+        const glm::mat4& view_proj,
+        const InstanceTransforms& instances,
+        const AABB3& bounds,
+        std::vector<uint64_t>& visible,
+        uint32_t thread_count = 1
+    );
+
+    // Same as above with spheres, which are cheaper but looser. Radii are
+    // scaled by the largest axis scale of each transform.
+    size_t cull_instances(
+        const glm::mat4& view_proj,
+        const InstanceTransforms& instances,
+        const BoundingSphere& bounds,
+        std::vector<uint64_t>& visible,
+        uint32_t thread_count = 1
+    );
+
+    // Name of the instruction set `cull_instances` was built with
+    const char* culling_simd_name();
+
+}  // namespace dal::parser
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <filesystem>
+#include <optional>
 
 #include "daltools/scene/struct.h"
 
@@ -11,6 +12,17 @@ namespace dal::parser {
 
     Mesh_IndexedJoint convert_to_indexed(const Mesh_StraightJoint& input);
 
+    // Converts units in parallel; `thread_count` of 0 means one per hardware
+    // thread. Output order matches input order.
+    std::vector<RenderUnit<Mesh_Indexed>> convert_to_indexed(
+        const std::vector<RenderUnit<Mesh_Straight>>& units,
+        uint32_t thread_count = 0
+    );
+    std::vector<RenderUnit<Mesh_IndexedJoint>> convert_to_indexed(
+        const std::vector<RenderUnit<Mesh_StraightJoint>>& units,
+        uint32_t thread_count = 0
+    );
+
 
     std::vector<RenderUnit<Mesh_Straight>> merge_by_material(
         const std::vector<RenderUnit<Mesh_Straight>>& units
@@ -25,19 +37,208 @@ namespace dal::parser {
         const std::vector<RenderUnit<Mesh_IndexedJoint>>& units
     );
 
+    // Same as above but moves units and meshes instead of copying them
+    std::vector<RenderUnit<Mesh_Straight>> merge_by_material(
+        std::vector<RenderUnit<Mesh_Straight>>&& units
+    );
+    std::vector<RenderUnit<Mesh_StraightJoint>> merge_by_material(
+        std::vector<RenderUnit<Mesh_StraightJoint>>&& units
+    );
+    std::vector<RenderUnit<Mesh_Indexed>> merge_by_material(
+        std::vector<RenderUnit<Mesh_Indexed>>&& units
+    );
+    std::vector<RenderUnit<Mesh_IndexedJoint>> merge_by_material(
+        std::vector<RenderUnit<Mesh_IndexedJoint>>&& units
+    );
+
     enum class JointReductionResult { success, fail, needless };
 
     JointReductionResult reduce_joints(dal::parser::Model& model);
 
 
+    // Mesh
+
+    // Cache size `optimize_vertex_cache` optimizes for
+    constexpr uint32_t VERTEX_CACHE_SIZE = 32;
+
+    // Result of simulating a post-transform vertex cache
+    struct VertexCacheStats {
+        size_t triangle_count_ = 0;
+        // Referenced by at least one index
+        size_t vertex_count_ = 0;
+        // Vertex shader invocations, which are cache misses
+        size_t transform_count_ = 0;
+
+        // Average cache miss ratio, 0.5 is the ideal for big regular meshes
+        double acmr() const;
+        // Average transformed vertex ratio, 1.0 is the ideal
+        double atvr() const;
+    };
+
+    struct VertexCacheReport {
+        VertexCacheStats before_;
+        VertexCacheStats after_;
+    };
+
+    VertexCacheStats analyze_vertex_cache(
+        const std::vector<uint32_t>& indices,
+        size_t vertex_count,
+        uint32_t cache_size = VERTEX_CACHE_SIZE
+    );
+
+    // Reorders triangles with Forsyth's algorithm. Vertices are untouched.
+    void optimize_vertex_cache(
+        std::vector<uint32_t>& indices, size_t vertex_count
+    );
+
+    // Applied to `units_indexed_` and `units_indexed_joint_` in parallel
+    VertexCacheReport optimize_vertex_cache(
+        dal::parser::Model& model, uint32_t thread_count = 0
+    );
+
+    struct MeshCleanupReport {
+        size_t degenerate_triangles_ = 0;
+        size_t duplicate_triangles_ = 0;
+        size_t unused_vertices_ = 0;
+    };
+
+    // Triangles with a repeated index or exactly zero area
+    size_t remove_degenerate_triangles(Mesh_Indexed& mesh);
+    size_t remove_degenerate_triangles(Mesh_IndexedJoint& mesh);
+
+    // Same corners with the same winding. Keeps the first one.
+    size_t remove_duplicate_triangles(std::vector<uint32_t>& indices);
+
+    // Reorders vertices by first use and drops unreferenced ones.
+    // Run this after `optimize_vertex_cache` since it follows index order.
+    size_t optimize_vertex_fetch(Mesh_Indexed& mesh);
+    size_t optimize_vertex_fetch(Mesh_IndexedJoint& mesh);
+
+    // All of the above for every indexed unit, in parallel
+    MeshCleanupReport cleanup_meshes(
+        dal::parser::Model& model, uint32_t thread_count = 0
+    );
+
+    struct LodOptions {
+        // Target triangle count of each level, relative to the full mesh
+        std::vector<float> ratios_{ 0.5f, 0.25f, 0.125f };
+        // Relative to the mesh extent. Coarser levels are not generated once
+        // this is reached.
+        float max_error_ = 0.05f;
+    };
+
+    // Quadric error based. The result indexes `mesh.vertices_`.
+    MeshLod simplify_mesh(
+        const Mesh_Indexed& mesh, float ratio, float max_error
+    );
+    MeshLod simplify_mesh(
+        const Mesh_IndexedJoint& mesh, float ratio, float max_error
+    );
+
+    // Fills `lods_` of every indexed unit, in parallel
+    void generate_lods(
+        dal::parser::Model& model,
+        const LodOptions& options,
+        uint32_t thread_count = 0
+    );
+
+    struct MeshletOptions {
+        // At most 255 since local indices are 8 bits
+        uint32_t max_vertices_ = 64;
+        uint32_t max_triangles_ = 124;
+    };
+
+    // Follows the triangle order, so run `optimize_vertex_cache` first.
+    // Throws `std::invalid_argument` if the limits are out of range.
+    MeshletSet build_meshlets(
+        const Mesh_Indexed& mesh, const MeshletOptions& options = {}
+    );
+    MeshletSet build_meshlets(
+        const Mesh_IndexedJoint& mesh, const MeshletOptions& options = {}
+    );
+
+    // Fills `meshlets_` of every indexed unit, in parallel
+    void build_meshlets(
+        dal::parser::Model& model,
+        const MeshletOptions& options,
+        uint32_t thread_count = 0
+    );
+
+    // Splits indexed units at triangle boundaries so each has at most
+    // `max_vertices` vertices. Parts keep the material and triangle order,
+    // and are named "<name>#1", "<name>#2" and so on after the first one.
+    // LODs and meshlets of split units are dropped. Returns units added.
+    size_t split_large_units(
+        dal::parser::Model& model, size_t max_vertices = 65536
+    );
+
+    struct SkinFormatOptions {
+        // Max difference of a quantized weight from the original weights
+        // normalized to sum to one
+        float max_weight_error_ = 1.f / 255;
+    };
+
+    // Sets the skin fields of `mesh.vertex_format_` to the smallest encoding
+    // that keeps every influence and joint index
+    void select_skin_format(
+        Mesh_IndexedJoint& mesh, const SkinFormatOptions& options = {}
+    );
+
+    // For every `units_indexed_joint_`, in parallel
+    void select_skin_format(
+        dal::parser::Model& model,
+        const SkinFormatOptions& options,
+        uint32_t thread_count = 0
+    );
+
+    // Fills `aabb_` and `sphere_` of every unit, and `Model::aabb_` as their
+    // union with instanced units placed by each of their instances. Spheres
+    // are centered on the AABB. Big units are split across threads. Run it
+    // again after anything that moves or drops vertices.
+    void compute_bounds(dal::parser::Model& model, uint32_t thread_count = 0);
+
+
     // Optimize
 
+    // Maximum differences for two vertices to be welded into one
+    struct VertexWeldTolerance {
+        float pos_ = 0.00001f;
+        float normal_ = 0.001f;
+        float uv_ = 0.00001f;
+        float weight_ = 0.001f;
+    };
+
+    struct SceneOptimizeOptions {
+        // Welding nearly equal vertices is opt-in since it is lossy
+        std::optional<VertexWeldTolerance> weld_tolerance_;
+        // For per-mesh passes, 0 means one per hardware thread
+        uint32_t thread_count_ = 0;
+    };
+
     void apply_root_transform(SceneIntermediate& scene);
 
-    void reduce_indexed_vertices(SceneIntermediate& scene);
+    // Meshes are processed in parallel, see `SceneOptimizeOptions`
+    void reduce_indexed_vertices(
+        SceneIntermediate& scene, uint32_t thread_count = 0
+    );
+
+    // Unlike `reduce_indexed_vertices` this also merges vertices that differ
+    // by float noise. Uses a spatial hash grid so it is near-linear.
+    void weld_vertices(
+        SceneIntermediate& scene,
+        const VertexWeldTolerance& tolerance,
+        uint32_t thread_count = 0
+    );
 
     void remove_duplicate_materials(SceneIntermediate& scene);
 
+    // Keeps the first of meshes with the same skeleton name, vertices and
+    // indices, and points render pairs of the others to it. Content hashes
+    // are computed in parallel. Returns the number of meshes removed.
+    size_t remove_duplicate_meshes(
+        SceneIntermediate& scene, uint32_t thread_count = 0
+    );
+
     void reduce_joints(SceneIntermediate& scene);
 
     void merge_redundant_mesh_actors(SceneIntermediate& scene);
@@ -49,9 +250,17 @@ namespace dal::parser {
     );
 
     inline void optimize_scene(
-        SceneIntermediate& scene, const std::filesystem::path& path
+        SceneIntermediate& scene,
+        const std::filesystem::path& path,
+        const SceneOptimizeOptions& options = {}
     ) {
-        reduce_indexed_vertices(scene);
+        // First so later per-mesh passes run once per distinct mesh
+        remove_duplicate_meshes(scene, options.thread_count_);
+        reduce_indexed_vertices(scene, options.thread_count_);
+        if (options.weld_tolerance_.has_value())
+            weld_vertices(
+                scene, options.weld_tolerance_.value(), options.thread_count_
+            );
         remove_duplicate_materials(scene);
         merge_redundant_mesh_actors(scene);
         split_by_transparency(scene, path);
@@ -68,6 +277,39 @@ namespace dal::parser {
 
     // Convert
 
-    Model convert_to_model_dmd(const SceneIntermediate& scene);
+    struct InstancingOptions {
+        // Static meshes referenced fewer times than this are baked
+        uint32_t min_instances_ = 2;
+        // Also baked if all copies together have at most this many vertices,
+        // since one merged draw beats many tiny ones
+        size_t max_baked_vertices_ = 4096;
+    };
+
+    struct BatchingOptions {
+        enum class Clustering { grid, kmeans };
+
+        // How mesh actors are grouped by their positions
+        Clustering clustering_ = Clustering::grid;
+        // Edge length of grid cells in model space
+        float cell_size_ = 50;
+        // Number of k-means clusters, capped by the number of mesh actors
+        uint32_t cluster_count_ = 16;
+        // A batch is continued in a new unit when a mesh could overflow it
+        size_t max_vertices_ = 65536;
+    };
+
+    struct ModelConvertOptions {
+        // Static meshes referenced by several mesh actors with the same
+        // material become one unit in local space with
+        // `RenderUnit::instances_`. Skinned meshes are always baked.
+        std::optional<InstancingOptions> instancing_;
+        // Baked static meshes are merged by material only within a cell,
+        // so batches stay cullable. Otherwise all are merged by material.
+        std::optional<BatchingOptions> batching_;
+    };
+
+    Model convert_to_model_dmd(
+        const SceneIntermediate& scene, const ModelConvertOptions& options = {}
+    );
 
 }  // namespace dal::parser
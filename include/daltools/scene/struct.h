@@ -1,8 +1,11 @@
 #pragma once
 
+#include <limits>
 #include <map>
 #include <optional>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <glm/glm.hpp>
@@ -24,7 +27,84 @@ namespace dal::parser {
 
 
     struct AABB3 {
-        glm::vec3 min_, max_;
+        glm::vec3 min_{ 0 }, max_{ 0 };
+
+        // Grow to also enclose `other`
+        void merge(const AABB3& other);
+
+        // Tight AABB of this box after transformed by `m`
+        AABB3 transform(const glm::mat4& m) const;
+    };
+
+
+    struct BoundingSphere {
+        glm::vec3 center_{ 0 };
+        float radius_ = 0;
+    };
+
+
+    // Hash table that finds a vertex equal to a given one in O(1) amortized
+    // time. It only stores indices into a vertex array owned by someone
+    // else, so the same array must be passed to every call and must not
+    // change other than through `add` while the index is in use. Meant to
+    // live for one pass over a mesh. The vertex type must provide
+    // `make_hash()` and `operator==`.
+    template <typename _Vertex>
+    class TVertexWeldIndex {
+
+    public:
+        void clear() { this->map_.clear(); }
+
+        void reserve(size_t vertex_count) { this->map_.reserve(vertex_count); }
+
+        // Index every vertex of `vertices`. When duplicates exist, the first
+        // one wins, which is what a linear scan would find.
+        void build_from(const std::vector<_Vertex>& vertices) {
+            this->map_.clear();
+            this->map_.reserve(vertices.size());
+
+            const auto size = static_cast<uint32_t>(vertices.size());
+            for (uint32_t i = 0; i < size; ++i) {
+                const auto hash = vertices[i].make_hash();
+                if (!this->find(vertices, vertices[i], hash).has_value())
+                    this->map_.emplace(hash, i);
+            }
+        }
+
+        std::optional<uint32_t> find(
+            const std::vector<_Vertex>& vertices, const _Vertex& vert
+        ) const {
+            return this->find(vertices, vert, vert.make_hash());
+        }
+
+        // Appends `vert` to `vertices` unless an equal vertex is already
+        // there, and returns the index of the vertex.
+        uint32_t add(std::vector<_Vertex>& vertices, const _Vertex& vert) {
+            const auto hash = vert.make_hash();
+            if (const auto found = this->find(vertices, vert, hash))
+                return found.value();
+
+            const auto index = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(vert);
+            this->map_.emplace(hash, index);
+            return index;
+        }
+
+    private:
+        std::optional<uint32_t> find(
+            const std::vector<_Vertex>& vertices,
+            const _Vertex& vert,
+            const size_t hash
+        ) const {
+            const auto range = this->map_.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (vertices[it->second] == vert)
+                    return it->second;
+            }
+            return std::nullopt;
+        }
+
+        std::unordered_multimap<size_t, uint32_t> map_;
     };
 
 
@@ -75,7 +155,14 @@ namespace dal::parser {
             std::vector<VertexJointPair> joints_;
 
         public:
-            bool are_same(const Vertex& other);
+            bool operator==(const Vertex& other) const {
+                return this->are_same(other);
+            }
+
+            bool are_same(const Vertex& other) const;
+
+            // Covers the joint list too, consistent with `are_same`
+            size_t make_hash() const;
         };
 
 
@@ -88,8 +175,19 @@ namespace dal::parser {
             std::vector<size_t> indices_;
 
         public:
+            // Linear search, so prefer the overload below for many vertices
             void add_vertex(const Vertex& vertex);
 
+            // Same result in O(1) amortized time. `index` must be built from
+            // `vertices_`, which must not change other than through calls
+            // with the same `index` while it is in use.
+            void add_vertex(
+                const Vertex& vertex, TVertexWeldIndex<Vertex>& index
+            );
+
+            // Optional hint for the number of `add_vertex` calls to come
+            void reserve(size_t index_count);
+
             void concat(const Mesh& other);
         };
 
@@ -255,6 +353,9 @@ namespace dal::parser {
         }
 
         bool is_equal(const Vertex& other) const;
+
+        // Consistent with `is_equal`, so +0 and -0 hash the same
+        size_t make_hash() const;
     };
 
 
@@ -270,6 +371,9 @@ namespace dal::parser {
         }
 
         bool is_equal(const VertexJoint& other) const;
+
+        // Consistent with `is_equal`, so +0 and -0 hash the same
+        size_t make_hash() const;
     };
 
     static_assert(
@@ -298,13 +402,119 @@ namespace dal::parser {
     };
 
 
+    // Coarser version of an indexed mesh, sharing its vertices
+    struct MeshLod {
+        std::vector<uint32_t> indices_;
+        // Geometric deviation from the full mesh, relative to its extent
+        float error_ = 0;
+    };
+
+
+    // Small cluster of triangles, for culling finer than a render unit
+    struct Meshlet {
+        // Range in `MeshletSet::vertices_`
+        uint32_t vertex_offset_ = 0;
+        uint32_t vertex_count_ = 0;
+        // `MeshletSet::triangles_` from `triangle_offset_`, 3 per triangle
+        uint32_t triangle_offset_ = 0;
+        uint32_t triangle_count_ = 0;
+
+        glm::vec3 center_{ 0 };
+        float radius_ = 0;
+
+        // Every triangle faces away from the camera if
+        // dot(normalize(cone_apex_ - camera_pos), cone_axis_) >= cone_cutoff_
+        glm::vec3 cone_apex_{ 0 };
+        glm::vec3 cone_axis_{ 0 };
+        float cone_cutoff_ = 1;
+    };
+
+
+    struct MeshletSet {
+        std::vector<Meshlet> meshlets_;
+        // Indices into the mesh's vertices
+        std::vector<uint32_t> vertices_;
+        // Indices into the meshlet's own range of `vertices_`
+        std::vector<uint8_t> triangles_;
+
+        bool empty() const { return meshlets_.empty(); }
+    };
+
+
+    // Vertex attribute encodings in DMD files. Parsed meshes are always
+    // decoded to floats, this only records what the file used.
+    struct VertexFormat {
+        enum class Position {
+            float32,
+            // Relative to the AABB of the mesh
+            unorm16,
+        };
+        enum class Normal {
+            float32,
+            // Octahedral mapping, 2 x snorm16
+            oct16,
+        };
+        enum class Uv {
+            float32,
+            float16,
+            // Relative to the UV bounds of the mesh
+            unorm16,
+        };
+
+        // Only for skinned meshes
+        enum class JointIndex {
+            int32,
+            // The max value of these two is `NULL_JID`
+            uint8,
+            uint16,
+        };
+        enum class JointWeight {
+            float32,
+            // Sum to exactly one after quantization
+            unorm8,
+            unorm16,
+        };
+
+        Position pos_ = Position::float32;
+        Normal normal_ = Normal::float32;
+        Uv uv_ = Uv::float32;
+
+        // 1, 2 or 4. With less than 4, influences are stored by descending
+        // weight and the other slots are parsed as `NULL_JID` with zero
+        // weight. Influences that don't fit are dropped.
+        uint32_t influences_ = 4;
+        JointIndex joint_index_ = JointIndex::int32;
+        JointWeight joint_weight_ = JointWeight::float32;
+
+        bool is_full() const {
+            return Position::float32 == pos_ && Normal::float32 == normal_ &&
+                   Uv::float32 == uv_;
+        }
+
+        bool is_full_skin() const {
+            return 4 == influences_ && JointIndex::int32 == joint_index_ &&
+                   JointWeight::float32 == joint_weight_;
+        }
+    };
+
+
     template <typename _Vertex>
     struct TMesh_Indexed {
         std::vector<_Vertex> vertices_;
         std::vector<uint32_t> indices_;
+        // From fine to coarse, `indices_` itself is the full detail level
+        std::vector<MeshLod> lods_;
+        // Clusters of the full detail level
+        MeshletSet meshlets_;
+        // Bytes per index in the DMD file it was parsed from. If it is 2, all
+        // indices, LODs included, fit in `uint16_t`.
+        uint32_t index_width_ = 4;
+        // Encoding to export with, and what it was parsed from
+        VertexFormat vertex_format_;
 
         using VERT_TYPE = _Vertex;
 
+        // Linear search, so prefer the overload below for many vertices
         void add_vertex(const _Vertex& vert) {
             for (size_t i = 0; i < this->vertices_.size(); ++i) {
                 if (vert == this->vertices_[i]) {
@@ -317,10 +527,69 @@ namespace dal::parser {
             this->vertices_.push_back(vert);
         }
 
+        // Same result in O(1) amortized time. `index` must be built from
+        // `vertices_`, which must not change other than through calls with
+        // the same `index` while it is in use.
+        void add_vertex(
+            const _Vertex& vert, TVertexWeldIndex<_Vertex>& index
+        ) {
+            this->indices_.push_back(index.add(this->vertices_, vert));
+        }
+
+        // Each distinct vertex of `other` is looked up once and the indices
+        // are appended through an old-to-new remap table. The result is the
+        // same as calling `add_vertex` for every index of `other`.
+        // LODs and meshlets are dropped since they would not cover the
+        // merged part.
         void concat(const TMesh_Indexed<_Vertex>& other) {
-            for (const auto index : other.indices_) {
-                this->add_vertex(other.vertices_[index]);
+            TVertexWeldIndex<_Vertex> index;
+            index.build_from(this->vertices_);
+            this->concat(other, index);
+        }
+
+        // For concatenating several meshes, with `index` as in `add_vertex`
+        void concat(
+            const TMesh_Indexed<_Vertex>& other,
+            TVertexWeldIndex<_Vertex>& index
+        ) {
+            constexpr auto NOT_YET = std::numeric_limits<uint32_t>::max();
+
+            this->lods_.clear();
+            this->meshlets_ = MeshletSet{};
+
+            index.reserve(this->vertices_.size() + other.vertices_.size());
+            this->indices_.reserve(
+                this->indices_.size() + other.indices_.size()
+            );
+
+            std::vector<uint32_t> remap(other.vertices_.size(), NOT_YET);
+            for (const auto i : other.indices_) {
+                auto& new_index = remap[i];
+                if (NOT_YET == new_index)
+                    new_index = index.add(this->vertices_, other.vertices_[i]);
+                this->indices_.push_back(new_index);
+            }
+        }
+
+        // Same as above but frees the buffers of `other` as soon as possible.
+        // Into an empty mesh they are moved as they are instead, without
+        // welding the vertices of `other` among themselves.
+        void concat(
+            TMesh_Indexed<_Vertex>&& other, TVertexWeldIndex<_Vertex>& index
+        ) {
+            if (!this->vertices_.empty() || !this->indices_.empty()) {
+                this->concat(
+                    static_cast<const TMesh_Indexed<_Vertex>&>(other), index
+                );
+                other = TMesh_Indexed<_Vertex>{};
+                return;
             }
+
+            this->lods_.clear();
+            this->meshlets_ = MeshletSet{};
+            this->vertices_ = std::move(other.vertices_);
+            this->indices_ = std::move(other.indices_);
+            index.build_from(this->vertices_);
         }
     };
 
@@ -334,6 +603,13 @@ namespace dal::parser {
         std::string name_;
         _Mesh mesh_;
         Material material_;
+        // Of the mesh vertices, filled by `compute_bounds`
+        AABB3 aabb_;
+        BoundingSphere sphere_;
+        // Model space transforms to draw the mesh with, in which case the
+        // mesh is in its own local space. Empty means it's in model space.
+        // Only `Model::units_indexed_` are instanced.
+        std::vector<glm::mat4> instances_;
     };
 
 
@@ -358,6 +634,37 @@ namespace dal::parser {
     using Animation = SceneIntermediate::Animation;
 
 
+    // Depth first, so the first child of an inner node comes right after it
+    struct BvhNode {
+        glm::vec3 min_{ 0 };
+        // Inner nodes: index of the second child
+        // Leaves: index of the first triangle in `Bvh::triangles_`
+        uint32_t offset_ = 0;
+        glm::vec3 max_{ 0 };
+        // Triangle count of leaves, 0 for inner nodes
+        uint32_t count_ = 0;
+    };
+
+
+    struct BvhTriangle {
+        // Index into `units_indexed_`, or into `units_indexed_joint_` minus
+        // the size of `units_indexed_`
+        uint32_t unit_ = 0;
+        // Index of the first of its 3 indices divided by 3
+        uint32_t triangle_ = 0;
+    };
+
+
+    // Over the triangles of indexed units, skinned ones in bind pose.
+    // Instanced units are left out.
+    struct Bvh {
+        std::vector<BvhNode> nodes_;
+        std::vector<BvhTriangle> triangles_;
+
+        bool empty() const { return nodes_.empty(); }
+    };
+
+
     struct Model {
         std::vector<RenderUnit<Mesh_Straight>> units_straight_;
         std::vector<RenderUnit<Mesh_StraightJoint>> units_straight_joint_;
@@ -367,6 +674,8 @@ namespace dal::parser {
         std::vector<Animation> animations_;
         Skeleton skeleton_;
         AABB3 aabb_;
+        // Optional, see `build_bvh`. Invalid once indexed units change.
+        Bvh bvh_;
     };
 
 }  // namespace dal::parser
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <optional>
+
+#include "daltools/scene/struct.h"
+
+
+namespace dal::parser {
+
+    struct TilingOptions {
+        enum class Partition { grid, quadtree };
+
+        // Tiles lie on the XZ plane since Y is up after `optimize_scene`
+        Partition partition_ = Partition::grid;
+        // Edge length of grid tiles, and the smallest quadtree tile
+        float tile_size_ = 100;
+        // Quadtree tiles with more mesh actors and lights than this are split
+        size_t max_actors_ = 64;
+    };
+
+
+    struct TileInfo {
+        // Unique among tiles, like "3_-2" for grids or "q031" for quadtrees
+        std::string name_;
+        // DMD path relative to the index, set by whoever writes the files
+        std::string file_name_;
+        // Of mesh actors and light positions in model space, for streaming
+        // by camera distance
+        AABB3 bounds_;
+        // Indices of tiles whose point lights or spotlights reach into this
+        // one, so they should be loaded together
+        std::vector<uint32_t> dependencies_;
+        // Point lights and spotlights positioned in this tile
+        std::vector<std::string> lights_;
+    };
+
+    struct TileIndex {
+        std::vector<TileInfo> tiles_;
+        // Directional lights, which belong to no tile
+        std::vector<std::string> global_lights_;
+    };
+
+
+    // `scenes_[i]` is the content of `index_.tiles_[i]`
+    struct WorldTiles {
+        TileIndex index_;
+        std::vector<SceneIntermediate> scenes_;
+    };
+
+    // Assigns every mesh actor by the center of its world bounds and every
+    // light by its position. Each tile scene holds only the meshes,
+    // materials and skeletons its actors use, so it converts to a DMD on
+    // its own. Ancestors in other tiles are copied without render pairs to
+    // keep hierarchy transforms. Empty tiles are omitted.
+    WorldTiles split_into_tiles(
+        const SceneIntermediate& scene, const TilingOptions& options
+    );
+
+    std::string build_tile_index_json(const TileIndex& index);
+
+    // Nullopt if it is not a valid index
+    std::optional<TileIndex> parse_tile_index_json(
+        const uint8_t* const file_content, const size_t content_size
+    );
+
+}  // namespace dal::parser
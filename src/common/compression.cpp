@@ -1,6 +1,9 @@
 #include "daltools/common/compression.h"
 
+#include <algorithm>
 #include <array>
+#include <cstring>
+#include <limits>
 
 #include <brotli/decode.h>
 #include <brotli/encode.h>
@@ -201,6 +204,145 @@ namespace dal {
     }
 
 
+    class DecompressStream::Impl {
+
+    public:
+        Impl(CompressMethod method, const uint8_t* src, size_t src_size)
+            : method_(method), next_in_(src), available_in_(src_size) {
+            if (CompressMethod::zip == method) {
+                if (Z_OK == inflateInit(&this->zip_))
+                    this->zip_ready_ = true;
+                else
+                    this->failed_ = true;
+            } else if (CompressMethod::brotli == method) {
+                this->bro_ = BrotliDecoderCreateInstance(
+                    nullptr, nullptr, nullptr
+                );
+                if (nullptr == this->bro_)
+                    this->failed_ = true;
+            } else if (CompressMethod::none != method) {
+                this->failed_ = true;
+            }
+        }
+
+        ~Impl() {
+            if (this->zip_ready_)
+                inflateEnd(&this->zip_);
+            if (nullptr != this->bro_)
+                BrotliDecoderDestroyInstance(this->bro_);
+        }
+
+        size_t read(uint8_t* const dst, const size_t size) {
+            if (this->failed_ || this->finished_)
+                return 0;
+
+            switch (this->method_) {
+                case CompressMethod::zip:
+                    return this->read_zip(dst, size);
+                case CompressMethod::brotli:
+                    return this->read_bro(dst, size);
+                default:
+                    return this->read_none(dst, size);
+            }
+        }
+
+        bool failed() const { return this->failed_; }
+
+    private:
+        size_t read_none(uint8_t* const dst, const size_t size) {
+            const auto output = std::min(size, this->available_in_);
+            std::memcpy(dst, this->next_in_, output);
+            this->next_in_ += output;
+            this->available_in_ -= output;
+            if (0 == this->available_in_)
+                this->finished_ = true;
+            return output;
+        }
+
+        size_t read_zip(uint8_t* const dst, const size_t size) {
+            // zlib counts bytes in `uInt`
+            constexpr size_t MAX_CHUNK = std::numeric_limits<uInt>::max();
+            size_t written = 0;
+
+            while (written < size) {
+                const auto in_size = std::min(this->available_in_, MAX_CHUNK);
+                const auto out_size = std::min(size - written, MAX_CHUNK);
+                this->zip_.next_in = const_cast<Bytef*>(this->next_in_);
+                this->zip_.avail_in = static_cast<uInt>(in_size);
+                this->zip_.next_out = dst + written;
+                this->zip_.avail_out = static_cast<uInt>(out_size);
+
+                const auto res = inflate(&this->zip_, Z_NO_FLUSH);
+                const auto consumed = in_size - this->zip_.avail_in;
+                this->next_in_ += consumed;
+                this->available_in_ -= consumed;
+                written += out_size - this->zip_.avail_out;
+
+                if (Z_STREAM_END == res) {
+                    this->finished_ = true;
+                    break;
+                } else if (Z_OK != res) {
+                    // Including `Z_BUF_ERROR` for input that ends early
+                    this->failed_ = true;
+                    break;
+                }
+            }
+
+            return written;
+        }
+
+        size_t read_bro(uint8_t* const dst, const size_t size) {
+            auto next_out = dst;
+            auto available_out = size;
+
+            while (available_out > 0) {
+                const auto res = BrotliDecoderDecompressStream(
+                    this->bro_,
+                    &this->available_in_,
+                    &this->next_in_,
+                    &available_out,
+                    &next_out,
+                    nullptr
+                );
+
+                if (BROTLI_DECODER_RESULT_SUCCESS == res) {
+                    this->finished_ = true;
+                    break;
+                } else if (BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT != res) {
+                    // All input is given at once, so needing more of it
+                    // means it is truncated
+                    this->failed_ = true;
+                    break;
+                }
+            }
+
+            return static_cast<size_t>(next_out - dst);
+        }
+
+        CompressMethod method_;
+        const uint8_t* next_in_;
+        size_t available_in_;
+        z_stream zip_{};
+        BrotliDecoderState* bro_ = nullptr;
+        bool zip_ready_ = false;
+        bool finished_ = false;
+        bool failed_ = false;
+    };
+
+    DecompressStream::DecompressStream(
+        CompressMethod method, const uint8_t* src, size_t src_size
+    )
+        : pimpl_(std::make_unique<Impl>(method, src, src_size)) {}
+
+    DecompressStream::~DecompressStream() = default;
+
+    size_t DecompressStream::read(uint8_t* dst, size_t size) {
+        return this->pimpl_->read(dst, size);
+    }
+
+    bool DecompressStream::failed() const { return this->pimpl_->failed(); }
+
+
     std::optional<std::vector<uint8_t>> compress_with_header(
         const BinDataView& src
     ) {
@@ -0,0 +1,186 @@
+#include "daltools/common/quantize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+
+namespace {
+
+    constexpr float SNORM16_MAX = 32767;
+    constexpr float UNORM16_MAX = 65535;
+
+
+    uint32_t float_bits(const float v) {
+        uint32_t output;
+        std::memcpy(&output, &v, sizeof(output));
+        return output;
+    }
+
+    float bits_float(const uint32_t v) {
+        float output;
+        std::memcpy(&output, &v, sizeof(output));
+        return output;
+    }
+
+    float sign_not_zero(const float v) { return v < 0 ? -1.f : 1.f; }
+
+    int16_t to_snorm16(const float v) {
+        const auto clamped = std::clamp(v, -1.f, 1.f);
+        return static_cast<int16_t>(std::round(clamped * SNORM16_MAX));
+    }
+
+}  // namespace
+
+
+namespace dal {
+
+    uint16_t float_to_half(const float v) {
+        const auto bits = ::float_bits(v);
+        const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+        const auto exponent = static_cast<int32_t>((bits >> 23) & 0xFF);
+        auto mantissa = bits & 0x7FFFFF;
+
+        // NaN and infinity
+        if (0xFF == exponent) {
+            const uint16_t nan_bit = mantissa ? 0x200 : 0;
+            return sign | 0x7C00 | nan_bit;
+        }
+
+        const auto half_exp = exponent - 127 + 15;
+        if (half_exp >= 0x1F)
+            return sign | 0x7C00;
+
+        if (half_exp <= 0) {
+            // Subnormal half, or zero
+            if (half_exp < -10)
+                return sign;
+
+            mantissa |= 0x800000;
+            const auto shift = static_cast<uint32_t>(14 - half_exp);
+            auto half_mant = mantissa >> shift;
+            const auto rest = mantissa & ((1u << shift) - 1);
+            const auto halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (half_mant & 1)))
+                ++half_mant;
+            return sign | static_cast<uint16_t>(half_mant);
+        }
+
+        auto output = static_cast<uint32_t>(half_exp << 10) | (mantissa >> 13);
+        const auto rest = mantissa & 0x1FFF;
+        // May carry into the exponent, which is still correct
+        if (rest > 0x1000 || (rest == 0x1000 && (output & 1)))
+            ++output;
+        return sign | static_cast<uint16_t>(output);
+    }
+
+    float half_to_float(const uint16_t v) {
+        const uint32_t sign = static_cast<uint32_t>(v & 0x8000) << 16;
+        const uint32_t exponent = (v >> 10) & 0x1F;
+        uint32_t mantissa = v & 0x3FF;
+
+        if (0 == exponent) {
+            if (0 == mantissa)
+                return ::bits_float(sign);
+
+            // Subnormal, normalize it
+            int32_t e = -1;
+            do {
+                ++e;
+                mantissa <<= 1;
+            } while (0 == (mantissa & 0x400));
+            mantissa &= 0x3FF;
+            const auto exp32 = static_cast<uint32_t>(127 - 15 - e);
+            return ::bits_float(sign | exp32 << 23 | mantissa << 13);
+        }
+
+        if (0x1F == exponent)
+            return ::bits_float(sign | 0x7F800000 | mantissa << 13);
+
+        const auto exp32 = exponent + 127 - 15;
+        return ::bits_float(sign | exp32 << 23 | mantissa << 13);
+    }
+
+    uint16_t encode_unorm16(const float v, const float min, const float max) {
+        const auto range = max - min;
+        if (!(range > 0))
+            return 0;
+
+        const auto t = std::clamp((v - min) / range, 0.f, 1.f);
+        return static_cast<uint16_t>(std::round(t * UNORM16_MAX));
+    }
+
+    float decode_unorm16(const uint16_t v, const float min, const float max) {
+        return min + (max - min) * (static_cast<float>(v) / UNORM16_MAX);
+    }
+
+    std::array<int16_t, 2> encode_oct16(const glm::vec3& normal) {
+        const auto l1 = std::abs(normal.x) + std::abs(normal.y) +
+                        std::abs(normal.z);
+        if (!(l1 > 0))
+            return { 0, ::to_snorm16(1) };
+
+        auto x = normal.x / l1;
+        auto y = normal.y / l1;
+        if (normal.z < 0) {
+            const auto fx = (1 - std::abs(y)) * ::sign_not_zero(x);
+            const auto fy = (1 - std::abs(x)) * ::sign_not_zero(y);
+            x = fx;
+            y = fy;
+        }
+
+        return { ::to_snorm16(x), ::to_snorm16(y) };
+    }
+
+    glm::vec3 decode_oct16(const std::array<int16_t, 2>& v) {
+        const auto x = std::max(v[0] / SNORM16_MAX, -1.f);
+        const auto y = std::max(v[1] / SNORM16_MAX, -1.f);
+
+        glm::vec3 output{ x, y, 1 - std::abs(x) - std::abs(y) };
+        if (output.z < 0) {
+            output.x = (1 - std::abs(y)) * ::sign_not_zero(x);
+            output.y = (1 - std::abs(x)) * ::sign_not_zero(y);
+        }
+
+        return glm::normalize(output);
+    }
+
+    void encode_unorm_weights(
+        const float* const weights,
+        const size_t count,
+        const uint32_t max_value,
+        uint32_t* const output
+    ) {
+        double sum = 0;
+        for (size_t i = 0; i < count; ++i) sum += std::max(weights[i], 0.f);
+
+        if (!(sum > 0)) {
+            std::fill(output, output + count, 0);
+            return;
+        }
+
+        uint32_t assigned = 0;
+        std::vector<std::pair<double, size_t>> remainders;
+        remainders.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            const auto scaled = std::max(weights[i], 0.f) / sum * max_value;
+            const auto floor = std::floor(scaled);
+            output[i] = static_cast<uint32_t>(floor);
+            assigned += output[i];
+            remainders.emplace_back(scaled - floor, i);
+        }
+
+        // Ties go to the earlier one
+        std::stable_sort(
+            remainders.begin(),
+            remainders.end(),
+            [](const auto& a, const auto& b) { return a.first > b.first; }
+        );
+        for (size_t i = 0; assigned < max_value && i < count; ++i) {
+            ++output[remainders[i].second];
+            ++assigned;
+        }
+    }
+
+}  // namespace dal
@@ -1,6 +1,8 @@
 #include "daltools/common/util.h"
 
+#include <atomic>
 #include <fstream>
+#include <mutex>
 #include <sstream>
 #include <thread>
 
@@ -38,6 +40,60 @@ namespace {
 // Header functions
 namespace dal {
 
+    uint32_t resolve_thread_count(const uint32_t requested) {
+        if (0 != requested)
+            return requested;
+
+        const auto hardware = std::thread::hardware_concurrency();
+        return 0 != hardware ? hardware : 1;
+    }
+
+    void parallel_for(
+        const size_t count,
+        const uint32_t thread_count,
+        const std::function<void(size_t)>& func
+    ) {
+        const auto worker_count = std::min<size_t>(
+            dal::resolve_thread_count(thread_count), count
+        );
+        if (worker_count <= 1) {
+            for (size_t i = 0; i < count; ++i) func(i);
+            return;
+        }
+
+        std::atomic_size_t next_index{ 0 };
+        std::atomic_bool failed{ false };
+        std::exception_ptr exception;
+        std::mutex exception_mut;
+
+        const auto work = [&]() {
+            while (!failed) {
+                const auto i = next_index.fetch_add(1);
+                if (i >= count)
+                    return;
+
+                try {
+                    func(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock{ exception_mut };
+                    if (!exception)
+                        exception = std::current_exception();
+                    failed = true;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(worker_count - 1);
+        for (size_t i = 1; i < worker_count; ++i) threads.emplace_back(work);
+
+        work();
+        for (auto& thread : threads) thread.join();
+
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+
     std::optional<fs::path> find_git_repo_root(const fs::path& start_path) {
         auto current_dir = start_path;
 
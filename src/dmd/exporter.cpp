@@ -1,8 +1,15 @@
 #include "daltools/dmd/exporter.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <type_traits>
+
 #include "daltools/common/byte_tool.h"
 #include "daltools/common/compression.h"
 #include "daltools/common/konst.h"
+#include "daltools/common/quantize.h"
+#include "daltools/common/util.h"
 
 
 namespace dalp = dal::parser;
@@ -34,39 +41,202 @@ namespace {
         }
     };
 
+
+    // Collects the parts of a DMD payload. Without a table of contents they
+    // go into one buffer, with optional sections prefixed by their tag and
+    // size. With it each part is kept apart to be compressed on its own.
+    class SectionWriter {
+
+    public:
+        struct Section {
+            int32_t tag_;
+            ::BinaryBuildBuffer data_;
+        };
+
+        explicit SectionWriter(const bool separate) : separate_(separate) {}
+
+        // Parts every payload has, added in `DMD_SECTION_AABB` order
+        template <typename _Func>
+        void add_core(const int32_t tag, _Func&& build) {
+            if (this->separate_)
+                build(this->sections_.emplace_back(Section{ tag, {} }).data_);
+            else
+                build(this->payload_);
+        }
+
+        template <typename _Func>
+        void add_optional(const int32_t tag, _Func&& build) {
+            if (this->separate_) {
+                build(this->sections_.emplace_back(Section{ tag, {} }).data_);
+                return;
+            }
+
+            ::BinaryBuildBuffer section;
+            build(section);
+
+            this->payload_.append_int32(tag);
+            this->payload_.append_int64(section.size());
+            this->payload_.append_raw_array(section.data(), section.size());
+        }
+
+        const ::BinaryBuildBuffer& payload() const { return this->payload_; }
+
+        const std::vector<Section>& sections() const {
+            return this->sections_;
+        }
+
+    private:
+        ::BinaryBuildBuffer payload_;
+        std::vector<Section> sections_;
+        bool separate_;
+    };
+
 }  // namespace
 
 
 namespace {
 
-    std::optional<std::vector<uint8_t>> compress_dal_model(
+    // Nullopt on failure, and for `CompressMethod::none` where `src` is
+    // used as it is
+    std::optional<std::vector<uint8_t>> compress_payload(
         const uint8_t* const src,
         const size_t src_size,
         dal::CompressMethod comp_method
+    ) {
+        if (comp_method == dal::CompressMethod::zip)
+            return dal::compress_zip(dal::BinDataView{ src, src_size });
+        else if (comp_method == dal::CompressMethod::brotli)
+            return dal::compress_bro(src, src_size);
+        else
+            return std::nullopt;
+    }
+
+    std::optional<std::vector<uint8_t>> compress_dal_model(
+        const uint8_t* const src,
+        const size_t src_size,
+        dal::CompressMethod comp_method,
+        const int32_t revision,
+        const char* const magic_numbers = dalp::MAGIC_NUMBERS_DAL_MODEL
     ) {
         dalp::BinaryDataArray output;
 
-        output.append_array(
-            dalp::MAGIC_NUMBERS_DAL_MODEL, dalp::MAGIC_NUMBER_SIZE
-        );
-        output.append_int32(static_cast<int32_t>(comp_method));
+        output.append_array(magic_numbers, dalp::MAGIC_NUMBER_SIZE);
+        output.append_int32(static_cast<int32_t>(comp_method) | revision << 16);
         output.append_int64(src_size);
 
         if (comp_method == dal::CompressMethod::none) {
             output.append_array(src, src_size);
-        } else if (comp_method == dal::CompressMethod::zip) {
-            dal::BinDataView bin_view{ src, src_size };
-            const auto compressed = dal::compress_zip(bin_view);
+        } else {
+            const auto compressed = ::compress_payload(
+                src, src_size, comp_method
+            );
             if (!compressed.has_value())
                 return std::nullopt;
             output.append_array(compressed->data(), compressed->size());
-        } else if (comp_method == dal::CompressMethod::brotli) {
-            const auto compressed = dal::compress_bro(src, src_size);
-            if (!compressed.has_value())
+        }
+
+        return output.release();
+    }
+
+    // See `DMD_FRAMED_PAYLOAD`
+    std::optional<std::vector<uint8_t>> compress_dal_model_framed(
+        const uint8_t* const src,
+        const size_t src_size,
+        const dal::CompressMethod comp_method,
+        const int32_t revision,
+        const size_t block_size,
+        const uint32_t thread_count
+    ) {
+        const auto block_count = (src_size + block_size - 1) / block_size;
+        std::vector<std::optional<std::vector<uint8_t>>> blocks(block_count);
+        dal::parallel_for(block_count, thread_count, [&](const size_t i) {
+            const auto begin = i * block_size;
+            const auto size = std::min(block_size, src_size - begin);
+            blocks[i] = ::compress_payload(src + begin, size, comp_method);
+        });
+
+        dalp::BinaryDataArray output;
+        output.append_array(
+            dalp::MAGIC_NUMBERS_DAL_MODEL, dalp::MAGIC_NUMBER_SIZE
+        );
+        output.append_int32(
+            static_cast<int32_t>(comp_method) | dalp::DMD_FRAMED_PAYLOAD |
+            revision << 16
+        );
+        output.append_int64(src_size);
+        output.append_int64(block_size);
+        output.append_int64(block_count);
+
+        for (auto& block : blocks) {
+            if (!block.has_value())
                 return std::nullopt;
-            output.append_array(compressed->data(), compressed->size());
-        } else {
-            return std::nullopt;
+            output.append_int64(block->size());
+        }
+        for (auto& block : blocks)
+            output.append_array(block->data(), block->size());
+
+        return output.release();
+    }
+
+    // See `DMD_REVISION_TOC`. Sections that compression would not shrink
+    // are stored as they are.
+    std::optional<std::vector<uint8_t>> assemble_toc_model(
+        const std::vector<::SectionWriter::Section>& sections,
+        const dal::CompressMethod comp_method,
+        const int32_t revision
+    ) {
+        constexpr size_t HEADER_SIZE = dalp::MAGIC_NUMBER_SIZE + 12;
+        constexpr size_t ENTRY_SIZE = 32;
+
+        std::vector<std::optional<std::vector<uint8_t>>> compressed;
+        for (auto& section : sections) {
+            auto& stored = compressed.emplace_back();
+            if (comp_method == dal::CompressMethod::none)
+                continue;
+
+            stored = ::compress_payload(
+                section.data_.data(), section.data_.size(), comp_method
+            );
+            if (!stored.has_value())
+                return std::nullopt;
+            if (stored->size() >= section.data_.size())
+                stored.reset();
+        }
+
+        dalp::BinaryDataArray output;
+        output.append_array(
+            dalp::MAGIC_NUMBERS_DAL_MODEL, dalp::MAGIC_NUMBER_SIZE
+        );
+        output.append_int32(static_cast<int32_t>(comp_method) | revision << 16);
+        output.append_int64(sections.size());
+
+        auto offset = HEADER_SIZE + ENTRY_SIZE * sections.size();
+        for (size_t i = 0; i < sections.size(); ++i) {
+            const auto& data = sections[i].data_;
+            const auto method = compressed[i].has_value()
+                                    ? comp_method
+                                    : dal::CompressMethod::none;
+            const auto stored_size = compressed[i].has_value()
+                                         ? compressed[i]->size()
+                                         : data.size();
+
+            output.append_int32(sections[i].tag_);
+            output.append_int32(static_cast<int32_t>(method));
+            output.append_int64(offset);
+            output.append_int64(stored_size);
+            output.append_int64(data.size());
+            offset += stored_size;
+        }
+
+        for (size_t i = 0; i < sections.size(); ++i) {
+            if (compressed[i].has_value())
+                output.append_array(
+                    compressed[i]->data(), compressed[i]->size()
+                );
+            else
+                output.append_array(
+                    sections[i].data_.data(), sections[i].data_.size()
+                );
         }
 
         return output.release();
@@ -171,6 +341,217 @@ namespace {
 }  // namespace
 
 
+// Vertex formats
+namespace {
+
+    struct BuildParams {
+        int32_t revision_ = 0;
+        bool compact_indices_ = false;
+    };
+
+    struct VertexBounds {
+        glm::vec3 pos_min_{ 0 };
+        glm::vec3 pos_max_{ 0 };
+        glm::vec2 uv_min_{ 0 };
+        glm::vec2 uv_max_{ 0 };
+    };
+
+    template <typename _Vertex>
+    ::VertexBounds calc_vertex_bounds(const std::vector<_Vertex>& vertices) {
+        ::VertexBounds output;
+        if (vertices.empty())
+            return output;
+
+        output.pos_min_ = output.pos_max_ = vertices.front().pos_;
+        output.uv_min_ = output.uv_max_ = vertices.front().uv_;
+        for (auto& vert : vertices) {
+            output.pos_min_ = glm::min(output.pos_min_, vert.pos_);
+            output.pos_max_ = glm::max(output.pos_max_, vert.pos_);
+            output.uv_min_ = glm::min(output.uv_min_, vert.uv_);
+            output.uv_max_ = glm::max(output.uv_max_, vert.uv_);
+        }
+
+        return output;
+    }
+
+    // Anything else is stored as 4
+    uint32_t stored_influences(const dalp::VertexFormat& format) {
+        if (1 == format.influences_ || 2 == format.influences_)
+            return format.influences_;
+        return 4;
+    }
+
+    // Skin bits are zero for the full skin format, so revision 2 files are
+    // written the same as before
+    int32_t pack_vertex_format(
+        const dalp::VertexFormat& format, const bool skinned
+    ) {
+        auto output = static_cast<int32_t>(format.pos_) |
+                      static_cast<int32_t>(format.normal_) << 4 |
+                      static_cast<int32_t>(format.uv_) << 8;
+
+        if (skinned) {
+            const auto influences = ::stored_influences(format);
+            output |= static_cast<int32_t>(4 == influences ? 0 : influences)
+                      << 12;
+            output |= static_cast<int32_t>(format.joint_index_) << 16;
+            output |= static_cast<int32_t>(format.joint_weight_) << 20;
+        }
+
+        return output;
+    }
+
+    template <typename _Mesh>
+    bool has_quantized(const std::vector<dalp::RenderUnit<_Mesh>>& units) {
+        for (auto& unit : units) {
+            if (!unit.mesh_.vertex_format_.is_full())
+                return true;
+        }
+        return false;
+    }
+
+    bool has_compact_skin(
+        const std::vector<dalp::RenderUnit<dalp::Mesh_IndexedJoint>>& units
+    ) {
+        for (auto& unit : units) {
+            if (!unit.mesh_.vertex_format_.is_full_skin())
+                return true;
+        }
+        return false;
+    }
+
+    bool fits_joint_index(const dalp::Mesh_IndexedJoint& mesh) {
+        using Format = dalp::VertexFormat;
+
+        int32_t max_index = 0;
+        switch (mesh.vertex_format_.joint_index_) {
+            case Format::JointIndex::uint8:
+                max_index = 254;
+                break;
+            case Format::JointIndex::uint16:
+                max_index = 65534;
+                break;
+            default:
+                return true;
+        }
+
+        for (auto& vert : mesh.vertices_) {
+            for (int i = 0; i < dalp::NUM_JOINTS_PER_VERTEX; ++i) {
+                if (vert.joint_weights_[i] > 0 &&
+                    vert.joint_indices_[i] > max_index)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    bool has_instances(const dalp::Model& model) {
+        for (auto& unit : model.units_indexed_) {
+            if (!unit.instances_.empty())
+                return true;
+        }
+        return false;
+    }
+
+    // The lowest revision that can store `model` with `config`
+    int32_t select_revision(
+        const dalp::Model& model, const dalp::ModelExportConfig& config
+    ) {
+        if (config.table_of_contents_)
+            return dalp::DMD_REVISION_TOC;
+        if (::has_instances(model))
+            return 4;
+        if (::has_compact_skin(model.units_indexed_joint_))
+            return 3;
+        if (::has_quantized(model.units_indexed_) ||
+            ::has_quantized(model.units_indexed_joint_))
+            return 2;
+        if (config.compact_indices_)
+            return 1;
+        return 0;
+    }
+
+    // Quantization
+
+    template <typename _Vertex>
+    _Vertex quantize_vertex(
+        const _Vertex& vert,
+        const dalp::VertexFormat& format,
+        const ::VertexBounds& bounds
+    ) {
+        using Format = dalp::VertexFormat;
+        auto output = vert;
+
+        if (Format::Position::unorm16 == format.pos_) {
+            for (int i = 0; i < 3; ++i) {
+                const auto min = bounds.pos_min_[i];
+                const auto max = bounds.pos_max_[i];
+                const auto q = dal::encode_unorm16(vert.pos_[i], min, max);
+                output.pos_[i] = dal::decode_unorm16(q, min, max);
+            }
+        }
+
+        if (Format::Normal::oct16 == format.normal_)
+            output.normal_ = dal::decode_oct16(dal::encode_oct16(vert.normal_));
+
+        if (Format::Uv::float16 == format.uv_) {
+            for (int i = 0; i < 2; ++i)
+                output.uv_[i] = dal::half_to_float(
+                    dal::float_to_half(vert.uv_[i])
+                );
+        } else if (Format::Uv::unorm16 == format.uv_) {
+            for (int i = 0; i < 2; ++i) {
+                const auto min = bounds.uv_min_[i];
+                const auto max = bounds.uv_max_[i];
+                const auto q = dal::encode_unorm16(vert.uv_[i], min, max);
+                output.uv_[i] = dal::decode_unorm16(q, min, max);
+            }
+        }
+
+        return output;
+    }
+
+    template <typename _Mesh>
+    void measure_units_error(
+        dalp::VertexQuantizationError& output,
+        const std::vector<dalp::RenderUnit<_Mesh>>& units
+    ) {
+        for (auto& unit : units) {
+            const auto& mesh = unit.mesh_;
+            if (mesh.vertex_format_.is_full())
+                continue;
+
+            const auto bounds = ::calc_vertex_bounds(mesh.vertices_);
+            for (auto& vert : mesh.vertices_) {
+                const auto q = ::quantize_vertex(
+                    vert, mesh.vertex_format_, bounds
+                );
+
+                output.pos_ = std::max(
+                    output.pos_, glm::distance(vert.pos_, q.pos_)
+                );
+
+                const auto n_len = glm::length(vert.normal_);
+                if (n_len > 0) {
+                    const auto cos = glm::dot(vert.normal_ / n_len, q.normal_);
+                    const auto rad = std::acos(std::clamp(cos, -1.f, 1.f));
+                    output.normal_deg_ = std::max(
+                        output.normal_deg_, glm::degrees(rad)
+                    );
+                }
+
+                for (int i = 0; i < 2; ++i) {
+                    output.uv_ = std::max(
+                        output.uv_, std::abs(vert.uv_[i] - q.uv_[i])
+                    );
+                }
+            }
+        }
+    }
+
+}  // namespace
+
+
 // Build render units
 namespace {
 
@@ -220,12 +601,187 @@ namespace {
         );
     }
 
+    template <typename _Vertex>
+    void build_bin_indices(
+        ::BinaryBuildBuffer& output,
+        const dalp::TMesh_Indexed<_Vertex>& mesh,
+        const ::BuildParams& params
+    ) {
+        constexpr size_t U16_VERTEX_LIMIT = 65536;
+
+        output.append_int64(mesh.indices_.size());
+
+        if (params.revision_ < 1) {
+            for (auto index : mesh.indices_) {
+                output.append_int32(index);
+            }
+            return;
+        }
+
+        if (params.compact_indices_ &&
+            mesh.vertices_.size() <= U16_VERTEX_LIMIT) {
+            output.append_int32(2);
+            std::vector<uint16_t> narrow(
+                mesh.indices_.begin(), mesh.indices_.end()
+            );
+            output.append_array(narrow.data(), narrow.size());
+        } else {
+            output.append_int32(4);
+            output.append_array(mesh.indices_.data(), mesh.indices_.size());
+        }
+    }
+
+    template <typename _Vertex>
+    void build_bin_vertex_attribs(
+        ::BinaryBuildBuffer& output,
+        const _Vertex& vert,
+        const dalp::VertexFormat& format,
+        const ::VertexBounds& bounds
+    ) {
+        using Format = dalp::VertexFormat;
+
+        if (Format::Position::unorm16 == format.pos_) {
+            uint16_t buf[3];
+            for (int i = 0; i < 3; ++i)
+                buf[i] = dal::encode_unorm16(
+                    vert.pos_[i], bounds.pos_min_[i], bounds.pos_max_[i]
+                );
+            output.append_array(buf, 3);
+        } else {
+            output.append_float32_array(&vert.pos_[0], 3);
+        }
+
+        if (Format::Normal::oct16 == format.normal_) {
+            const auto oct = dal::encode_oct16(vert.normal_);
+            output.append_array(oct.data(), oct.size());
+        } else {
+            output.append_float32_array(&vert.normal_[0], 3);
+        }
+
+        if (Format::Uv::float16 == format.uv_) {
+            const uint16_t buf[2]{ dal::float_to_half(vert.uv_.x),
+                                   dal::float_to_half(vert.uv_.y) };
+            output.append_array(buf, 2);
+        } else if (Format::Uv::unorm16 == format.uv_) {
+            uint16_t buf[2];
+            for (int i = 0; i < 2; ++i)
+                buf[i] = dal::encode_unorm16(
+                    vert.uv_[i], bounds.uv_min_[i], bounds.uv_max_[i]
+                );
+            output.append_array(buf, 2);
+        } else {
+            output.append_float32_array(&vert.uv_[0], 2);
+        }
+    }
+
+    void build_bin_vertex_skin(
+        ::BinaryBuildBuffer& output,
+        const dalp::VertexJoint& vert,
+        const dalp::VertexFormat& format
+    ) {
+        using Format = dalp::VertexFormat;
+        constexpr auto J_ELEM = dalp::NUM_JOINTS_PER_VERTEX;
+
+        if (format.is_full_skin()) {
+            output.append_float32_array(&vert.joint_weights_[0], J_ELEM);
+            output.append_array(&vert.joint_indices_[0], J_ELEM);
+            return;
+        }
+
+        // Valid influences first, by descending weight
+        std::array<int, J_ELEM> order;
+        for (int i = 0; i < J_ELEM; ++i) order[i] = i;
+        const auto is_valid = [&](const int i) {
+            return vert.joint_weights_[i] > 0 &&
+                   vert.joint_indices_[i] != dalp::NULL_JID;
+        };
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            if (is_valid(a) != is_valid(b))
+                return is_valid(a);
+            return vert.joint_weights_[a] > vert.joint_weights_[b];
+        });
+
+        const auto count = ::stored_influences(format);
+        float weights[J_ELEM];
+        int32_t indices[J_ELEM];
+        for (uint32_t i = 0; i < count; ++i) {
+            const auto valid = is_valid(order[i]);
+            weights[i] = valid ? vert.joint_weights_[order[i]] : 0;
+            indices[i] = valid ? vert.joint_indices_[order[i]] : dalp::NULL_JID;
+        }
+
+        if (Format::JointWeight::float32 == format.joint_weight_) {
+            output.append_float32_array(weights, count);
+        } else if (Format::JointWeight::unorm8 == format.joint_weight_) {
+            uint32_t q[J_ELEM];
+            dal::encode_unorm_weights(weights, count, 255, q);
+            const std::vector<uint8_t> narrow(q, q + count);
+            output.append_raw_array(narrow.data(), narrow.size());
+        } else {
+            uint32_t q[J_ELEM];
+            dal::encode_unorm_weights(weights, count, 65535, q);
+            const std::vector<uint16_t> narrow(q, q + count);
+            output.append_array(narrow.data(), narrow.size());
+        }
+
+        if (Format::JointIndex::uint8 == format.joint_index_) {
+            uint8_t narrow[J_ELEM];
+            for (uint32_t i = 0; i < count; ++i)
+                narrow[i] = indices[i] < 0 ? 0xFF : indices[i];
+            output.append_raw_array(narrow, count);
+        } else if (Format::JointIndex::uint16 == format.joint_index_) {
+            uint16_t narrow[J_ELEM];
+            for (uint32_t i = 0; i < count; ++i)
+                narrow[i] = indices[i] < 0 ? 0xFFFF : indices[i];
+            output.append_array(narrow, count);
+        } else {
+            output.append_array(indices, count);
+        }
+    }
+
+    // Writes what revision 2 puts between the vertex count and the vertices
+    template <typename _Vertex>
+    ::VertexBounds build_bin_vertex_format(
+        ::BinaryBuildBuffer& output, const dalp::TMesh_Indexed<_Vertex>& mesh
+    ) {
+        using Format = dalp::VertexFormat;
+        const auto& format = mesh.vertex_format_;
+        const auto bounds = ::calc_vertex_bounds(mesh.vertices_);
+
+        constexpr bool SKINNED = std::is_same_v<_Vertex, dalp::VertexJoint>;
+        output.append_int32(::pack_vertex_format(format, SKINNED));
+        if (Format::Position::unorm16 == format.pos_) {
+            output.append_float32_array(&bounds.pos_min_[0], 3);
+            output.append_float32_array(&bounds.pos_max_[0], 3);
+        }
+        if (Format::Uv::unorm16 == format.uv_) {
+            output.append_float32_array(&bounds.uv_min_[0], 2);
+            output.append_float32_array(&bounds.uv_max_[0], 2);
+        }
+
+        return bounds;
+    }
+
     void build_bin_mesh_indexed(
-        ::BinaryBuildBuffer& output, const dalp::Mesh_Indexed& mesh
+        ::BinaryBuildBuffer& output,
+        const dalp::Mesh_Indexed& mesh,
+        const ::BuildParams& params
     ) {
         static_assert(32 == sizeof(dalp::Mesh_Indexed::VERT_TYPE));
 
         output.append_int64(mesh.vertices_.size());
+
+        if (params.revision_ >= 2) {
+            const auto bounds = ::build_bin_vertex_format(output, mesh);
+            for (auto& vert : mesh.vertices_) {
+                ::build_bin_vertex_attribs(
+                    output, vert, mesh.vertex_format_, bounds
+                );
+            }
+            ::build_bin_indices(output, mesh, params);
+            return;
+        }
+
         for (auto& vert : mesh.vertices_) {
             output.append_float32(vert.pos_.x);
             output.append_float32(vert.pos_.y);
@@ -239,18 +795,30 @@ namespace {
             output.append_float32(vert.uv_.y);
         }
 
-        output.append_int64(mesh.indices_.size());
-        for (auto index : mesh.indices_) {
-            output.append_int32(index);
-        }
+        ::build_bin_indices(output, mesh, params);
     }
 
     void build_bin_mesh_indexed_joint(
-        ::BinaryBuildBuffer& output, const dalp::Mesh_IndexedJoint& mesh
+        ::BinaryBuildBuffer& output,
+        const dalp::Mesh_IndexedJoint& mesh,
+        const ::BuildParams& params
     ) {
         static_assert(64 == sizeof(dalp::Mesh_IndexedJoint::VERT_TYPE));
 
         output.append_int64(mesh.vertices_.size());
+
+        if (params.revision_ >= 2) {
+            const auto bounds = ::build_bin_vertex_format(output, mesh);
+            for (auto& vert : mesh.vertices_) {
+                ::build_bin_vertex_attribs(
+                    output, vert, mesh.vertex_format_, bounds
+                );
+                ::build_bin_vertex_skin(output, vert, mesh.vertex_format_);
+            }
+            ::build_bin_indices(output, mesh, params);
+            return;
+        }
+
         for (auto& vert : mesh.vertices_) {
             output.append_float32(vert.pos_.x);
             output.append_float32(vert.pos_.y);
@@ -274,59 +842,344 @@ namespace {
             output.append_int32(vert.joint_indices_.w);
         }
 
-        output.append_int64(mesh.indices_.size());
-        for (auto index : mesh.indices_) {
-            output.append_int32(index);
-        }
+        ::build_bin_indices(output, mesh, params);
     }
 
 }  // namespace
 
 
-namespace dal::parser {
+// Build optional sections
+namespace {
 
-    ModelExportResult build_binary_model(
-        std::vector<uint8_t>& output,
-        const Model& input,
-        CompressMethod comp_method
+    template <typename _Mesh>
+    void build_bin_unit_lods(
+        ::BinaryBuildBuffer& output,
+        const std::vector<dalp::RenderUnit<_Mesh>>& units
     ) {
-        BinaryBuildBuffer buffer;
+        output.append_int64(units.size());
+        for (auto& unit : units) {
+            output.append_int32(unit.mesh_.lods_.size());
+            for (auto& lod : unit.mesh_.lods_) {
+                output.append_float32(lod.error_);
+                output.append_int64(lod.indices_.size());
+                output.append_array(lod.indices_.data(), lod.indices_.size());
+            }
+        }
+    }
+
+    template <typename _Mesh>
+    bool has_lods(const std::vector<dalp::RenderUnit<_Mesh>>& units) {
+        for (auto& unit : units) {
+            if (!unit.mesh_.lods_.empty())
+                return true;
+        }
+        return false;
+    }
 
-        ::append_bin_aabb(buffer, input.aabb_);
-        ::build_bin_skeleton(buffer, input.skeleton_);
-        ::build_bin_animation(buffer, input.animations_);
+    void build_bin_lods(::SectionWriter& output, const dalp::Model& model) {
+        if (!::has_lods(model.units_indexed_) &&
+            !::has_lods(model.units_indexed_joint_))
+            return;
 
-        buffer.append_int64(input.units_straight_.size());
-        for (auto& unit : input.units_straight_) {
-            buffer.append_str(unit.name_);
-            ::build_bin_material(buffer, unit.material_);
-            ::build_bin_mesh_straight(buffer, unit.mesh_);
+        output.add_optional(
+            dalp::DMD_SECTION_LODS, [&](::BinaryBuildBuffer& section) {
+                ::build_bin_unit_lods(section, model.units_indexed_);
+                ::build_bin_unit_lods(section, model.units_indexed_joint_);
+            }
+        );
+    }
+
+    template <typename _Mesh>
+    void build_bin_unit_meshlets(
+        ::BinaryBuildBuffer& output,
+        const std::vector<dalp::RenderUnit<_Mesh>>& units
+    ) {
+        output.append_int64(units.size());
+        for (auto& unit : units) {
+            const auto& set = unit.mesh_.meshlets_;
+
+            output.append_int64(set.meshlets_.size());
+            for (auto& meshlet : set.meshlets_) {
+                output.append_int32(meshlet.vertex_offset_);
+                output.append_int32(meshlet.vertex_count_);
+                output.append_int32(meshlet.triangle_offset_);
+                output.append_int32(meshlet.triangle_count_);
+
+                output.append_float32_array(&meshlet.center_[0], 3);
+                output.append_float32(meshlet.radius_);
+                output.append_float32_array(&meshlet.cone_apex_[0], 3);
+                output.append_float32_array(&meshlet.cone_axis_[0], 3);
+                output.append_float32(meshlet.cone_cutoff_);
+            }
+
+            output.append_int64(set.vertices_.size());
+            output.append_array(set.vertices_.data(), set.vertices_.size());
+            output.append_int64(set.triangles_.size());
+            output.append_raw_array(
+                set.triangles_.data(), set.triangles_.size()
+            );
         }
+    }
 
-        buffer.append_int64(input.units_straight_joint_.size());
-        for (auto& unit : input.units_straight_joint_) {
-            buffer.append_str(unit.name_);
-            ::build_bin_material(buffer, unit.material_);
-            ::build_bin_mesh_straight_joint(buffer, unit.mesh_);
+    template <typename _Mesh>
+    bool has_meshlets(const std::vector<dalp::RenderUnit<_Mesh>>& units) {
+        for (auto& unit : units) {
+            if (!unit.mesh_.meshlets_.empty())
+                return true;
         }
+        return false;
+    }
 
-        buffer.append_int64(input.units_indexed_.size());
-        for (auto& unit : input.units_indexed_) {
-            buffer.append_str(unit.name_);
-            ::build_bin_material(buffer, unit.material_);
-            ::build_bin_mesh_indexed(buffer, unit.mesh_);
+    void build_bin_meshlets(::SectionWriter& output, const dalp::Model& model) {
+        if (!::has_meshlets(model.units_indexed_) &&
+            !::has_meshlets(model.units_indexed_joint_))
+            return;
+
+        output.add_optional(
+            dalp::DMD_SECTION_MESHLETS,
+            [&](::BinaryBuildBuffer& section) {
+                ::build_bin_unit_meshlets(section, model.units_indexed_);
+                ::build_bin_unit_meshlets(section, model.units_indexed_joint_);
+            }
+        );
+    }
+
+    template <typename _Mesh>
+    void build_bin_unit_bounds(
+        ::BinaryBuildBuffer& output,
+        const std::vector<dalp::RenderUnit<_Mesh>>& units
+    ) {
+        output.append_int64(units.size());
+        for (auto& unit : units) {
+            ::append_bin_aabb(output, unit.aabb_);
+            output.append_float32_array(&unit.sphere_.center_[0], 3);
+            output.append_float32(unit.sphere_.radius_);
         }
+    }
+
+    void build_bin_bounds(::SectionWriter& output, const dalp::Model& model) {
+        const auto unit_count = model.units_straight_.size() +
+                                model.units_straight_joint_.size() +
+                                model.units_indexed_.size() +
+                                model.units_indexed_joint_.size();
+        if (0 == unit_count)
+            return;
+
+        output.add_optional(
+            dalp::DMD_SECTION_BOUNDS,
+            [&](::BinaryBuildBuffer& section) {
+                ::build_bin_unit_bounds(section, model.units_straight_);
+                ::build_bin_unit_bounds(section, model.units_straight_joint_);
+                ::build_bin_unit_bounds(section, model.units_indexed_);
+                ::build_bin_unit_bounds(section, model.units_indexed_joint_);
+            }
+        );
+    }
+
+    void build_bin_instances(
+        ::SectionWriter& output, const dalp::Model& model
+    ) {
+        if (!::has_instances(model))
+            return;
+
+        output.add_optional(
+            dalp::DMD_SECTION_INSTANCES,
+            [&](::BinaryBuildBuffer& section) {
+                section.append_int64(model.units_indexed_.size());
+                for (auto& unit : model.units_indexed_) {
+                    section.append_int64(unit.instances_.size());
+                    for (auto& m : unit.instances_)
+                        section.append_mat4(m);
+                }
+            }
+        );
+    }
 
-        buffer.append_int64(input.units_indexed_joint_.size());
+    void build_bin_bvh(::SectionWriter& output, const dalp::Model& model) {
+        const auto& bvh = model.bvh_;
+        if (bvh.empty())
+            return;
+
+        output.add_optional(
+            dalp::DMD_SECTION_BVH, [&](::BinaryBuildBuffer& section) {
+                section.append_int64(bvh.nodes_.size());
+                for (auto& node : bvh.nodes_) {
+                    section.append_float32_array(&node.min_[0], 3);
+                    section.append_int32(node.offset_);
+                    section.append_float32_array(&node.max_[0], 3);
+                    section.append_int32(node.count_);
+                }
+
+                section.append_int64(bvh.triangles_.size());
+                for (auto& tri : bvh.triangles_) {
+                    section.append_int32(tri.unit_);
+                    section.append_int32(tri.triangle_);
+                }
+            }
+        );
+    }
+
+}  // namespace
+
+
+// Build collision
+namespace {
+
+    void build_bin_collision_geometry(
+        ::BinaryBuildBuffer& output, const dalp::CollisionGeometry& geometry
+    ) {
+        output.append_int64(geometry.vertices_.size());
+        for (auto& v : geometry.vertices_)
+            output.append_float32_array(&v[0], 3);
+
+        output.append_int64(geometry.indices_.size());
+        for (const auto i : geometry.indices_)
+            output.append_int32(static_cast<int32_t>(i));
+    }
+
+    void build_bin_collision(
+        ::BinaryBuildBuffer& output, const dalp::CollisionScene& scene
+    ) {
+        output.append_int64(scene.meshes_.size());
+        for (auto& mesh : scene.meshes_) {
+            output.append_str(mesh.name_);
+            output.append_int64(mesh.hulls_.size());
+            for (auto& hull : mesh.hulls_)
+                ::build_bin_collision_geometry(output, hull);
+            ::build_bin_collision_geometry(output, mesh.trimesh_);
+        }
+
+        output.append_int64(scene.actors_.size());
+        for (auto& actor : scene.actors_) {
+            output.append_str(actor.name_);
+            output.append_mat4(actor.transform_);
+            output.append_int64(actor.meshes_.size());
+            for (const auto i : actor.meshes_)
+                output.append_int32(static_cast<int32_t>(i));
+        }
+    }
+
+}  // namespace
+
+
+namespace dal::parser {
+
+    ModelExportResult build_binary_model(
+        std::vector<uint8_t>& output,
+        const Model& input,
+        const ModelExportConfig& config
+    ) {
         for (auto& unit : input.units_indexed_joint_) {
-            buffer.append_str(unit.name_);
-            ::build_bin_material(buffer, unit.material_);
-            ::build_bin_mesh_indexed_joint(buffer, unit.mesh_);
+            if (!::fits_joint_index(unit.mesh_))
+                return ModelExportResult::invalid_vertex_format;
         }
 
-        auto zipped = ::compress_dal_model(
-            buffer.data(), buffer.size(), comp_method
+        ::BuildParams params;
+        params.revision_ = ::select_revision(input, config);
+        params.compact_indices_ = config.compact_indices_;
+        ::SectionWriter writer{ config.table_of_contents_ };
+
+        writer.add_core(
+            DMD_SECTION_AABB,
+            [&](::BinaryBuildBuffer& buffer) {
+                ::append_bin_aabb(buffer, input.aabb_);
+            }
+        );
+        writer.add_core(
+            DMD_SECTION_SKELETON,
+            [&](::BinaryBuildBuffer& buffer) {
+                ::build_bin_skeleton(buffer, input.skeleton_);
+            }
+        );
+        writer.add_core(
+            DMD_SECTION_ANIMATIONS,
+            [&](::BinaryBuildBuffer& buffer) {
+                ::build_bin_animation(buffer, input.animations_);
+            }
+        );
+
+        writer.add_core(
+            DMD_SECTION_UNITS_STRAIGHT,
+            [&](::BinaryBuildBuffer& buffer) {
+                buffer.append_int64(input.units_straight_.size());
+                for (auto& unit : input.units_straight_) {
+                    buffer.append_str(unit.name_);
+                    ::build_bin_material(buffer, unit.material_);
+                    ::build_bin_mesh_straight(buffer, unit.mesh_);
+                }
+            }
+        );
+
+        writer.add_core(
+            DMD_SECTION_UNITS_STRAIGHT_JOINT,
+            [&](::BinaryBuildBuffer& buffer) {
+                buffer.append_int64(input.units_straight_joint_.size());
+                for (auto& unit : input.units_straight_joint_) {
+                    buffer.append_str(unit.name_);
+                    ::build_bin_material(buffer, unit.material_);
+                    ::build_bin_mesh_straight_joint(buffer, unit.mesh_);
+                }
+            }
+        );
+
+        writer.add_core(
+            DMD_SECTION_UNITS_INDEXED,
+            [&](::BinaryBuildBuffer& buffer) {
+                buffer.append_int64(input.units_indexed_.size());
+                for (auto& unit : input.units_indexed_) {
+                    buffer.append_str(unit.name_);
+                    ::build_bin_material(buffer, unit.material_);
+                    ::build_bin_mesh_indexed(buffer, unit.mesh_, params);
+                }
+            }
         );
+
+        writer.add_core(
+            DMD_SECTION_UNITS_INDEXED_JOINT,
+            [&](::BinaryBuildBuffer& buffer) {
+                buffer.append_int64(input.units_indexed_joint_.size());
+                for (auto& unit : input.units_indexed_joint_) {
+                    buffer.append_str(unit.name_);
+                    ::build_bin_material(buffer, unit.material_);
+                    ::build_bin_mesh_indexed_joint(buffer, unit.mesh_, params);
+                }
+            }
+        );
+
+        // Written only when used so files without them stay readable by
+        // readers that predate sections
+        if (config.unit_bounds_)
+            ::build_bin_bounds(writer, input);
+        ::build_bin_lods(writer, input);
+        ::build_bin_meshlets(writer, input);
+        ::build_bin_instances(writer, input);
+        ::build_bin_bvh(writer, input);
+
+        std::optional<std::vector<uint8_t>> zipped;
+        if (config.table_of_contents_) {
+            zipped = ::assemble_toc_model(
+                writer.sections(), config.comp_method_, params.revision_
+            );
+        } else if (config.block_size_ > 0 &&
+                   config.comp_method_ != CompressMethod::none) {
+            const auto& payload = writer.payload();
+            zipped = ::compress_dal_model_framed(
+                payload.data(),
+                payload.size(),
+                config.comp_method_,
+                params.revision_,
+                config.block_size_,
+                config.thread_count_
+            );
+        } else {
+            const auto& payload = writer.payload();
+            zipped = ::compress_dal_model(
+                payload.data(),
+                payload.size(),
+                config.comp_method_,
+                params.revision_
+            );
+        }
         if (!zipped.has_value())
             return ModelExportResult::compression_failure;
 
@@ -334,6 +1187,34 @@ namespace dal::parser {
         return ModelExportResult::success;
     }
 
+    std::optional<std::vector<uint8_t>> build_binary_model(
+        const Model& input, const ModelExportConfig& config
+    ) {
+        std::vector<uint8_t> result;
+        const auto res = build_binary_model(result, input, config);
+        if (ModelExportResult::success != res)
+            return std::nullopt;
+        else
+            return result;
+    }
+
+    VertexQuantizationError measure_quantization_error(const Model& model) {
+        VertexQuantizationError output;
+        ::measure_units_error(output, model.units_indexed_);
+        ::measure_units_error(output, model.units_indexed_joint_);
+        return output;
+    }
+
+    ModelExportResult build_binary_model(
+        std::vector<uint8_t>& output,
+        const Model& input,
+        CompressMethod comp_method
+    ) {
+        ModelExportConfig config;
+        config.comp_method_ = comp_method;
+        return build_binary_model(output, input, config);
+    }
+
     std::optional<std::vector<uint8_t>> build_binary_model(
         const Model& input, CompressMethod comp_method
     ) {
@@ -345,4 +1226,19 @@ namespace dal::parser {
             return result;
     }
 
+    std::optional<std::vector<uint8_t>> build_binary_collision(
+        const CollisionScene& input, const CompressMethod comp_method
+    ) {
+        ::BinaryBuildBuffer buffer;
+        ::build_bin_collision(buffer, input);
+
+        return ::compress_dal_model(
+            buffer.data(),
+            buffer.size(),
+            comp_method,
+            DCOL_REVISION_LATEST,
+            MAGIC_NUMBERS_DAL_COLLISION
+        );
+    }
+
 }  // namespace dal::parser
@@ -1,12 +1,17 @@
 #include "daltools/dmd/parser.h"
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
 #include <stdexcept>
 
-#include <sung/basic/bytes.hpp>
-
 #include "daltools/common/byte_tool.h"
 #include "daltools/common/compression.h"
 #include "daltools/common/konst.h"
+#include "daltools/common/quantize.h"
+#include "daltools/common/util.h"
+#include "daltools/scene/bvh.h"
 
 
 namespace dalp = dal::parser;
@@ -14,47 +19,242 @@ namespace dalp = dal::parser;
 
 namespace {
 
-    std::optional<std::vector<uint8_t>> unzip_dal_model(sung::BytesReader& r) {
-        const auto comp_method = (dal::CompressMethod)r.read_int32().value();
-        const auto expected_unzipped_size = r.read_int64().value();
+    constexpr size_t PAYLOAD_BUFFER_SIZE = 64 * 1024;
+
+    // Files are little endian. Cached since it's checked on every read.
+    const bool IS_BIG_ENDIAN = dalp::is_big_endian();
+
+    // Of `count` elements of `_Size` bytes
+    template <size_t _Size>
+    void fix_endian(void* const data, const size_t count) {
+        if (!::IS_BIG_ENDIAN)
+            return;
+
+        const auto bytes = static_cast<uint8_t*>(data);
+        for (size_t i = 0; i < count; ++i)
+            std::reverse(bytes + _Size * i, bytes + _Size * (i + 1));
+    }
+
+
+    // Reads a payload that is either in memory or pulled out of a
+    // `DecompressStream` as parsing goes, with the same methods as
+    // `sung::BytesReader`. The header stores the decompressed size, so
+    // `remaining` is known without decompressing ahead.
+    class PayloadReader {
+
+    public:
+        PayloadReader(const uint8_t* data, size_t size)
+            : window_(data), window_end_(size), limit_(size), size_(size) {}
+
+        PayloadReader(dal::DecompressStream& stream, size_t size)
+            : stream_(&stream)
+            , buffer_(PAYLOAD_BUFFER_SIZE)
+            , window_(buffer_.data())
+            , limit_(size)
+            , size_(size) {}
+
+        size_t remaining() const { return this->limit_ - this->pos_; }
+
+        bool is_eof() const { return this->pos_ >= this->limit_; }
+
+        // Large reads decompress straight into `dst`
+        bool read_raw(void* const dst, const size_t size) {
+            if (size > this->remaining())
+                return false;
+            if (size > this->window_end_ - this->window_pos_)
+                return this->read_stream(static_cast<uint8_t*>(dst), size);
 
-        if (comp_method == dal::CompressMethod::none) {
-            std::vector<uint8_t> output{ r.head(), r.head() + r.remaining() };
+            std::memcpy(dst, this->window_ + this->window_pos_, size);
+            this->window_pos_ += size;
+            this->pos_ += size;
+            return true;
+        }
+
+        bool advance(size_t size) {
+            if (size > this->remaining())
+                return false;
+            if (size <= this->window_end_ - this->window_pos_) {
+                this->window_pos_ += size;
+                this->pos_ += size;
+                return true;
+            }
+
+            std::array<uint8_t, 256> trash;
+            while (size > 0) {
+                const auto chunk = std::min(size, trash.size());
+                if (!this->read_raw(trash.data(), chunk))
+                    return false;
+                size -= chunk;
+            }
+            return true;
+        }
+
+        // Limits reading to the next `size` bytes. Pass the returned value
+        // to `pop_limit` to undo it.
+        size_t push_limit(const size_t size) {
+            const auto output = this->limit_;
+            this->limit_ = this->pos_ + std::min(size, this->remaining());
             return output;
-        } else if (comp_method == dal::CompressMethod::zip) {
-            const auto unzipped = dal::decomp_zip(
-                dal::BinDataView{ r.head(), r.remaining() },
-                expected_unzipped_size
-            );
-            if (unzipped.has_value())
-                return unzipped.value();
-            else
+        }
+
+        void pop_limit(const size_t limit) { this->limit_ = limit; }
+
+        template <typename T>
+        std::optional<T> read_scalar() {
+            T output;
+            if (!this->read_raw(&output, sizeof(T)))
                 return std::nullopt;
-        } else if (comp_method == dal::CompressMethod::brotli) {
-            const auto unzipped = dal::decomp_bro(
-                r.head(), r.remaining(), expected_unzipped_size
-            );
+            ::fix_endian<sizeof(T)>(&output, 1);
+            return output;
+        }
 
-            if (unzipped.has_value())
-                return unzipped.value();
-            else
+        std::optional<int32_t> read_int32() {
+            return this->read_scalar<int32_t>();
+        }
+
+        std::optional<int64_t> read_int64() {
+            return this->read_scalar<int64_t>();
+        }
+
+        std::optional<float> read_float32() {
+            return this->read_scalar<float>();
+        }
+
+        std::optional<bool> read_bool() {
+            uint8_t buf;
+            if (!this->read_raw(&buf, 1))
+                return std::nullopt;
+            return 0 != buf;
+        }
+
+        bool read_float32_arr(float* const dst, const size_t count) {
+            if (count > this->remaining() / 4)
+                return false;
+            if (!this->read_raw(dst, count * 4))
+                return false;
+            ::fix_endian<4>(dst, count);
+            return true;
+        }
+
+        template <size_t N>
+        std::optional<std::array<float, N>> read_float32_arr() {
+            std::array<float, N> output;
+            if (!this->read_float32_arr(output.data(), N))
                 return std::nullopt;
+            return output;
         }
 
+        bool read_int32_arr(int32_t* const dst, const size_t count) {
+            if (count > this->remaining() / 4)
+                return false;
+            if (!this->read_raw(dst, count * 4))
+                return false;
+            ::fix_endian<4>(dst, count);
+            return true;
+        }
 
-        const auto unzipped = dal::decomp_bro(
-            r.head(), r.remaining(), expected_unzipped_size
-        );
+        // Stops at the null terminator or the end
+        std::string read_nt_str() {
+            std::string output;
+            char c;
+            while (this->read_raw(&c, 1) && '\0' != c) output.push_back(c);
+            return output;
+        }
+
+    private:
+        // Kept out of `read_raw` so that small reads inline well. Only
+        // called in stream mode, since in memory mode the window is the
+        // whole payload.
+        bool read_stream(uint8_t* out, size_t size) {
+            const auto buffered = this->window_end_ - this->window_pos_;
+            std::memcpy(out, this->window_ + this->window_pos_, buffered);
+            this->pos_ += buffered;
+            out += buffered;
+            size -= buffered;
+            this->window_pos_ = 0;
+            this->window_end_ = 0;
+
+            if (size >= this->buffer_.size()) {
+                if (this->stream_->read(out, size) != size)
+                    return false;
+                this->pos_ += size;
+                return true;
+            }
+
+            // Never decompress past the payload
+            const auto refill = std::min(
+                this->buffer_.size(), this->size_ - this->pos_
+            );
+            this->window_end_ = this->stream_->read(
+                this->buffer_.data(), refill
+            );
+            if (this->window_end_ < size)
+                return false;
+
+            std::memcpy(out, this->buffer_.data(), size);
+            this->window_pos_ = size;
+            this->pos_ += size;
+            return true;
+        }
+
+        dal::DecompressStream* stream_ = nullptr;
+        std::vector<uint8_t> buffer_;
+        // The whole payload in memory mode, or what is left in `buffer_`
+        const uint8_t* window_ = nullptr;
+        size_t window_pos_ = 0;
+        size_t window_end_ = 0;
+        // Bytes of the payload consumed so far
+        size_t pos_ = 0;
+        size_t limit_ = 0;
+        size_t size_ = 0;
+    };
+
+
+    enum class PayloadResult { success, parse_failed, decompression_failed };
+
+    // Runs `parse` on the payload at `src` while decompressing it. Reads
+    // past a broken stream throw, which is reported as a decompression
+    // failure rather than a bug.
+    template <typename _Parse>
+    ::PayloadResult parse_payload(
+        const uint8_t* const src,
+        const size_t src_size,
+        const dal::CompressMethod method,
+        const size_t payload_size,
+        _Parse&& parse
+    ) {
+        if (dal::CompressMethod::none == method) {
+            ::PayloadReader r{ src, src_size };
+            if (parse(r))
+                return ::PayloadResult::success;
+            else
+                return ::PayloadResult::parse_failed;
+        }
 
-        if (unzipped.has_value())
-            return unzipped.value();
+        dal::DecompressStream stream{ method, src, src_size };
+        ::PayloadReader r{ stream, payload_size };
+        bool parsed = false;
+        try {
+            parsed = parse(r);
+        } catch (const std::exception&) {
+            if (!stream.failed())
+                throw;
+        }
+
+        if (stream.failed())
+            return ::PayloadResult::decompression_failed;
+        else if (parsed)
+            return ::PayloadResult::success;
         else
-            return std::nullopt;
+            return ::PayloadResult::parse_failed;
     }
 
-    bool is_magic_numbers_correct(const uint8_t* const buf) {
+    bool is_magic_numbers_correct(
+        const uint8_t* const buf,
+        const char* const magic_numbers = dalp::MAGIC_NUMBERS_DAL_MODEL
+    ) {
         for (int i = 0; i < dalp::MAGIC_NUMBER_SIZE; ++i) {
-            if (buf[i] != dalp::MAGIC_NUMBERS_DAL_MODEL[i]) {
+            if (buf[i] != static_cast<uint8_t>(magic_numbers[i])) {
                 return false;
             }
         }
@@ -68,7 +268,7 @@ namespace {
 // Parser functions
 namespace {
 
-    void parse_aabb(sung::BytesReader& r, dal::parser::AABB3& output) {
+    void parse_aabb(::PayloadReader& r, dal::parser::AABB3& output) {
         output.min_.x = r.read_float32().value();
         output.min_.y = r.read_float32().value();
         output.min_.z = r.read_float32().value();
@@ -77,7 +277,7 @@ namespace {
         output.max_.z = r.read_float32().value();
     }
 
-    void parse_mat4(sung::BytesReader& r, glm::mat4& mat) {
+    void parse_mat4(::PayloadReader& r, glm::mat4& mat) {
         for (glm::mat4::length_type row = 0; row < 4; ++row) {
             for (glm::mat4::length_type col = 0; col < 4; ++col) {
                 mat[col][row] = r.read_float32().value();
@@ -91,7 +291,7 @@ namespace {
 // Parse animations
 namespace {
 
-    void parse_skeleton(sung::BytesReader& r, dalp::Skeleton& output) {
+    void parse_skeleton(::PayloadReader& r, dalp::Skeleton& output) {
         ::parse_mat4(r, output.root_transform_);
 
         const auto joint_count = r.read_int32().value();
@@ -122,7 +322,7 @@ namespace {
         }
     }
 
-    void parse_animJoint(sung::BytesReader& r, dalp::AnimJoint& output) {
+    void parse_animJoint(::PayloadReader& r, dalp::AnimJoint& output) {
         {
             output.name_ = r.read_nt_str();
 
@@ -160,7 +360,7 @@ namespace {
     }
 
     void parse_animations(
-        sung::BytesReader& r, std::vector<dalp::Animation>& animations
+        ::PayloadReader& r, std::vector<dalp::Animation>& animations
     ) {
         const auto anim_count = r.read_int32().value();
         animations.resize(anim_count);
@@ -185,7 +385,7 @@ namespace {
 // Parse render units
 namespace {
 
-    void parse_material(sung::BytesReader& r, dalp::Material& material) {
+    void parse_material(::PayloadReader& r, dalp::Material& material) {
         material.roughness_ = r.read_float32().value();
         material.metallic_ = r.read_float32().value();
         material.transparency_ = r.read_bool().value();
@@ -196,7 +396,9 @@ namespace {
         material.normal_map_ = r.read_nt_str();
     }
 
-    void parse_mesh(sung::BytesReader& r, dalp::Mesh_Straight& mesh) {
+    void parse_mesh(
+        ::PayloadReader& r, dalp::Mesh_Straight& mesh, const int32_t revision
+    ) {
         const auto vert_count = r.read_int64().value();
         const auto vert_count_x_3 = vert_count * 3;
         const auto vert_count_x_2 = vert_count * 2;
@@ -214,7 +416,11 @@ namespace {
             throw std::runtime_error{ "Failed to read normals" };
     }
 
-    void parse_mesh(sung::BytesReader& r, dalp::Mesh_StraightJoint& mesh) {
+    void parse_mesh(
+        ::PayloadReader& r,
+        dalp::Mesh_StraightJoint& mesh,
+        const int32_t revision
+    ) {
         const auto vert_count = r.read_int64().value();
         const auto vert_count_x_3 = vert_count * 3;
         const auto vert_count_x_2 = vert_count * 2;
@@ -242,96 +448,999 @@ namespace {
             throw std::runtime_error{ "Failed to read joint indices" };
     }
 
-    void parse_mesh(sung::BytesReader& r, dalp::Mesh_Indexed& mesh) {
-        const auto vertex_count = r.read_int64().value();
-        for (int64_t i = 0; i < vertex_count; ++i) {
-            auto& vert = mesh.vertices_.emplace_back();
+    template <typename _Vertex>
+    void parse_indices(
+        ::PayloadReader& r,
+        dalp::TMesh_Indexed<_Vertex>& mesh,
+        const int32_t revision
+    ) {
+        const auto index_count = r.read_int64().value();
+        mesh.index_width_ = revision < 1 ? 4 : r.read_int32().value();
+
+        if (index_count < 0 ||
+            static_cast<size_t>(index_count) > r.remaining() / 2)
+            throw std::runtime_error{ "Failed to read indices" };
+
+        if (4 == mesh.index_width_) {
+            static_assert(sizeof(int32_t) == sizeof(mesh.indices_[0]));
+            mesh.indices_.resize(index_count);
+            const auto dst = reinterpret_cast<int32_t*>(mesh.indices_.data());
+            if (!r.read_int32_arr(dst, mesh.indices_.size()))
+                throw std::runtime_error{ "Failed to read indices" };
+        } else if (2 == mesh.index_width_) {
+            std::vector<uint16_t> buffer(index_count);
+            if (!r.read_raw(buffer.data(), index_count * 2))
+                throw std::runtime_error{ "Failed to read indices" };
+
+            ::fix_endian<2>(buffer.data(), buffer.size());
+            mesh.indices_.assign(buffer.begin(), buffer.end());
+        } else {
+            throw std::runtime_error{ "Unknown index width" };
+        }
+    }
 
-            static_assert(sizeof(float) * 3 == sizeof(vert.pos_), "");
-            static_assert(sizeof(float) * 3 == sizeof(vert.normal_), "");
-            static_assert(sizeof(float) * 2 == sizeof(vert.uv_), "");
+    struct VertexBounds {
+        glm::vec3 pos_min_{ 0 };
+        glm::vec3 pos_max_{ 0 };
+        glm::vec2 uv_min_{ 0 };
+        glm::vec2 uv_max_{ 0 };
+    };
 
-            if (!r.read_float32_arr(&vert.pos_[0], 3))
-                throw std::runtime_error{ "Failed to read pos" };
-            if (!r.read_float32_arr(&vert.normal_[0], 3))
-                throw std::runtime_error{ "Failed to read normal" };
-            if (!r.read_float32_arr(&vert.uv_[0], 2))
-                throw std::runtime_error{ "Failed to read uv" };
+    uint16_t read_uint16(::PayloadReader& r) {
+        const auto output = r.read_scalar<uint16_t>();
+        if (!output.has_value())
+            throw std::runtime_error{ "Failed to read 16-bit value" };
+
+        return output.value();
+    }
+
+    // Revision 2 stores these between the vertex count and the vertices
+    ::VertexBounds parse_vertex_format(
+        ::PayloadReader& r,
+        dalp::VertexFormat& format,
+        const int32_t revision,
+        const bool skinned
+    ) {
+        using Format = dalp::VertexFormat;
+
+        const auto packed = r.read_int32().value();
+        const auto pos = packed & 0xF;
+        const auto normal = (packed >> 4) & 0xF;
+        const auto uv = (packed >> 8) & 0xF;
+        const auto skin = packed >> 12;
+        if (pos > 1 || normal > 1 || uv > 2)
+            throw std::runtime_error{ "Unknown vertex format" };
+        if (skin && (revision < 3 || !skinned))
+            throw std::runtime_error{ "Unknown vertex format" };
+
+        format.pos_ = static_cast<Format::Position>(pos);
+        format.normal_ = static_cast<Format::Normal>(normal);
+        format.uv_ = static_cast<Format::Uv>(uv);
+
+        const auto influences = skin & 0xF;
+        const auto joint_index = (skin >> 4) & 0xF;
+        const auto joint_weight = (skin >> 8) & 0xF;
+        if (influences > 2 || joint_index > 2 || joint_weight > 2 ||
+            (skin >> 12))
+            throw std::runtime_error{ "Unknown skin format" };
+
+        format.influences_ = 0 == influences ? 4 : influences;
+        format.joint_index_ = static_cast<Format::JointIndex>(joint_index);
+        format.joint_weight_ = static_cast<Format::JointWeight>(joint_weight);
+
+        ::VertexBounds bounds;
+        if (Format::Position::unorm16 == format.pos_) {
+            if (!r.read_float32_arr(&bounds.pos_min_[0], 3))
+                throw std::runtime_error{ "Failed to read position bounds" };
+            if (!r.read_float32_arr(&bounds.pos_max_[0], 3))
+                throw std::runtime_error{ "Failed to read position bounds" };
+        }
+        if (Format::Uv::unorm16 == format.uv_) {
+            if (!r.read_float32_arr(&bounds.uv_min_[0], 2))
+                throw std::runtime_error{ "Failed to read uv bounds" };
+            if (!r.read_float32_arr(&bounds.uv_max_[0], 2))
+                throw std::runtime_error{ "Failed to read uv bounds" };
         }
 
-        const auto index_count = r.read_int64().value();
-        for (int64_t i = 0; i < index_count; ++i)
-            mesh.indices_.push_back(r.read_int32().value());
+        return bounds;
     }
 
-    void parse_mesh(sung::BytesReader& r, dalp::Mesh_IndexedJoint& mesh) {
-        constexpr auto J_ELEM = dalp::NUM_JOINTS_PER_VERTEX;
-        const auto vertex_count = r.read_int64().value();
+    uint8_t read_uint8(::PayloadReader& r) {
+        uint8_t output;
+        if (!r.read_raw(&output, 1))
+            throw std::runtime_error{ "Failed to read 8-bit value" };
+
+        return output;
+    }
+
+    void parse_vertex_skin(
+        ::PayloadReader& r,
+        dalp::VertexJoint& vert,
+        const dalp::VertexFormat& format
+    ) {
+        using Format = dalp::VertexFormat;
+
+        const auto count = static_cast<int>(format.influences_);
+        vert.joint_weights_ = glm::vec4{ 0 };
+        vert.joint_indices_ = glm::ivec4{ dalp::NULL_JID };
+
+        switch (format.joint_weight_) {
+            case Format::JointWeight::unorm8:
+                for (int i = 0; i < count; ++i)
+                    vert.joint_weights_[i] = ::read_uint8(r) / 255.f;
+                break;
+            case Format::JointWeight::unorm16:
+                for (int i = 0; i < count; ++i)
+                    vert.joint_weights_[i] = ::read_uint16(r) / 65535.f;
+                break;
+            default:
+                if (!r.read_float32_arr(&vert.joint_weights_[0], count))
+                    throw std::runtime_error{ "Failed to read joint weights" };
+        }
+
+        switch (format.joint_index_) {
+            case Format::JointIndex::uint8:
+                for (int i = 0; i < count; ++i) {
+                    const auto index = ::read_uint8(r);
+                    if (0xFF != index)
+                        vert.joint_indices_[i] = index;
+                }
+                break;
+            case Format::JointIndex::uint16:
+                for (int i = 0; i < count; ++i) {
+                    const auto index = ::read_uint16(r);
+                    if (0xFFFF != index)
+                        vert.joint_indices_[i] = index;
+                }
+                break;
+            default:
+                if (!r.read_int32_arr(&vert.joint_indices_[0], count))
+                    throw std::runtime_error{ "Failed to read joint indices" };
+        }
+    }
+
+    template <typename _Vertex>
+    void parse_vertex_attribs(
+        ::PayloadReader& r,
+        _Vertex& vert,
+        const dalp::VertexFormat& format,
+        const ::VertexBounds& bounds
+    ) {
+        using Format = dalp::VertexFormat;
+
+        if (Format::Position::unorm16 == format.pos_) {
+            for (int i = 0; i < 3; ++i)
+                vert.pos_[i] = dal::decode_unorm16(
+                    ::read_uint16(r), bounds.pos_min_[i], bounds.pos_max_[i]
+                );
+        } else if (!r.read_float32_arr(&vert.pos_[0], 3)) {
+            throw std::runtime_error{ "Failed to read pos" };
+        }
+
+        if (Format::Normal::oct16 == format.normal_) {
+            std::array<int16_t, 2> oct;
+            oct[0] = static_cast<int16_t>(::read_uint16(r));
+            oct[1] = static_cast<int16_t>(::read_uint16(r));
+            vert.normal_ = dal::decode_oct16(oct);
+        } else if (!r.read_float32_arr(&vert.normal_[0], 3)) {
+            throw std::runtime_error{ "Failed to read normal" };
+        }
+
+        if (Format::Uv::float16 == format.uv_) {
+            for (int i = 0; i < 2; ++i)
+                vert.uv_[i] = dal::half_to_float(::read_uint16(r));
+        } else if (Format::Uv::unorm16 == format.uv_) {
+            for (int i = 0; i < 2; ++i)
+                vert.uv_[i] = dal::decode_unorm16(
+                    ::read_uint16(r), bounds.uv_min_[i], bounds.uv_max_[i]
+                );
+        } else if (!r.read_float32_arr(&vert.uv_[0], 2)) {
+            throw std::runtime_error{ "Failed to read uv" };
+        }
+    }
 
-        for (int64_t i = 0; i < vertex_count; ++i) {
-            auto& vert = mesh.vertices_.emplace_back();
+    // Bytes per vertex in the file
+    size_t calc_stored_vertex_size(
+        const dalp::VertexFormat& format, const bool skinned
+    ) {
+        using Format = dalp::VertexFormat;
 
-            static_assert(
-                sizeof(vert.joint_weights_) ==
-                sizeof(float) * dal::parser::NUM_JOINTS_PER_VERTEX
+        size_t output = 0;
+        output += Format::Position::unorm16 == format.pos_ ? 6 : 12;
+        output += Format::Normal::oct16 == format.normal_ ? 4 : 12;
+        output += Format::Uv::float32 == format.uv_ ? 8 : 4;
+        if (!skinned)
+            return output;
+
+        switch (format.joint_weight_) {
+            case Format::JointWeight::unorm8:
+                output += format.influences_;
+                break;
+            case Format::JointWeight::unorm16:
+                output += 2 * format.influences_;
+                break;
+            default:
+                output += 4 * format.influences_;
+        }
+        switch (format.joint_index_) {
+            case Format::JointIndex::uint8:
+                output += format.influences_;
+                break;
+            case Format::JointIndex::uint16:
+                output += 2 * format.influences_;
+                break;
+            default:
+                output += 4 * format.influences_;
+        }
+        return output;
+    }
+
+    // Checks the size of all vertices at once so the bulk paths below
+    // don't have to check each read
+    template <typename _Vertex>
+    void resize_vertices(
+        ::PayloadReader& r,
+        std::vector<_Vertex>& vertices,
+        const int64_t vertex_count,
+        const size_t stored_vertex_size
+    ) {
+        if (vertex_count < 0 ||
+            static_cast<size_t>(vertex_count) >
+                r.remaining() / stored_vertex_size)
+            throw std::runtime_error{ "Failed to read vertices" };
+
+        vertices.resize(vertex_count);
+    }
+
+    void parse_mesh(
+        ::PayloadReader& r, dalp::Mesh_Indexed& mesh, const int32_t revision
+    ) {
+        const auto vertex_count = r.read_int64().value();
+
+        ::VertexBounds bounds;
+        if (revision >= 2)
+            bounds = ::parse_vertex_format(
+                r, mesh.vertex_format_, revision, false
             );
-            static_assert(
-                sizeof(vert.joint_indices_) ==
-                sizeof(int32_t) * dal::parser::NUM_JOINTS_PER_VERTEX
+
+        const auto& format = mesh.vertex_format_;
+        ::resize_vertices(
+            r,
+            mesh.vertices_,
+            vertex_count,
+            ::calc_stored_vertex_size(format, false)
+        );
+
+        if (format.is_full()) {
+            // Same layout as the file, so it's one copy
+            static_assert(sizeof(dalp::Vertex) == sizeof(float) * 8);
+            static_assert(offsetof(dalp::Vertex, normal_) == 12);
+            static_assert(offsetof(dalp::Vertex, uv_) == 24);
+
+            const auto dst = reinterpret_cast<float*>(mesh.vertices_.data());
+            if (!r.read_float32_arr(dst, mesh.vertices_.size() * 8))
+                throw std::runtime_error{ "Failed to read vertices" };
+        } else {
+            for (auto& vert : mesh.vertices_)
+                ::parse_vertex_attribs(r, vert, format, bounds);
+        }
+
+        ::parse_indices(r, mesh, revision);
+    }
+
+    void parse_mesh(
+        ::PayloadReader& r,
+        dalp::Mesh_IndexedJoint& mesh,
+        const int32_t revision
+    ) {
+        // Vertices per read of the bulk path
+        constexpr size_t CHUNK_SIZE = 4096;
+        // Position, normal, UV, 4 weights and 4 indices
+        constexpr size_t FULL_STRIDE = 64;
+
+        const auto vertex_count = r.read_int64().value();
+
+        ::VertexBounds bounds;
+        if (revision >= 2)
+            bounds = ::parse_vertex_format(
+                r, mesh.vertex_format_, revision, true
             );
 
-            if (!r.read_float32_arr(&vert.pos_[0], 3))
-                throw std::runtime_error{ "Failed to read pos" };
-            if (!r.read_float32_arr(&vert.normal_[0], 3))
-                throw std::runtime_error{ "Failed to read normal" };
-            if (!r.read_float32_arr(&vert.uv_[0], 2))
-                throw std::runtime_error{ "Failed to read uv" };
-            if (!r.read_float32_arr(&vert.joint_weights_[0], J_ELEM))
-                throw std::runtime_error{ "Failed to read joint weights" };
-            if (!r.read_int32_arr(&vert.joint_indices_[0], J_ELEM))
-                throw std::runtime_error{ "Failed to read joint indices" };
+        const auto& format = mesh.vertex_format_;
+        ::resize_vertices(
+            r,
+            mesh.vertices_,
+            vertex_count,
+            ::calc_stored_vertex_size(format, true)
+        );
+
+        static_assert(
+            sizeof(dalp::VertexJoint::joint_weights_) ==
+            sizeof(float) * dal::parser::NUM_JOINTS_PER_VERTEX
+        );
+        static_assert(
+            sizeof(dalp::VertexJoint::joint_indices_) ==
+            sizeof(int32_t) * dal::parser::NUM_JOINTS_PER_VERTEX
+        );
+
+        if (!format.is_full() || !format.is_full_skin()) {
+            for (auto& vert : mesh.vertices_) {
+                ::parse_vertex_attribs(r, vert, format, bounds);
+                ::parse_vertex_skin(r, vert, format);
+            }
+            ::parse_indices(r, mesh, revision);
+            return;
         }
 
-        const auto index_count = r.read_int64().value();
-        for (int64_t i = 0; i < index_count; ++i)
-            mesh.indices_.push_back(r.read_int32().value());
+        // Fields are in a different order in memory, so chunks of the file
+        // are read at once and scattered
+        std::vector<uint8_t> chunk(
+            FULL_STRIDE * std::min(CHUNK_SIZE, mesh.vertices_.size())
+        );
+        for (size_t i = 0; i < mesh.vertices_.size(); i += CHUNK_SIZE) {
+            const auto count = std::min(CHUNK_SIZE, mesh.vertices_.size() - i);
+            if (!r.read_raw(chunk.data(), count * FULL_STRIDE))
+                throw std::runtime_error{ "Failed to read vertices" };
+            ::fix_endian<4>(chunk.data(), count * FULL_STRIDE / 4);
+
+            for (size_t j = 0; j < count; ++j) {
+                const auto src = chunk.data() + j * FULL_STRIDE;
+                auto& vert = mesh.vertices_[i + j];
+                std::memcpy(&vert.pos_[0], src, 12);
+                std::memcpy(&vert.normal_[0], src + 12, 12);
+                std::memcpy(&vert.uv_[0], src + 24, 8);
+                std::memcpy(&vert.joint_weights_[0], src + 32, 16);
+                std::memcpy(&vert.joint_indices_[0], src + 48, 16);
+            }
+        }
+
+        ::parse_indices(r, mesh, revision);
     }
 
     template <typename _Mesh>
     void parse_render_unit(
-        sung::BytesReader& r, dalp::RenderUnit<_Mesh>& unit
+        ::PayloadReader& r,
+        dalp::RenderUnit<_Mesh>& unit,
+        const int32_t revision
     ) {
         unit.name_ = r.read_nt_str();
         ::parse_material(r, unit.material_);
-        ::parse_mesh(r, unit.mesh_);
+        ::parse_mesh(r, unit.mesh_, revision);
+    }
+
+
+}  // namespace
+
+
+// Parse optional sections
+namespace {
+
+    template <typename _Mesh>
+    bool parse_unit_lods(
+        ::PayloadReader& r, std::vector<dalp::RenderUnit<_Mesh>>& units
+    ) {
+        if (r.read_int64().value() != static_cast<int64_t>(units.size()))
+            return false;
+
+        for (auto& unit : units) {
+            auto& mesh = unit.mesh_;
+
+            // 12 bytes per LOD header
+            const auto lod_count = r.read_int32().value();
+            if (lod_count < 0 ||
+                static_cast<size_t>(lod_count) > r.remaining() / 12)
+                return false;
+            mesh.lods_.resize(lod_count);
+
+            for (auto& lod : mesh.lods_) {
+                lod.error_ = r.read_float32().value();
+
+                const auto index_count = r.read_int64().value();
+                if (index_count < 0 ||
+                    static_cast<size_t>(index_count) > r.remaining() / 4)
+                    return false;
+                lod.indices_.resize(index_count);
+
+                static_assert(sizeof(int32_t) == sizeof(lod.indices_[0]));
+                const auto dst = reinterpret_cast<int32_t*>(
+                    lod.indices_.data()
+                );
+                if (!r.read_int32_arr(dst, lod.indices_.size()))
+                    return false;
+
+                for (const auto index : lod.indices_) {
+                    if (index >= mesh.vertices_.size())
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool parse_lods(::PayloadReader& r, dalp::Model& output) {
+        if (!::parse_unit_lods(r, output.units_indexed_))
+            return false;
+        if (!::parse_unit_lods(r, output.units_indexed_joint_))
+            return false;
+        return r.is_eof();
+    }
+
+    template <typename _Mesh>
+    bool parse_unit_meshlets(
+        ::PayloadReader& r, std::vector<dalp::RenderUnit<_Mesh>>& units
+    ) {
+        if (r.read_int64().value() != static_cast<int64_t>(units.size()))
+            return false;
+
+        for (auto& unit : units) {
+            auto& set = unit.mesh_.meshlets_;
+
+            // 60 bytes per meshlet
+            const auto meshlet_count = r.read_int64().value();
+            if (meshlet_count < 0 ||
+                static_cast<size_t>(meshlet_count) > r.remaining() / 60)
+                return false;
+            set.meshlets_.resize(meshlet_count);
+            for (auto& meshlet : set.meshlets_) {
+                meshlet.vertex_offset_ = r.read_int32().value();
+                meshlet.vertex_count_ = r.read_int32().value();
+                meshlet.triangle_offset_ = r.read_int32().value();
+                meshlet.triangle_count_ = r.read_int32().value();
+
+                if (!r.read_float32_arr(&meshlet.center_[0], 3))
+                    return false;
+                meshlet.radius_ = r.read_float32().value();
+                if (!r.read_float32_arr(&meshlet.cone_apex_[0], 3))
+                    return false;
+                if (!r.read_float32_arr(&meshlet.cone_axis_[0], 3))
+                    return false;
+                meshlet.cone_cutoff_ = r.read_float32().value();
+            }
+
+            const auto vertex_count = r.read_int64().value();
+            if (vertex_count < 0 ||
+                static_cast<size_t>(vertex_count) > r.remaining() / 4)
+                return false;
+            set.vertices_.resize(vertex_count);
+            const auto dst = reinterpret_cast<int32_t*>(set.vertices_.data());
+            if (!r.read_int32_arr(dst, set.vertices_.size()))
+                return false;
+
+            const auto tri_size = r.read_int64().value();
+            if (tri_size < 0 || static_cast<size_t>(tri_size) > r.remaining())
+                return false;
+            set.triangles_.resize(tri_size);
+            if (!r.read_raw(set.triangles_.data(), tri_size))
+                return false;
+
+            for (auto& m : set.meshlets_) {
+                const auto vert_end = size_t{ m.vertex_offset_ } +
+                                      m.vertex_count_;
+                const auto tri_end = size_t{ m.triangle_offset_ } +
+                                     3 * size_t{ m.triangle_count_ };
+                if (vert_end > set.vertices_.size())
+                    return false;
+                if (tri_end > set.triangles_.size())
+                    return false;
+            }
+            for (const auto index : set.vertices_) {
+                if (index >= unit.mesh_.vertices_.size())
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool parse_meshlets(::PayloadReader& r, dalp::Model& output) {
+        if (!::parse_unit_meshlets(r, output.units_indexed_))
+            return false;
+        if (!::parse_unit_meshlets(r, output.units_indexed_joint_))
+            return false;
+        return r.is_eof();
+    }
+
+    template <typename _Mesh>
+    bool parse_unit_bounds(
+        ::PayloadReader& r, std::vector<dalp::RenderUnit<_Mesh>>& units
+    ) {
+        if (r.read_int64().value() != static_cast<int64_t>(units.size()))
+            return false;
+
+        for (auto& unit : units) {
+            if (!r.read_float32_arr(&unit.aabb_.min_[0], 3))
+                return false;
+            if (!r.read_float32_arr(&unit.aabb_.max_[0], 3))
+                return false;
+            if (!r.read_float32_arr(&unit.sphere_.center_[0], 3))
+                return false;
+            unit.sphere_.radius_ = r.read_float32().value();
+        }
+
+        return true;
     }
 
+    bool parse_bounds(::PayloadReader& r, dalp::Model& output) {
+        if (!::parse_unit_bounds(r, output.units_straight_))
+            return false;
+        if (!::parse_unit_bounds(r, output.units_straight_joint_))
+            return false;
+        if (!::parse_unit_bounds(r, output.units_indexed_))
+            return false;
+        if (!::parse_unit_bounds(r, output.units_indexed_joint_))
+            return false;
+        return r.is_eof();
+    }
+
+    bool parse_instances(::PayloadReader& r, dalp::Model& output) {
+        auto& units = output.units_indexed_;
+        if (r.read_int64().value() != static_cast<int64_t>(units.size()))
+            return false;
+
+        for (auto& unit : units) {
+            // 64 bytes per transform
+            const auto count = r.read_int64().value();
+            if (count < 0 || static_cast<size_t>(count) > r.remaining() / 64)
+                return false;
+
+            unit.instances_.resize(count);
+            for (auto& m : unit.instances_) ::parse_mat4(r, m);
+        }
+
+        return r.is_eof();
+    }
+
+    bool parse_bvh(::PayloadReader& r, dalp::Model& output) {
+        auto& bvh = output.bvh_;
+
+        // 32 bytes per node
+        const auto node_count = r.read_int64().value();
+        if (node_count < 0 ||
+            static_cast<size_t>(node_count) > r.remaining() / 32)
+            return false;
+        bvh.nodes_.resize(node_count);
+        for (auto& node : bvh.nodes_) {
+            if (!r.read_float32_arr(&node.min_[0], 3))
+                return false;
+            node.offset_ = r.read_int32().value();
+            if (!r.read_float32_arr(&node.max_[0], 3))
+                return false;
+            node.count_ = r.read_int32().value();
+        }
+
+        const auto tri_count = r.read_int64().value();
+        if (tri_count < 0 ||
+            static_cast<size_t>(tri_count) > r.remaining() / 8)
+            return false;
+        bvh.triangles_.resize(tri_count);
+        for (auto& tri : bvh.triangles_) {
+            tri.unit_ = r.read_int32().value();
+            tri.triangle_ = r.read_int32().value();
+        }
+
+        // Traversal trusts offsets, so a bad hierarchy must not get through
+        if (!r.is_eof() || !dalp::is_valid_bvh(bvh, output)) {
+            bvh = {};
+            return false;
+        }
+        return true;
+    }
+
+    // Unknown tags are skipped
+    bool parse_section(
+        const int32_t tag, ::PayloadReader& r, dalp::Model& output
+    ) {
+        if (dalp::DMD_SECTION_LODS == tag)
+            return ::parse_lods(r, output);
+        else if (dalp::DMD_SECTION_MESHLETS == tag)
+            return ::parse_meshlets(r, output);
+        else if (dalp::DMD_SECTION_BOUNDS == tag)
+            return ::parse_bounds(r, output);
+        else if (dalp::DMD_SECTION_INSTANCES == tag)
+            return ::parse_instances(r, output);
+        else if (dalp::DMD_SECTION_BVH == tag)
+            return ::parse_bvh(r, output);
+        else
+            return true;
+    }
+
+    bool parse_sections(::PayloadReader& r, dalp::Model& output) {
+        while (!r.is_eof()) {
+            const auto tag = r.read_int32().value();
+            const auto size = r.read_int64().value();
+            if (size < 0 || static_cast<size_t>(size) > r.remaining())
+                return false;
+
+            // Section parsers see only their own bytes
+            const auto outer_limit = r.push_limit(size);
+            const auto parsed = ::parse_section(tag, r, output) &&
+                                r.advance(r.remaining());
+            r.pop_limit(outer_limit);
+            if (!parsed)
+                return false;
+        }
+
+        return true;
+    }
+
+}  // namespace
+
+
+// Parse whole payload
+namespace {
+
+    template <typename _Mesh>
+    void parse_units(
+        ::PayloadReader& r,
+        std::vector<dalp::RenderUnit<_Mesh>>& units,
+        const int32_t revision
+    ) {
+        units.resize(r.read_int64().value());
+        for (auto& unit : units) ::parse_render_unit(r, unit, revision);
+    }
 
     dalp::ModelParseResult parse_all(
-        sung::BytesReader& r, dalp::Model& output
+        ::PayloadReader& r, dalp::Model& output, const int32_t revision
     ) {
         ::parse_aabb(r, output.aabb_);
         ::parse_skeleton(r, output.skeleton_);
         ::parse_animations(r, output.animations_);
+        ::parse_units(r, output.units_straight_, revision);
+        ::parse_units(r, output.units_straight_joint_, revision);
+        ::parse_units(r, output.units_indexed_, revision);
+        ::parse_units(r, output.units_indexed_joint_, revision);
+
+        if (::parse_sections(r, output))
+            return dalp::ModelParseResult::success;
+        else
+            return dalp::ModelParseResult::corrupted_content;
+    }
 
-        output.units_straight_.resize(r.read_int64().value());
-        for (auto& unit : output.units_straight_) ::parse_render_unit(r, unit);
+}  // namespace
 
-        output.units_straight_joint_.resize(r.read_int64().value());
-        for (auto& unit : output.units_straight_joint_)
-            ::parse_render_unit(r, unit);
 
-        output.units_indexed_.resize(r.read_int64().value());
-        for (auto& unit : output.units_indexed_) ::parse_render_unit(r, unit);
+// Framed payloads
+namespace {
 
-        output.units_indexed_joint_.resize(r.read_int64().value());
-        for (auto& unit : output.units_indexed_joint_)
-            ::parse_render_unit(r, unit);
+    // Decompresses blocks of a `DMD_FRAMED_PAYLOAD` payload at `src` into
+    // one preallocated buffer, in parallel. Nullopt if the block index
+    // doesn't match `payload_size` or a block is corrupted.
+    std::optional<std::vector<uint8_t>> decompress_framed(
+        const uint8_t* const src,
+        const size_t src_size,
+        const dal::CompressMethod comp_method,
+        const size_t payload_size,
+        const uint32_t thread_count
+    ) {
+        if (src_size < 16)
+            return std::nullopt;
 
-        if (r.is_eof())
-            return dalp::ModelParseResult::success;
+        const auto block_size = dalp::make_int64(src);
+        const auto block_count = dalp::make_int64(src + 8);
+        if (block_size <= 0 || block_count < 0)
+            return std::nullopt;
+        const auto size = static_cast<size_t>(block_size);
+        const auto count = static_cast<size_t>(block_count);
+        if (count != payload_size / size + (payload_size % size ? 1 : 0))
+            return std::nullopt;
+        if (count > (src_size - 16) / 8)
+            return std::nullopt;
+
+        std::vector<size_t> offsets(count + 1);
+        offsets[0] = 16 + 8 * count;
+        for (size_t i = 0; i < count; ++i) {
+            const auto stored_size = dalp::make_int64(src + 16 + 8 * i);
+            if (stored_size < 0 ||
+                static_cast<size_t>(stored_size) > src_size - offsets[i])
+                return std::nullopt;
+            offsets[i + 1] = offsets[i] + stored_size;
+        }
+
+        std::vector<uint8_t> output(payload_size);
+        // Not `std::vector<bool>`, which packs bits shared by threads
+        std::vector<uint8_t> succeeded(count, 0);
+        dal::parallel_for(count, thread_count, [&](const size_t i) {
+            const auto begin = i * size;
+            const auto length = std::min(size, payload_size - begin);
+            dal::DecompressStream stream{
+                comp_method, src + offsets[i], offsets[i + 1] - offsets[i]
+            };
+            const auto read = stream.read(output.data() + begin, length);
+            succeeded[i] = read == length && !stream.failed();
+        });
+
+        for (const auto x : succeeded) {
+            if (!x)
+                return std::nullopt;
+        }
+        return output;
+    }
+
+}  // namespace
+
+
+// Table of contents
+namespace {
+
+    constexpr size_t DMD_HEADER_SIZE = dalp::MAGIC_NUMBER_SIZE + 12;
+    constexpr size_t TOC_ENTRY_SIZE = 32;
+
+    struct FileHeader {
+        dal::CompressMethod comp_method_;
+        int32_t revision_;
+        // See `DMD_FRAMED_PAYLOAD`
+        bool framed_;
+        // Decompressed payload size, or the number of TOC entries
+        int64_t size_;
+    };
+
+    // `content_size` must be at least `DMD_HEADER_SIZE`
+    ::FileHeader parse_file_header(const uint8_t* const file_content) {
+        const auto head = file_content + dalp::MAGIC_NUMBER_SIZE;
+        const auto comp_method_i = dalp::make_int32(head);
+
+        ::FileHeader output;
+        const auto method_bits = comp_method_i & 0xFFFF;
+        output.comp_method_ = (dal::CompressMethod)(
+            method_bits & ~dalp::DMD_FRAMED_PAYLOAD
+        );
+        output.framed_ = 0 != (method_bits & dalp::DMD_FRAMED_PAYLOAD);
+        output.revision_ = comp_method_i >> 16;
+        output.size_ = dalp::make_int64(head + 4);
+        return output;
+    }
+
+    bool parse_toc(
+        const uint8_t* const file_content,
+        const size_t content_size,
+        const int64_t entry_count,
+        std::vector<dalp::DmdSectionInfo>& output
+    ) {
+        const auto max_count = (content_size - DMD_HEADER_SIZE) /
+                               TOC_ENTRY_SIZE;
+        if (entry_count < 0 || static_cast<size_t>(entry_count) > max_count)
+            return false;
+
+        output.resize(entry_count);
+        auto head = file_content + DMD_HEADER_SIZE;
+        for (auto& entry : output) {
+            const auto offset = dalp::make_int64(head + 8);
+            const auto stored_size = dalp::make_int64(head + 16);
+            const auto decompressed_size = dalp::make_int64(head + 24);
+            if (offset < 0 || stored_size < 0 || decompressed_size < 0)
+                return false;
+            if (static_cast<size_t>(offset) > content_size)
+                return false;
+            if (static_cast<size_t>(stored_size) > content_size - offset)
+                return false;
+
+            entry.tag_ = dalp::make_int32(head);
+            entry.compression_ = (dal::CompressMethod)dalp::make_int32(
+                head + 4
+            );
+            entry.offset_ = static_cast<size_t>(offset);
+            entry.stored_size_ = static_cast<size_t>(stored_size);
+            entry.decompressed_size_ = static_cast<size_t>(decompressed_size);
+            head += TOC_ENTRY_SIZE;
+        }
+
+        return true;
+    }
+
+    bool is_requested(const int32_t tag, const dalp::DmdSectionMask& mask) {
+        switch (tag) {
+            case dalp::DMD_SECTION_AABB:
+                return mask.aabb_;
+            case dalp::DMD_SECTION_SKELETON:
+                return mask.skeleton_;
+            case dalp::DMD_SECTION_ANIMATIONS:
+                return mask.animations_;
+            case dalp::DMD_SECTION_UNITS_STRAIGHT:
+            case dalp::DMD_SECTION_UNITS_STRAIGHT_JOINT:
+            case dalp::DMD_SECTION_UNITS_INDEXED:
+            case dalp::DMD_SECTION_UNITS_INDEXED_JOINT:
+            case dalp::DMD_SECTION_BOUNDS:
+            case dalp::DMD_SECTION_INSTANCES:
+                return mask.units_;
+            case dalp::DMD_SECTION_LODS:
+                return mask.units_ && mask.lods_;
+            case dalp::DMD_SECTION_MESHLETS:
+                return mask.units_ && mask.meshlets_;
+            case dalp::DMD_SECTION_BVH:
+                return mask.units_ && mask.bvh_;
+            default:
+                return false;
+        }
+    }
+
+    dalp::DmdSectionMask make_full_mask() {
+        dalp::DmdSectionMask output;
+        output.aabb_ = true;
+        output.skeleton_ = true;
+        output.animations_ = true;
+        output.units_ = true;
+        output.lods_ = true;
+        output.meshlets_ = true;
+        output.bvh_ = true;
+        return output;
+    }
+
+    bool parse_toc_section(
+        const int32_t tag,
+        ::PayloadReader& r,
+        dalp::Model& output,
+        const int32_t revision
+    ) {
+        if (dalp::DMD_SECTION_AABB == tag)
+            ::parse_aabb(r, output.aabb_);
+        else if (dalp::DMD_SECTION_SKELETON == tag)
+            ::parse_skeleton(r, output.skeleton_);
+        else if (dalp::DMD_SECTION_ANIMATIONS == tag)
+            ::parse_animations(r, output.animations_);
+        else if (dalp::DMD_SECTION_UNITS_STRAIGHT == tag)
+            ::parse_units(r, output.units_straight_, revision);
+        else if (dalp::DMD_SECTION_UNITS_STRAIGHT_JOINT == tag)
+            ::parse_units(r, output.units_straight_joint_, revision);
+        else if (dalp::DMD_SECTION_UNITS_INDEXED == tag)
+            ::parse_units(r, output.units_indexed_, revision);
+        else if (dalp::DMD_SECTION_UNITS_INDEXED_JOINT == tag)
+            ::parse_units(r, output.units_indexed_joint_, revision);
         else
+            return ::parse_section(tag, r, output);
+
+        return r.is_eof();
+    }
+
+    // Sections are stored in dependency order, so units come before the
+    // sections that refer to them
+    dalp::ModelParseResult parse_toc_model(
+        dalp::Model& output,
+        const uint8_t* const file_content,
+        const size_t content_size,
+        const ::FileHeader& header,
+        const dalp::DmdSectionMask& mask
+    ) {
+        std::vector<dalp::DmdSectionInfo> toc;
+        if (!::parse_toc(file_content, content_size, header.size_, toc))
             return dalp::ModelParseResult::corrupted_content;
+
+        for (auto& entry : toc) {
+            if (!::is_requested(entry.tag_, mask))
+                continue;
+
+            const auto result = ::parse_payload(
+                file_content + entry.offset_,
+                entry.stored_size_,
+                entry.compression_,
+                entry.decompressed_size_,
+                [&](::PayloadReader& r) {
+                    return ::parse_toc_section(
+                        entry.tag_, r, output, header.revision_
+                    );
+                }
+            );
+
+            if (::PayloadResult::decompression_failed == result)
+                return dalp::ModelParseResult::decompression_failed;
+            else if (::PayloadResult::success != result)
+                return dalp::ModelParseResult::corrupted_content;
+        }
+
+        return dalp::ModelParseResult::success;
+    }
+
+    // For files without a table of contents
+    void drop_unrequested(
+        dalp::Model& model, const dalp::DmdSectionMask& mask
+    ) {
+        if (!mask.aabb_)
+            model.aabb_ = {};
+        if (!mask.skeleton_)
+            model.skeleton_ = {};
+        if (!mask.animations_)
+            model.animations_.clear();
+        if (!mask.units_ || !mask.bvh_)
+            model.bvh_ = {};
+
+        if (!mask.units_) {
+            model.units_straight_.clear();
+            model.units_straight_joint_.clear();
+            model.units_indexed_.clear();
+            model.units_indexed_joint_.clear();
+        }
+
+        for (auto& unit : model.units_indexed_) {
+            if (!mask.lods_)
+                unit.mesh_.lods_.clear();
+            if (!mask.meshlets_)
+                unit.mesh_.meshlets_ = {};
+        }
+        for (auto& unit : model.units_indexed_joint_) {
+            if (!mask.lods_)
+                unit.mesh_.lods_.clear();
+            if (!mask.meshlets_)
+                unit.mesh_.meshlets_ = {};
+        }
+    }
+
+}  // namespace
+
+
+// Parse collision
+namespace {
+
+    bool parse_collision_geometry(
+        ::PayloadReader& r, dalp::CollisionGeometry& output
+    ) {
+        // 12 bytes per vertex
+        const auto vertex_count = r.read_int64().value();
+        if (vertex_count < 0 ||
+            static_cast<size_t>(vertex_count) > r.remaining() / 12)
+            return false;
+        output.vertices_.resize(vertex_count);
+        for (auto& v : output.vertices_) {
+            if (!r.read_float32_arr(&v[0], 3))
+                return false;
+        }
+
+        const auto index_count = r.read_int64().value();
+        if (index_count < 0 ||
+            static_cast<size_t>(index_count) > r.remaining() / 4)
+            return false;
+        output.indices_.resize(index_count);
+        for (auto& i : output.indices_) {
+            i = static_cast<uint32_t>(r.read_int32().value());
+            if (i >= output.vertices_.size())
+                return false;
+        }
+
+        return output.indices_.size() % 3 == 0;
+    }
+
+    bool parse_collision(::PayloadReader& r, dalp::CollisionScene& output) {
+        const auto mesh_count = r.read_int64().value();
+        if (mesh_count < 0 || static_cast<size_t>(mesh_count) > r.remaining())
+            return false;
+        output.meshes_.resize(mesh_count);
+        for (auto& mesh : output.meshes_) {
+            mesh.name_ = r.read_nt_str();
+
+            const auto hull_count = r.read_int64().value();
+            if (hull_count < 0 ||
+                static_cast<size_t>(hull_count) > r.remaining() / 16)
+                return false;
+            mesh.hulls_.resize(hull_count);
+            for (auto& hull : mesh.hulls_) {
+                if (!::parse_collision_geometry(r, hull))
+                    return false;
+            }
+            if (!::parse_collision_geometry(r, mesh.trimesh_))
+                return false;
+        }
+
+        const auto actor_count = r.read_int64().value();
+        if (actor_count < 0 || static_cast<size_t>(actor_count) > r.remaining())
+            return false;
+        output.actors_.resize(actor_count);
+        for (auto& actor : output.actors_) {
+            actor.name_ = r.read_nt_str();
+            if (r.remaining() < 64)
+                return false;
+            ::parse_mat4(r, actor.transform_);
+
+            const auto count = r.read_int64().value();
+            if (count < 0 || static_cast<size_t>(count) > r.remaining() / 4)
+                return false;
+            actor.meshes_.resize(count);
+            for (auto& i : actor.meshes_) {
+                i = static_cast<uint32_t>(r.read_int32().value());
+                if (i >= output.meshes_.size())
+                    return false;
+            }
+        }
+
+        return r.is_eof();
     }
 
 }  // namespace
@@ -342,61 +1451,170 @@ namespace dal::parser {
     ModelParseResult parse_dmd(
         Model& output,
         const uint8_t* const file_content,
-        const size_t content_size
+        const size_t content_size,
+        const uint32_t thread_count
     ) {
         // Check magic numbers
         if (!::is_magic_numbers_correct(file_content))
             return dalp::ModelParseResult::magic_numbers_dont_match;
 
-        sung::BytesReader file_bytes{ file_content, content_size };
-        file_bytes.advance(dalp::MAGIC_NUMBER_SIZE);
-
-        const auto comp_method_i = file_bytes.read_int32().value();
-        const auto expected_unzipped_size = file_bytes.read_int64().value();
-        const auto comp_method = (CompressMethod)comp_method_i;
+        if (content_size < ::DMD_HEADER_SIZE)
+            return dalp::ModelParseResult::corrupted_content;
 
-        if (comp_method == CompressMethod::none) {
-            return ::parse_all(file_bytes, output);
-        } else {
-            std::optional<std::vector<uint8_t>> unzipped = std::nullopt;
+        const auto header = ::parse_file_header(file_content);
+        if (header.revision_ > DMD_REVISION_LATEST)
+            return dalp::ModelParseResult::unsupported_revision;
+        if (header.size_ < 0)
+            return dalp::ModelParseResult::corrupted_content;
 
-            if (comp_method == CompressMethod::zip) {
-                unzipped = decomp_zip(
-                    BinDataView{ file_bytes.head(), file_bytes.remaining() },
-                    expected_unzipped_size
-                );
-            } else if (comp_method == CompressMethod::brotli) {
-                unzipped = decomp_bro(
-                    file_bytes.head(),
-                    file_bytes.remaining(),
-                    expected_unzipped_size
-                );
-            }
+        if (header.revision_ >= DMD_REVISION_TOC) {
+            return ::parse_toc_model(
+                output, file_content, content_size, header, ::make_full_mask()
+            );
+        }
 
-            if (!unzipped.has_value())
+        if (header.framed_) {
+            const auto payload = ::decompress_framed(
+                file_content + ::DMD_HEADER_SIZE,
+                content_size - ::DMD_HEADER_SIZE,
+                header.comp_method_,
+                static_cast<size_t>(header.size_),
+                thread_count
+            );
+            if (!payload.has_value())
                 return dalp::ModelParseResult::decompression_failed;
 
-            sung::BytesReader r{ unzipped->data(), unzipped->size() };
-            return ::parse_all(r, output);
+            ::PayloadReader r{ payload->data(), payload->size() };
+            return ::parse_all(r, output, header.revision_);
         }
 
-        return dalp::ModelParseResult::corrupted_content;
+        // The payload is parsed as it decompresses, so it never exists as a
+        // whole in memory
+        auto result = dalp::ModelParseResult::corrupted_content;
+        const auto payload_result = ::parse_payload(
+            file_content + ::DMD_HEADER_SIZE,
+            content_size - ::DMD_HEADER_SIZE,
+            header.comp_method_,
+            static_cast<size_t>(header.size_),
+            [&](::PayloadReader& r) {
+                result = ::parse_all(r, output, header.revision_);
+                return dalp::ModelParseResult::success == result;
+            }
+        );
+
+        if (::PayloadResult::decompression_failed == payload_result)
+            return dalp::ModelParseResult::decompression_failed;
+        else
+            return result;
     }
 
     std::optional<Model> parse_dmd(
-        const uint8_t* const file_content, const size_t content_size
+        const uint8_t* const file_content,
+        const size_t content_size,
+        const uint32_t thread_count
     ) {
         Model output;
 
         if (ModelParseResult::success !=
-            dalp::parse_dmd(output, file_content, content_size))
+            dalp::parse_dmd(output, file_content, content_size, thread_count))
             return std::nullopt;
         else
             return output;
     }
 
-    std::optional<Model> parse_dmd(const BinDataView& src) {
-        return dalp::parse_dmd(src.data(), src.size());
+    std::optional<Model> parse_dmd(
+        const BinDataView& src, const uint32_t thread_count
+    ) {
+        return dalp::parse_dmd(src.data(), src.size(), thread_count);
+    }
+
+    std::optional<std::vector<DmdSectionInfo>> parse_dmd_toc(
+        const uint8_t* const file_content, const size_t content_size
+    ) {
+        if (content_size < ::DMD_HEADER_SIZE)
+            return std::nullopt;
+        if (!::is_magic_numbers_correct(file_content))
+            return std::nullopt;
+
+        const auto header = ::parse_file_header(file_content);
+        std::vector<DmdSectionInfo> output;
+        if (header.revision_ < DMD_REVISION_TOC)
+            return output;
+        if (!::parse_toc(file_content, content_size, header.size_, output))
+            return std::nullopt;
+        return output;
+    }
+
+    ModelParseResult parse_dmd_sections(
+        Model& output,
+        const uint8_t* const file_content,
+        const size_t content_size,
+        const DmdSectionMask& mask
+    ) {
+        if (content_size < ::DMD_HEADER_SIZE)
+            return dalp::ModelParseResult::corrupted_content;
+        if (!::is_magic_numbers_correct(file_content))
+            return dalp::ModelParseResult::magic_numbers_dont_match;
+
+        const auto header = ::parse_file_header(file_content);
+        if (header.revision_ > DMD_REVISION_LATEST)
+            return dalp::ModelParseResult::unsupported_revision;
+
+        if (header.revision_ >= DMD_REVISION_TOC) {
+            return ::parse_toc_model(
+                output, file_content, content_size, header, mask
+            );
+        }
+
+        const auto result = dalp::parse_dmd(
+            output, file_content, content_size
+        );
+        if (ModelParseResult::success == result)
+            ::drop_unrequested(output, mask);
+        return result;
+    }
+
+    std::optional<Model> parse_dmd_sections(
+        const BinDataView& src, const DmdSectionMask& mask
+    ) {
+        Model output;
+        const auto result = dalp::parse_dmd_sections(
+            output, src.data(), src.size(), mask
+        );
+        if (ModelParseResult::success != result)
+            return std::nullopt;
+        else
+            return output;
+    }
+
+    std::optional<CollisionScene> parse_collision(
+        const uint8_t* const file_content, const size_t content_size
+    ) {
+        // Magic numbers, compression field and size
+        if (content_size < ::DMD_HEADER_SIZE)
+            return std::nullopt;
+        if (!::is_magic_numbers_correct(
+                file_content, MAGIC_NUMBERS_DAL_COLLISION
+            ))
+            return std::nullopt;
+
+        const auto header = ::parse_file_header(file_content);
+        if (header.revision_ > DCOL_REVISION_LATEST || header.size_ < 0)
+            return std::nullopt;
+        if (header.framed_)
+            return std::nullopt;
+
+        CollisionScene output;
+        const auto result = ::parse_payload(
+            file_content + ::DMD_HEADER_SIZE,
+            content_size - ::DMD_HEADER_SIZE,
+            header.comp_method_,
+            static_cast<size_t>(header.size_),
+            [&](::PayloadReader& r) { return ::parse_collision(r, output); }
+        );
+        if (::PayloadResult::success != result)
+            return std::nullopt;
+        return output;
     }
 
 }  // namespace dal::parser
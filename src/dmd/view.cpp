@@ -0,0 +1,428 @@
+#include "daltools/dmd/view.h"
+
+#include <cstring>
+#include <type_traits>
+
+#include "daltools/common/byte_tool.h"
+#include "daltools/common/konst.h"
+
+
+namespace dalp = dal::parser;
+
+
+namespace {
+
+    constexpr size_t BLOCK_ALIGN = 16;
+
+
+    // Byte range of a null terminated string, terminator excluded
+    struct StrRef {
+        uint64_t offset_ = 0;
+        uint64_t size_ = 0;
+    };
+
+    struct FileHeader {
+        char magic_[dalp::MAGIC_NUMBER_SIZE];
+        uint16_t revision_ = 0;
+        uint32_t unit_count_ = 0;
+        uint32_t flags_ = 0;
+        float aabb_[6] = {};
+        uint64_t unit_table_offset_ = 0;
+        uint64_t file_size_ = 0;
+        uint64_t reserved_ = 0;
+    };
+
+    struct UnitEntry {
+        StrRef name_;
+        StrRef material_name_;
+        StrRef albedo_map_;
+        StrRef roughness_map_;
+        StrRef metallic_map_;
+        StrRef normal_map_;
+        float roughness_ = 0;
+        float metallic_ = 0;
+        uint32_t transparency_ = 0;
+        uint32_t index_width_ = 4;
+        float aabb_[6] = {};
+        float sphere_[4] = {};
+        uint64_t vertex_offset_ = 0;
+        uint64_t vertex_count_ = 0;
+        uint64_t index_offset_ = 0;
+        uint64_t index_count_ = 0;
+        uint64_t instance_offset_ = 0;
+        uint64_t instance_count_ = 0;
+        uint64_t reserved_[3] = {};
+    };
+
+    // Stored as is, so these pin the layout
+    static_assert(64 == sizeof(::FileHeader));
+    static_assert(224 == sizeof(::UnitEntry));
+    static_assert(32 == sizeof(dalp::Vertex));
+    static_assert(64 == sizeof(glm::mat4));
+    static_assert(std::is_trivially_copyable_v<dalp::Vertex>);
+    static_assert(std::is_trivially_copyable_v<glm::mat4>);
+
+
+    void set_aabb(float (&dst)[6], const dalp::AABB3& src) {
+        for (int i = 0; i < 3; ++i) {
+            dst[i] = src.min_[i];
+            dst[i + 3] = src.max_[i];
+        }
+    }
+
+    dalp::AABB3 get_aabb(const float (&src)[6]) {
+        dalp::AABB3 output;
+        for (int i = 0; i < 3; ++i) {
+            output.min_[i] = src[i];
+            output.max_[i] = src[i + 3];
+        }
+        return output;
+    }
+
+}  // namespace
+
+
+// Writing
+namespace {
+
+    class ViewWriter {
+
+    public:
+        // Returns the offset of the first byte
+        size_t append_block(const void* src, const size_t size) {
+            this->align();
+            const auto offset = this->data_.size();
+            const auto bytes = reinterpret_cast<const uint8_t*>(src);
+            this->data_.insert(this->data_.end(), bytes, bytes + size);
+            return offset;
+        }
+
+        // Strings go after all blocks, see `append_strings`
+        ::StrRef add_string(const std::string& str) {
+            ::StrRef output;
+            output.offset_ = this->strings_.size();
+            output.size_ = str.size();
+            this->strings_.insert(this->strings_.end(), str.begin(), str.end());
+            this->strings_.push_back(0);
+            return output;
+        }
+
+        // Returns the offset to add to every `StrRef`
+        size_t append_strings() {
+            return this->append_block(
+                this->strings_.data(), this->strings_.size()
+            );
+        }
+
+        void align() {
+            const auto remainder = this->data_.size() % BLOCK_ALIGN;
+            if (0 != remainder)
+                this->data_.resize(
+                    this->data_.size() + BLOCK_ALIGN - remainder
+                );
+        }
+
+        std::vector<uint8_t>& data() { return this->data_; }
+
+    private:
+        std::vector<uint8_t> data_;
+        std::vector<uint8_t> strings_;
+    };
+
+
+    void offset_str_refs(::UnitEntry& entry, const size_t offset) {
+        for (auto ref : { &entry.name_,
+                          &entry.material_name_,
+                          &entry.albedo_map_,
+                          &entry.roughness_map_,
+                          &entry.metallic_map_,
+                          &entry.normal_map_ })
+            ref->offset_ += offset;
+    }
+
+}  // namespace
+
+
+// Reading
+namespace {
+
+    bool is_block_valid(
+        const uint64_t offset,
+        const uint64_t count,
+        const size_t element_size,
+        const size_t file_size
+    ) {
+        if (0 == count)
+            return true;
+        if (0 != offset % BLOCK_ALIGN || offset > file_size)
+            return false;
+        return count <= (file_size - offset) / element_size;
+    }
+
+    bool is_str_valid(
+        const ::StrRef& ref, const uint8_t* const data, const size_t size
+    ) {
+        if (ref.offset_ >= size || ref.size_ >= size - ref.offset_)
+            return false;
+        return 0 == data[ref.offset_ + ref.size_];
+    }
+
+    std::string_view make_str(const ::StrRef& ref, const uint8_t* const data) {
+        return std::string_view{
+            reinterpret_cast<const char*>(data + ref.offset_), ref.size_
+        };
+    }
+
+    template <typename T>
+    dalp::TArrayView<T> make_array(
+        const uint8_t* const data, const uint64_t offset, const uint64_t count
+    ) {
+        if (0 == count)
+            return {};
+        return dalp::TArrayView<T>{
+            reinterpret_cast<const T*>(data + offset), count
+        };
+    }
+
+    ::UnitEntry read_unit_entry(
+        const uint8_t* const data, const ::FileHeader& header, size_t index
+    ) {
+        ::UnitEntry output;
+        std::memcpy(
+            &output,
+            data + header.unit_table_offset_ + index * sizeof(::UnitEntry),
+            sizeof(::UnitEntry)
+        );
+        return output;
+    }
+
+    bool is_unit_valid(
+        const ::UnitEntry& entry, const uint8_t* const data, const size_t size
+    ) {
+        for (auto ref : { &entry.name_,
+                          &entry.material_name_,
+                          &entry.albedo_map_,
+                          &entry.roughness_map_,
+                          &entry.metallic_map_,
+                          &entry.normal_map_ }) {
+            if (!::is_str_valid(*ref, data, size))
+                return false;
+        }
+
+        if (2 != entry.index_width_ && 4 != entry.index_width_)
+            return false;
+        if (!::is_block_valid(
+                entry.vertex_offset_,
+                entry.vertex_count_,
+                sizeof(dalp::Vertex),
+                size
+            ))
+            return false;
+        if (!::is_block_valid(
+                entry.index_offset_,
+                entry.index_count_,
+                entry.index_width_,
+                size
+            ))
+            return false;
+        return ::is_block_valid(
+            entry.instance_offset_,
+            entry.instance_count_,
+            sizeof(glm::mat4),
+            size
+        );
+    }
+
+}  // namespace
+
+
+namespace dal::parser {
+
+    std::optional<ModelView> ModelView::open(
+        const uint8_t* const data, const size_t size
+    ) {
+        if (is_big_endian())
+            return std::nullopt;
+        if (nullptr == data || size < sizeof(::FileHeader))
+            return std::nullopt;
+        if (0 != reinterpret_cast<uintptr_t>(data) % BLOCK_ALIGN)
+            return std::nullopt;
+
+        ::FileHeader header;
+        std::memcpy(&header, data, sizeof(::FileHeader));
+        for (int i = 0; i < MAGIC_NUMBER_SIZE; ++i) {
+            if (header.magic_[i] != MAGIC_NUMBERS_DAL_MODEL_VIEW[i])
+                return std::nullopt;
+        }
+        if (header.revision_ > DMDV_REVISION_LATEST)
+            return std::nullopt;
+        if (header.file_size_ != size)
+            return std::nullopt;
+        if (!::is_block_valid(
+                header.unit_table_offset_,
+                header.unit_count_,
+                sizeof(::UnitEntry),
+                size
+            ))
+            return std::nullopt;
+
+        for (size_t i = 0; i < header.unit_count_; ++i) {
+            const auto entry = ::read_unit_entry(data, header, i);
+            if (!::is_unit_valid(entry, data, size))
+                return std::nullopt;
+        }
+
+        return ModelView{ data, size };
+    }
+
+    AABB3 ModelView::aabb() const {
+        ::FileHeader header;
+        std::memcpy(&header, this->data_, sizeof(::FileHeader));
+        return ::get_aabb(header.aabb_);
+    }
+
+    size_t ModelView::unit_count() const {
+        ::FileHeader header;
+        std::memcpy(&header, this->data_, sizeof(::FileHeader));
+        return header.unit_count_;
+    }
+
+    UnitView ModelView::unit(const size_t index) const {
+        ::FileHeader header;
+        std::memcpy(&header, this->data_, sizeof(::FileHeader));
+        const auto entry = ::read_unit_entry(this->data_, header, index);
+        const auto data = this->data_;
+
+        UnitView output;
+        output.name_ = ::make_str(entry.name_, data);
+        output.material_.name_ = ::make_str(entry.material_name_, data);
+        output.material_.albedo_map_ = ::make_str(entry.albedo_map_, data);
+        output.material_.roughness_map_ = ::make_str(
+            entry.roughness_map_, data
+        );
+        output.material_.metallic_map_ = ::make_str(entry.metallic_map_, data);
+        output.material_.normal_map_ = ::make_str(entry.normal_map_, data);
+        output.material_.roughness_ = entry.roughness_;
+        output.material_.metallic_ = entry.metallic_;
+        output.material_.transparency_ = 0 != entry.transparency_;
+
+        output.aabb_ = ::get_aabb(entry.aabb_);
+        output.sphere_.center_ = glm::vec3{ entry.sphere_[0],
+                                            entry.sphere_[1],
+                                            entry.sphere_[2] };
+        output.sphere_.radius_ = entry.sphere_[3];
+
+        output.vertices_ = ::make_array<Vertex>(
+            data, entry.vertex_offset_, entry.vertex_count_
+        );
+        if (2 == entry.index_width_) {
+            output.indices16_ = ::make_array<uint16_t>(
+                data, entry.index_offset_, entry.index_count_
+            );
+        } else {
+            output.indices32_ = ::make_array<uint32_t>(
+                data, entry.index_offset_, entry.index_count_
+            );
+        }
+        output.instances_ = ::make_array<glm::mat4>(
+            data, entry.instance_offset_, entry.instance_count_
+        );
+        return output;
+    }
+
+
+    std::optional<std::vector<uint8_t>> build_binary_model_view(
+        const Model& input, const bool compact_indices
+    ) {
+        if (is_big_endian())
+            return std::nullopt;
+        if (!input.skeleton_.joints_.empty() || !input.animations_.empty())
+            return std::nullopt;
+        if (!input.units_straight_.empty() ||
+            !input.units_straight_joint_.empty() ||
+            !input.units_indexed_joint_.empty())
+            return std::nullopt;
+
+        const auto& units = input.units_indexed_;
+        ::ViewWriter writer;
+
+        ::FileHeader header;
+        std::memcpy(
+            header.magic_, MAGIC_NUMBERS_DAL_MODEL_VIEW, MAGIC_NUMBER_SIZE
+        );
+        header.revision_ = DMDV_REVISION_LATEST;
+        header.unit_count_ = static_cast<uint32_t>(units.size());
+        ::set_aabb(header.aabb_, input.aabb_);
+        writer.append_block(&header, sizeof(header));
+
+        std::vector<::UnitEntry> entries(units.size());
+        header.unit_table_offset_ = writer.append_block(
+            entries.data(), entries.size() * sizeof(::UnitEntry)
+        );
+
+        for (size_t i = 0; i < units.size(); ++i) {
+            auto& unit = units[i];
+            auto& entry = entries[i];
+            const auto& mesh = unit.mesh_;
+            const auto& material = unit.material_;
+
+            entry.name_ = writer.add_string(unit.name_);
+            entry.material_name_ = writer.add_string(material.name_);
+            entry.albedo_map_ = writer.add_string(material.albedo_map_);
+            entry.roughness_map_ = writer.add_string(material.roughness_map_);
+            entry.metallic_map_ = writer.add_string(material.metallic_map_);
+            entry.normal_map_ = writer.add_string(material.normal_map_);
+            entry.roughness_ = material.roughness_;
+            entry.metallic_ = material.metallic_;
+            entry.transparency_ = material.transparency_ ? 1 : 0;
+
+            ::set_aabb(entry.aabb_, unit.aabb_);
+            for (int j = 0; j < 3; ++j)
+                entry.sphere_[j] = unit.sphere_.center_[j];
+            entry.sphere_[3] = unit.sphere_.radius_;
+
+            entry.vertex_count_ = mesh.vertices_.size();
+            entry.vertex_offset_ = writer.append_block(
+                mesh.vertices_.data(), mesh.vertices_.size() * sizeof(Vertex)
+            );
+
+            entry.index_count_ = mesh.indices_.size();
+            if (compact_indices && mesh.vertices_.size() <= 65536) {
+                std::vector<uint16_t> indices(
+                    mesh.indices_.begin(), mesh.indices_.end()
+                );
+                entry.index_width_ = 2;
+                entry.index_offset_ = writer.append_block(
+                    indices.data(), indices.size() * sizeof(uint16_t)
+                );
+            } else {
+                entry.index_width_ = 4;
+                entry.index_offset_ = writer.append_block(
+                    mesh.indices_.data(),
+                    mesh.indices_.size() * sizeof(uint32_t)
+                );
+            }
+
+            entry.instance_count_ = unit.instances_.size();
+            entry.instance_offset_ = writer.append_block(
+                unit.instances_.data(),
+                unit.instances_.size() * sizeof(glm::mat4)
+            );
+        }
+
+        const auto str_offset = writer.append_strings();
+        for (auto& entry : entries) ::offset_str_refs(entry, str_offset);
+        writer.align();
+
+        auto& output = writer.data();
+        header.file_size_ = output.size();
+        std::memcpy(output.data(), &header, sizeof(header));
+        std::memcpy(
+            output.data() + header.unit_table_offset_,
+            entries.data(),
+            entries.size() * sizeof(::UnitEntry)
+        );
+        return std::move(output);
+    }
+
+}  // namespace dal::parser
@@ -0,0 +1,658 @@
+#include "daltools/scene/bvh.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+    #include <xmmintrin.h>
+    #define DAL_BVH_SSE
+#endif
+
+
+namespace {
+
+    namespace dalp = dal::parser;
+
+    // Traversal stacks never hold more nodes than the tree is deep
+    constexpr size_t BVH_MAX_DEPTH = 64;
+    // Past this depth nodes are split at the median, which halves the
+    // triangle count every level so `BVH_MAX_DEPTH` is never exceeded
+    constexpr size_t BVH_SAH_MAX_DEPTH = 30;
+
+    static_assert(sizeof(dalp::BvhNode) == 32);
+    static_assert(offsetof(dalp::BvhNode, max_) == 16);
+
+
+    template <typename _Mesh>
+    size_t count_triangles(const std::vector<dalp::RenderUnit<_Mesh>>& units) {
+        size_t output = 0;
+        for (auto& unit : units) output += unit.mesh_.indices_.size() / 3;
+        return output;
+    }
+
+    template <typename _Mesh>
+    void get_positions(
+        const _Mesh& mesh, const uint32_t triangle, glm::vec3 (&output)[3]
+    ) {
+        const auto index = &mesh.indices_[3 * size_t{ triangle }];
+        for (int i = 0; i < 3; ++i)
+            output[i] = mesh.vertices_[index[i]].pos_;
+    }
+
+    void get_positions(
+        const dalp::Model& model,
+        const dalp::BvhTriangle& tri,
+        glm::vec3 (&output)[3]
+    ) {
+        const auto indexed_count = model.units_indexed_.size();
+        if (tri.unit_ < indexed_count) {
+            const auto& mesh = model.units_indexed_[tri.unit_].mesh_;
+            ::get_positions(mesh, tri.triangle_, output);
+        } else {
+            const auto& unit = model.units_indexed_joint_[tri.unit_ -
+                                                          indexed_count];
+            ::get_positions(unit.mesh_, tri.triangle_, output);
+        }
+    }
+
+}  // namespace
+
+
+// Build
+namespace {
+
+    struct BuildTriangle {
+        dalp::AABB3 aabb_;
+        glm::vec3 centroid_;
+        dalp::BvhTriangle ref_;
+    };
+
+    struct Bin {
+        dalp::AABB3 aabb_;
+        size_t count_ = 0;
+    };
+
+    dalp::AABB3 make_empty_aabb() {
+        constexpr auto inf = std::numeric_limits<float>::infinity();
+        return { glm::vec3(inf), glm::vec3(-inf) };
+    }
+
+    void grow_aabb(dalp::AABB3& aabb, const glm::vec3& p) {
+        aabb.min_ = glm::min(aabb.min_, p);
+        aabb.max_ = glm::max(aabb.max_, p);
+    }
+
+    void grow_aabb(dalp::AABB3& aabb, const dalp::AABB3& other) {
+        aabb.min_ = glm::min(aabb.min_, other.min_);
+        aabb.max_ = glm::max(aabb.max_, other.max_);
+    }
+
+    // Half of the surface area, which is all SAH needs
+    float calc_half_area(const dalp::AABB3& aabb) {
+        const auto d = aabb.max_ - aabb.min_;
+        if (d.x < 0 || d.y < 0 || d.z < 0)
+            return 0;
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+
+
+    class BvhBuilder {
+
+    public:
+        BvhBuilder(const dalp::BvhOptions& options)
+            : max_leaf_size_(std::max<uint32_t>(options.max_leaf_size_, 1))
+            , bin_count_(std::max<uint32_t>(options.bin_count_, 2))
+            , margin_(std::max(options.margin_, 0.f)) {}
+
+        dalp::Bvh run(const dalp::Model& model) {
+            this->tris_.clear();
+            this->tris_.reserve(
+                ::count_triangles(model.units_indexed_) +
+                ::count_triangles(model.units_indexed_joint_)
+            );
+            this->add_units(model.units_indexed_, 0);
+            this->add_units(
+                model.units_indexed_joint_, model.units_indexed_.size()
+            );
+
+            dalp::Bvh output;
+            if (this->tris_.empty())
+                return output;
+
+            // A binary tree with at least one triangle per leaf
+            output.nodes_.reserve(2 * this->tris_.size() - 1);
+            this->build_node(output, 0, this->tris_.size(), 0);
+
+            output.triangles_.reserve(this->tris_.size());
+            for (auto& tri : this->tris_)
+                output.triangles_.push_back(tri.ref_);
+
+            return output;
+        }
+
+    private:
+        template <typename _Mesh>
+        void add_units(
+            const std::vector<dalp::RenderUnit<_Mesh>>& units,
+            const size_t first_unit
+        ) {
+            for (size_t u = 0; u < units.size(); ++u) {
+                // Would need a hierarchy over instances on top
+                if (!units[u].instances_.empty())
+                    continue;
+
+                const auto& mesh = units[u].mesh_;
+                const auto tri_count = mesh.indices_.size() / 3;
+
+                for (size_t t = 0; t < tri_count; ++t) {
+                    glm::vec3 p[3];
+                    ::get_positions(mesh, static_cast<uint32_t>(t), p);
+
+                    ::BuildTriangle tri;
+                    tri.aabb_ = ::make_empty_aabb();
+                    for (auto& x : p) ::grow_aabb(tri.aabb_, x);
+                    tri.centroid_ = (tri.aabb_.min_ + tri.aabb_.max_) * 0.5f;
+                    tri.ref_.unit_ = static_cast<uint32_t>(first_unit + u);
+                    tri.ref_.triangle_ = static_cast<uint32_t>(t);
+                    this->tris_.push_back(tri);
+                }
+            }
+        }
+
+        // Returns the first index of the right half, or `begin` to make a
+        // leaf
+        size_t split_sah(
+            const size_t begin,
+            const size_t end,
+            const dalp::AABB3& aabb,
+            const dalp::AABB3& centroid_aabb
+        ) {
+            const auto count = end - begin;
+            const auto parent_area = ::calc_half_area(aabb);
+            const auto extent = centroid_aabb.max_ - centroid_aabb.min_;
+
+            float best_cost = std::numeric_limits<float>::infinity();
+            int best_axis = -1;
+            size_t best_bin = 0;
+
+            std::vector<::Bin> bins(this->bin_count_);
+            std::vector<float> right_cost(this->bin_count_);
+
+            for (int axis = 0; axis < 3; ++axis) {
+                if (extent[axis] <= 0)
+                    continue;
+
+                for (auto& bin : bins) bin = { ::make_empty_aabb(), 0 };
+                for (size_t i = begin; i < end; ++i) {
+                    auto& bin = bins[this->find_bin(
+                        this->tris_[i], axis, centroid_aabb
+                    )];
+                    ::grow_aabb(bin.aabb_, this->tris_[i].aabb_);
+                    ++bin.count_;
+                }
+
+                // Cost of everything right of each candidate plane
+                auto right_aabb = ::make_empty_aabb();
+                size_t right_count = 0;
+                for (size_t b = this->bin_count_ - 1; b > 0; --b) {
+                    ::grow_aabb(right_aabb, bins[b].aabb_);
+                    right_count += bins[b].count_;
+                    right_cost[b] = ::calc_half_area(right_aabb) *
+                                    right_count;
+                }
+
+                auto left_aabb = ::make_empty_aabb();
+                size_t left_count = 0;
+                for (size_t b = 1; b < this->bin_count_; ++b) {
+                    ::grow_aabb(left_aabb, bins[b - 1].aabb_);
+                    left_count += bins[b - 1].count_;
+                    if (0 == left_count || count == left_count)
+                        continue;
+
+                    const auto cost = ::calc_half_area(left_aabb) *
+                                          left_count +
+                                      right_cost[b];
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_bin = b;
+                    }
+                }
+            }
+
+            if (best_axis < 0)
+                return begin;
+
+            // One traversal step plus the expected intersection tests, both
+            // relative to testing every triangle here
+            if (count <= this->max_leaf_size_ && parent_area > 0) {
+                const auto split_cost = 1 + best_cost / parent_area;
+                if (split_cost >= static_cast<float>(count))
+                    return begin;
+            }
+
+            const auto mid = std::partition(
+                this->tris_.begin() + begin,
+                this->tris_.begin() + end,
+                [&](const ::BuildTriangle& tri) {
+                    return this->find_bin(tri, best_axis, centroid_aabb) <
+                           best_bin;
+                }
+            );
+            return mid - this->tris_.begin();
+        }
+
+        size_t split_median(
+            const size_t begin,
+            const size_t end,
+            const dalp::AABB3& centroid_aabb
+        ) {
+            const auto extent = centroid_aabb.max_ - centroid_aabb.min_;
+            int axis = 0;
+            if (extent.y > extent[axis])
+                axis = 1;
+            if (extent.z > extent[axis])
+                axis = 2;
+
+            const auto mid = begin + (end - begin) / 2;
+            std::nth_element(
+                this->tris_.begin() + begin,
+                this->tris_.begin() + mid,
+                this->tris_.begin() + end,
+                [axis](const ::BuildTriangle& a, const ::BuildTriangle& b) {
+                    return a.centroid_[axis] < b.centroid_[axis];
+                }
+            );
+            return mid;
+        }
+
+        size_t find_bin(
+            const ::BuildTriangle& tri,
+            const int axis,
+            const dalp::AABB3& centroid_aabb
+        ) const {
+            const auto lo = centroid_aabb.min_[axis];
+            const auto extent = centroid_aabb.max_[axis] - lo;
+            const auto x = (tri.centroid_[axis] - lo) / extent;
+            const auto bin = static_cast<size_t>(x * this->bin_count_);
+            return std::min<size_t>(bin, this->bin_count_ - 1);
+        }
+
+        void build_node(
+            dalp::Bvh& output,
+            const size_t begin,
+            const size_t end,
+            const size_t depth
+        ) {
+            auto aabb = ::make_empty_aabb();
+            auto centroid_aabb = ::make_empty_aabb();
+            for (size_t i = begin; i < end; ++i) {
+                ::grow_aabb(aabb, this->tris_[i].aabb_);
+                ::grow_aabb(centroid_aabb, this->tris_[i].centroid_);
+            }
+
+            const auto node_index = output.nodes_.size();
+            {
+                auto& node = output.nodes_.emplace_back();
+                node.min_ = aabb.min_ - this->margin_;
+                node.max_ = aabb.max_ + this->margin_;
+            }
+
+            const auto count = end - begin;
+            size_t mid = begin;
+            if (count > 1) {
+                if (depth < BVH_SAH_MAX_DEPTH)
+                    mid = this->split_sah(begin, end, aabb, centroid_aabb);
+                if (mid == begin && count > this->max_leaf_size_)
+                    mid = this->split_median(begin, end, centroid_aabb);
+            }
+
+            if (mid == begin) {
+                auto& node = output.nodes_[node_index];
+                node.offset_ = static_cast<uint32_t>(begin);
+                node.count_ = static_cast<uint32_t>(count);
+                return;
+            }
+
+            this->build_node(output, begin, mid, depth + 1);
+            output.nodes_[node_index].offset_ = static_cast<uint32_t>(
+                output.nodes_.size()
+            );
+            this->build_node(output, mid, end, depth + 1);
+        }
+
+        std::vector<::BuildTriangle> tris_;
+        uint32_t max_leaf_size_;
+        uint32_t bin_count_;
+        float margin_;
+    };
+
+}  // namespace
+
+
+// Traversal
+namespace {
+
+    struct Ray {
+        glm::vec3 origin_;
+        glm::vec3 dir_;
+        // Reciprocal of `dir_` with zero components nudged to stay finite
+        glm::vec3 inv_dir_;
+        float t_max_;
+    };
+
+    ::Ray make_ray(
+        const glm::vec3& origin,
+        const glm::vec3& direction,
+        const float max_distance
+    ) {
+        ::Ray output;
+        output.origin_ = origin;
+        output.dir_ = direction;
+        output.t_max_ = max_distance;
+        for (int i = 0; i < 3; ++i) {
+            auto d = direction[i];
+            if (std::abs(d) < 1e-20f)
+                d = std::copysign(1e-20f, d);
+            output.inv_dir_[i] = 1.f / d;
+        }
+        return output;
+    }
+
+#if defined(DAL_BVH_SSE)
+
+    class NodeTester {
+
+    public:
+        NodeTester(const ::Ray& ray) {
+            origin_ = _mm_setr_ps(
+                ray.origin_.x, ray.origin_.y, ray.origin_.z, 0
+            );
+            inv_dir_ = _mm_setr_ps(
+                ray.inv_dir_.x, ray.inv_dir_.y, ray.inv_dir_.z, 0
+            );
+            xyz_mask_ = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+            inf_w_ = _mm_setr_ps(
+                0, 0, 0, std::numeric_limits<float>::infinity()
+            );
+        }
+
+        // Entry distance into the slab, or infinity on a miss. The 4th lanes
+        // hold `offset_` and `count_` so they are masked out.
+        float test(const dalp::BvhNode& node, const float t_max) const {
+            const auto p = reinterpret_cast<const float*>(&node);
+            const auto lo = _mm_and_ps(_mm_loadu_ps(p), xyz_mask_);
+            const auto hi = _mm_and_ps(_mm_loadu_ps(p + 4), xyz_mask_);
+
+            const auto t1 = _mm_mul_ps(_mm_sub_ps(lo, origin_), inv_dir_);
+            const auto t2 = _mm_mul_ps(_mm_sub_ps(hi, origin_), inv_dir_);
+            auto t_near = _mm_max_ps(_mm_min_ps(t1, t2), _mm_setzero_ps());
+            auto t_far = _mm_or_ps(_mm_max_ps(t1, t2), inf_w_);
+            t_far = _mm_min_ps(t_far, _mm_set1_ps(t_max));
+
+            t_near = _mm_max_ps(t_near, _mm_movehl_ps(t_near, t_near));
+            t_near = _mm_max_ss(t_near, _mm_shuffle_ps(t_near, t_near, 1));
+            t_far = _mm_min_ps(t_far, _mm_movehl_ps(t_far, t_far));
+            t_far = _mm_min_ss(t_far, _mm_shuffle_ps(t_far, t_far, 1));
+
+            if (_mm_comile_ss(t_near, t_far))
+                return _mm_cvtss_f32(t_near);
+            return std::numeric_limits<float>::infinity();
+        }
+
+    private:
+        __m128 origin_;
+        __m128 inv_dir_;
+        __m128 xyz_mask_;
+        __m128 inf_w_;
+    };
+
+#else
+
+    class NodeTester {
+
+    public:
+        NodeTester(const ::Ray& ray) : ray_(ray) {}
+
+        float test(const dalp::BvhNode& node, const float t_max) const {
+            float t_near = 0, t_far = t_max;
+            for (int i = 0; i < 3; ++i) {
+                const auto o = ray_.origin_[i];
+                const auto t1 = (node.min_[i] - o) * ray_.inv_dir_[i];
+                const auto t2 = (node.max_[i] - o) * ray_.inv_dir_[i];
+                t_near = std::max(t_near, std::min(t1, t2));
+                t_far = std::min(t_far, std::max(t1, t2));
+            }
+
+            if (t_near <= t_far)
+                return t_near;
+            return std::numeric_limits<float>::infinity();
+        }
+
+    private:
+        ::Ray ray_;
+    };
+
+#endif
+
+    // Moller and Trumbore, double sided
+    bool intersect_triangle(
+        const ::Ray& ray,
+        const glm::vec3 (&p)[3],
+        float& t,
+        glm::vec2& barycentric
+    ) {
+        const auto e1 = p[1] - p[0];
+        const auto e2 = p[2] - p[0];
+        const auto pvec = glm::cross(ray.dir_, e2);
+        const auto det = glm::dot(e1, pvec);
+        if (std::abs(det) < 1e-12f)
+            return false;
+
+        const auto inv_det = 1.f / det;
+        const auto tvec = ray.origin_ - p[0];
+        const auto u = glm::dot(tvec, pvec) * inv_det;
+        if (u < 0 || u > 1)
+            return false;
+
+        const auto qvec = glm::cross(tvec, e1);
+        const auto v = glm::dot(ray.dir_, qvec) * inv_det;
+        if (v < 0 || u + v > 1)
+            return false;
+
+        t = glm::dot(e2, qvec) * inv_det;
+        barycentric = glm::vec2{ u, v };
+        return t >= 0;
+    }
+
+    // Calls `on_hit(triangle index, t, barycentric)` for hits closer than
+    // the current `ray.t_max_`, and stops once it returns true
+    template <typename _OnHit>
+    void traverse(
+        const dalp::Model& model, ::Ray& ray, const _OnHit& on_hit
+    ) {
+        const auto& bvh = model.bvh_;
+        if (bvh.empty())
+            return;
+
+        const ::NodeTester tester{ ray };
+        if (tester.test(bvh.nodes_[0], ray.t_max_) > ray.t_max_)
+            return;
+
+        uint32_t stack[BVH_MAX_DEPTH];
+        size_t stack_size = 0;
+        uint32_t current = 0;
+
+        while (true) {
+            const auto& node = bvh.nodes_[current];
+
+            if (0 != node.count_) {
+                for (uint32_t i = 0; i < node.count_; ++i) {
+                    const auto index = node.offset_ + i;
+                    glm::vec3 p[3];
+                    ::get_positions(model, bvh.triangles_[index], p);
+
+                    float t;
+                    glm::vec2 barycentric;
+                    if (!::intersect_triangle(ray, p, t, barycentric))
+                        continue;
+                    if (t > ray.t_max_)
+                        continue;
+                    if (on_hit(index, t, barycentric))
+                        return;
+                }
+            } else {
+                uint32_t near = current + 1;
+                uint32_t far = node.offset_;
+                auto t_near = tester.test(bvh.nodes_[near], ray.t_max_);
+                auto t_far = tester.test(bvh.nodes_[far], ray.t_max_);
+                if (t_far < t_near) {
+                    std::swap(near, far);
+                    std::swap(t_near, t_far);
+                }
+
+                if (t_near <= ray.t_max_) {
+                    if (t_far <= ray.t_max_)
+                        stack[stack_size++] = far;
+                    current = near;
+                    continue;
+                }
+            }
+
+            // Skips nodes the ray got shortened past since they were pushed
+            while (true) {
+                if (0 == stack_size)
+                    return;
+                current = stack[--stack_size];
+                const auto& next = bvh.nodes_[current];
+                if (tester.test(next, ray.t_max_) <= ray.t_max_)
+                    break;
+            }
+        }
+    }
+
+}  // namespace
+
+
+// Validation
+namespace {
+
+    // Returns the index past the subtree at `index`, or 0 if it's malformed
+    size_t validate_node(
+        const dalp::Bvh& bvh, const size_t index, const size_t depth
+    ) {
+        if (depth >= BVH_MAX_DEPTH || index >= bvh.nodes_.size())
+            return 0;
+
+        const auto& node = bvh.nodes_[index];
+        if (0 != node.count_) {
+            const auto end = size_t{ node.offset_ } + node.count_;
+            if (end > bvh.triangles_.size())
+                return 0;
+            return index + 1;
+        }
+
+        const auto left_end = ::validate_node(bvh, index + 1, depth + 1);
+        if (0 == left_end || node.offset_ != left_end)
+            return 0;
+        return ::validate_node(bvh, node.offset_, depth + 1);
+    }
+
+}  // namespace
+
+
+namespace dal::parser {
+
+    Bvh build_bvh(const Model& model, const BvhOptions& options) {
+        ::BvhBuilder builder{ options };
+        return builder.run(model);
+    }
+
+    std::optional<RayHit> intersect_closest(
+        const Model& model,
+        const glm::vec3& origin,
+        const glm::vec3& direction,
+        const float max_distance
+    ) {
+        auto ray = ::make_ray(origin, direction, max_distance);
+        std::optional<RayHit> output;
+
+        ::traverse(
+            model,
+            ray,
+            [&](const uint32_t index, const float t, const glm::vec2& bary) {
+                if (!output.has_value())
+                    output.emplace();
+                output->distance_ = t;
+                output->triangle_ = model.bvh_.triangles_[index];
+                output->barycentric_ = bary;
+                ray.t_max_ = t;
+                return false;
+            }
+        );
+
+        return output;
+    }
+
+    bool intersect_any(
+        const Model& model,
+        const glm::vec3& origin,
+        const glm::vec3& direction,
+        const float max_distance
+    ) {
+        auto ray = ::make_ray(origin, direction, max_distance);
+        bool output = false;
+
+        ::traverse(model, ray, [&](uint32_t, float, const glm::vec2&) {
+            output = true;
+            return true;
+        });
+
+        return output;
+    }
+
+    bool is_valid_bvh(const Bvh& bvh, const Model& model) {
+        if (bvh.nodes_.empty())
+            return bvh.triangles_.empty();
+        if (::validate_node(bvh, 0, 0) != bvh.nodes_.size())
+            return false;
+
+        const auto indexed_count = model.units_indexed_.size();
+        const auto unit_count = indexed_count +
+                                model.units_indexed_joint_.size();
+        for (auto& tri : bvh.triangles_) {
+            if (tri.unit_ >= unit_count)
+                return false;
+
+            size_t index_count;
+            if (tri.unit_ < indexed_count) {
+                const auto& unit = model.units_indexed_[tri.unit_];
+                index_count = unit.mesh_.indices_.size();
+            } else {
+                const auto& unit = model.units_indexed_joint_[tri.unit_ -
+                                                              indexed_count];
+                index_count = unit.mesh_.indices_.size();
+            }
+            if (tri.triangle_ >= index_count / 3)
+                return false;
+        }
+
+        // Out of range vertex indices would also be read during traversal
+        const auto check_indices = [](auto& units) {
+            for (auto& unit : units) {
+                const auto vert_count = unit.mesh_.vertices_.size();
+                for (const auto i : unit.mesh_.indices_) {
+                    if (i >= vert_count)
+                        return false;
+                }
+            }
+            return true;
+        };
+        return check_indices(model.units_indexed_) &&
+               check_indices(model.units_indexed_joint_);
+    }
+
+}  // namespace dal::parser
@@ -0,0 +1,658 @@
+#include "daltools/scene/collision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+#include "daltools/common/util.h"
+#include "daltools/scene/modifier.h"
+
+
+namespace {
+
+    namespace dalp = dal::parser;
+    using scene_t = dalp::SceneIntermediate;
+
+
+    dalp::AABB3 calc_aabb(const std::vector<glm::vec3>& points) {
+        dalp::AABB3 output{ points[0], points[0] };
+        for (auto& p : points) {
+            output.min_ = glm::min(output.min_, p);
+            output.max_ = glm::max(output.max_, p);
+        }
+        return output;
+    }
+
+    float calc_extent(const std::vector<glm::vec3>& points) {
+        if (points.empty())
+            return 0;
+        const auto aabb = ::calc_aabb(points);
+        return glm::length(aabb.max_ - aabb.min_);
+    }
+
+    // Drops vertices no index refers to
+    dalp::CollisionGeometry make_compact_geometry(
+        const std::vector<glm::vec3>& vertices,
+        const std::vector<uint32_t>& indices
+    ) {
+        dalp::CollisionGeometry output;
+        std::unordered_map<uint32_t, uint32_t> remap;
+        output.indices_.reserve(indices.size());
+
+        for (const auto i : indices) {
+            const auto [it, inserted] = remap.emplace(
+                i, static_cast<uint32_t>(output.vertices_.size())
+            );
+            if (inserted)
+                output.vertices_.push_back(vertices[i]);
+            output.indices_.push_back(it->second);
+        }
+        return output;
+    }
+
+}  // namespace
+
+
+// Quickhull
+namespace {
+
+    struct HullFace {
+        uint32_t v_[3];
+        glm::vec3 normal_;
+        float offset_ = 0;
+        std::vector<uint32_t> outside_;
+        // Of `outside_`, cached so picking the next point is cheap
+        uint32_t farthest_ = 0;
+        float farthest_dist_ = 0;
+        bool alive_ = true;
+
+        float distance(const glm::vec3& p) const {
+            return glm::dot(this->normal_, p) - this->offset_;
+        }
+    };
+
+
+    class QuickHull {
+
+    public:
+        QuickHull(const std::vector<glm::vec3>& points) : points_(points) {}
+
+        dalp::CollisionGeometry run(const uint32_t max_vertices) {
+            if (this->points_.size() < 4)
+                return {};
+
+            this->eps_ = std::max(
+                ::calc_extent(this->points_) * 1e-5f,
+                std::numeric_limits<float>::min()
+            );
+
+            uint32_t simplex[4] = {};
+            if (!this->find_simplex(simplex))
+                return {};
+            this->init_faces(simplex);
+
+            uint32_t vertex_count = 4;
+            while (0 == max_vertices || vertex_count < max_vertices) {
+                const auto face = this->find_farthest_face();
+                if (face < 0)
+                    break;
+
+                this->add_point(face, this->faces_[face].farthest_);
+                ++vertex_count;
+            }
+
+            // Degenerate faces only keep the mesh closed while building
+            std::vector<uint32_t> indices;
+            for (auto& face : this->faces_) {
+                if (face.alive_ && face.normal_ != glm::vec3{ 0 })
+                    indices.insert(indices.end(), face.v_, face.v_ + 3);
+            }
+            return ::make_compact_geometry(this->points_, indices);
+        }
+
+    private:
+        bool find_simplex(uint32_t (&output)[4]) const {
+            const auto& p = this->points_;
+
+            // Extreme points along each axis
+            uint32_t extremes[6] = {};
+            for (uint32_t i = 0; i < p.size(); ++i) {
+                for (int a = 0; a < 3; ++a) {
+                    if (p[i][a] < p[extremes[2 * a]][a])
+                        extremes[2 * a] = i;
+                    if (p[i][a] > p[extremes[2 * a + 1]][a])
+                        extremes[2 * a + 1] = i;
+                }
+            }
+
+            float best = 0;
+            for (int i = 0; i < 6; ++i) {
+                for (int j = i + 1; j < 6; ++j) {
+                    const auto d = p[extremes[i]] - p[extremes[j]];
+                    if (glm::dot(d, d) > best) {
+                        best = glm::dot(d, d);
+                        output[0] = extremes[i];
+                        output[1] = extremes[j];
+                    }
+                }
+            }
+            if (std::sqrt(best) <= this->eps_)
+                return false;
+
+            // Farthest from the line
+            const auto dir = glm::normalize(p[output[1]] - p[output[0]]);
+            best = 0;
+            for (uint32_t i = 0; i < p.size(); ++i) {
+                const auto d = glm::length(
+                    glm::cross(p[i] - p[output[0]], dir)
+                );
+                if (d > best) {
+                    best = d;
+                    output[2] = i;
+                }
+            }
+            if (best <= this->eps_)
+                return false;
+
+            // Farthest from the plane
+            const auto normal = glm::normalize(glm::cross(
+                p[output[1]] - p[output[0]], p[output[2]] - p[output[0]]
+            ));
+            best = 0;
+            for (uint32_t i = 0; i < p.size(); ++i) {
+                const auto d = std::abs(glm::dot(p[i] - p[output[0]], normal));
+                if (d > best) {
+                    best = d;
+                    output[3] = i;
+                }
+            }
+            return best > this->eps_;
+        }
+
+        void init_faces(const uint32_t (&s)[4]) {
+            const auto& p = this->points_;
+            const auto center = (p[s[0]] + p[s[1]] + p[s[2]] + p[s[3]]) *
+                                0.25f;
+
+            uint32_t tris[4][3] = {
+                { s[0], s[1], s[2] },
+                { s[0], s[1], s[3] },
+                { s[0], s[2], s[3] },
+                { s[1], s[2], s[3] },
+            };
+            for (auto& tri : tris) {
+                // Outward means the center is behind it
+                const auto n = glm::cross(
+                    p[tri[1]] - p[tri[0]], p[tri[2]] - p[tri[0]]
+                );
+                if (glm::dot(n, center - p[tri[0]]) > 0)
+                    std::swap(tri[1], tri[2]);
+                this->make_face(tri[0], tri[1], tri[2]);
+            }
+
+            std::vector<uint32_t> all(p.size());
+            for (uint32_t i = 0; i < all.size(); ++i) all[i] = i;
+            this->assign_points(all, 0);
+        }
+
+        ::HullFace& make_face(
+            const uint32_t a, const uint32_t b, const uint32_t c
+        ) {
+            const auto& p = this->points_;
+            const auto face_index = static_cast<uint32_t>(this->faces_.size());
+            auto& face = this->faces_.emplace_back();
+            face.v_[0] = a;
+            face.v_[1] = b;
+            face.v_[2] = c;
+            this->edge_faces_[{ a, b }] = face_index;
+            this->edge_faces_[{ b, c }] = face_index;
+            this->edge_faces_[{ c, a }] = face_index;
+
+            // In double since slivers are common near the end
+            const glm::dvec3 pa{ p[a] };
+            const auto n = glm::cross(
+                glm::dvec3{ p[b] } - pa, glm::dvec3{ p[c] } - pa
+            );
+            const auto len = glm::length(n);
+            if (len > 0) {
+                face.normal_ = glm::vec3{ n / len };
+                face.offset_ = static_cast<float>(glm::dot(n / len, pa));
+            } else {
+                // Zero distance to every point, so it is never visible
+                face.normal_ = glm::vec3{ 0 };
+                face.offset_ = 0;
+            }
+            return face;
+        }
+
+        // To the first face among `faces_[first_face:]` each point is
+        // outside of. Points inside all of them are dropped.
+        void assign_points(
+            const std::vector<uint32_t>& points, const size_t first_face
+        ) {
+            for (const auto i : points) {
+                for (size_t f = first_face; f < this->faces_.size(); ++f) {
+                    auto& face = this->faces_[f];
+                    const auto d = face.distance(this->points_[i]);
+                    if (d <= this->eps_)
+                        continue;
+
+                    face.outside_.push_back(i);
+                    if (d > face.farthest_dist_) {
+                        face.farthest_dist_ = d;
+                        face.farthest_ = i;
+                    }
+                    break;
+                }
+            }
+        }
+
+        int64_t find_farthest_face() const {
+            int64_t output = -1;
+            float best = 0;
+            for (size_t f = 0; f < this->faces_.size(); ++f) {
+                auto& face = this->faces_[f];
+                if (!face.alive_ || face.outside_.empty())
+                    continue;
+                if (face.farthest_dist_ > best) {
+                    best = face.farthest_dist_;
+                    output = static_cast<int64_t>(f);
+                }
+            }
+            return output;
+        }
+
+        // Visible faces are collected by walking from `start_face` over
+        // neighbours, so that with the tolerance they still form one region
+        // and its boundary is a single loop
+        void add_point(const int64_t start_face, const uint32_t index) {
+            const auto& point = this->points_[index];
+
+            std::vector<uint32_t> visible;
+            std::vector<uint32_t> stack{ static_cast<uint32_t>(start_face) };
+            std::set<uint32_t> visited{ stack.back() };
+            while (!stack.empty()) {
+                const auto f = stack.back();
+                stack.pop_back();
+                visible.push_back(f);
+
+                const auto& face = this->faces_[f];
+                for (int i = 0; i < 3; ++i) {
+                    const auto twin = this->edge_faces_.find(
+                        { face.v_[(i + 1) % 3], face.v_[i] }
+                    );
+                    if (this->edge_faces_.end() == twin)
+                        continue;
+                    const auto neighbour = twin->second;
+                    if (!visited.insert(neighbour).second)
+                        continue;
+                    if (this->faces_[neighbour].distance(point) > this->eps_)
+                        stack.push_back(neighbour);
+                }
+            }
+
+            std::set<std::pair<uint32_t, uint32_t>> edges;
+            std::vector<uint32_t> orphans;
+            for (const auto f : visible) {
+                auto& face = this->faces_[f];
+                face.alive_ = false;
+                for (int i = 0; i < 3; ++i) {
+                    const std::pair<uint32_t, uint32_t> edge{
+                        face.v_[i], face.v_[(i + 1) % 3]
+                    };
+                    edges.insert(edge);
+                    this->edge_faces_.erase(edge);
+                }
+                for (const auto x : face.outside_) {
+                    if (x != index)
+                        orphans.push_back(x);
+                }
+                face.outside_.clear();
+                face.outside_.shrink_to_fit();
+            }
+
+            // Edges of visible faces whose twin belongs to a hidden face
+            const auto first_new = this->faces_.size();
+            for (auto& [a, b] : edges) {
+                if (edges.end() == edges.find({ b, a }))
+                    this->make_face(a, b, index);
+            }
+
+            this->assign_points(orphans, first_new);
+        }
+
+        const std::vector<glm::vec3>& points_;
+        std::vector<::HullFace> faces_;
+        // Directed edge to the face that has it, for walking over neighbours
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> edge_faces_;
+        float eps_ = 0;
+    };
+
+}  // namespace
+
+
+// Decomposition
+namespace {
+
+    // Deepest distance of `points` inside `hull`, 0 if none is inside
+    float calc_concavity(
+        const dalp::CollisionGeometry& hull,
+        const std::vector<glm::vec3>& points
+    ) {
+        struct Plane {
+            glm::vec3 normal_;
+            float offset_;
+        };
+        std::vector<Plane> planes;
+        for (size_t i = 0; i < hull.indices_.size(); i += 3) {
+            const auto& a = hull.vertices_[hull.indices_[i + 0]];
+            const auto& b = hull.vertices_[hull.indices_[i + 1]];
+            const auto& c = hull.vertices_[hull.indices_[i + 2]];
+            const auto n = glm::cross(b - a, c - a);
+            const auto len = glm::length(n);
+            if (len > 0)
+                planes.push_back({ n / len, glm::dot(n / len, a) });
+        }
+
+        float output = 0;
+        for (auto& p : points) {
+            auto depth = std::numeric_limits<float>::max();
+            for (auto& plane : planes) {
+                const auto d = plane.offset_ - glm::dot(plane.normal_, p);
+                depth = std::min(depth, d);
+            }
+            output = std::max(output, depth);
+        }
+        return output;
+    }
+
+    struct Part {
+        // Indices of the first vertex of each triangle
+        std::vector<uint32_t> triangles_;
+        dalp::CollisionGeometry hull_;
+        float concavity_ = 0;
+    };
+
+    class Decomposer {
+
+    public:
+        Decomposer(
+            const std::vector<glm::vec3>& positions,
+            const dalp::CollisionOptions& options
+        )
+            : positions_(positions)
+            , options_(options)
+            , extent_(::calc_extent(positions)) {}
+
+        std::vector<dalp::CollisionGeometry> run() {
+            std::vector<::Part> parts(1);
+            for (uint32_t i = 0; i < this->positions_.size(); i += 3)
+                parts[0].triangles_.push_back(i);
+            // Meshes without volume are left to a trimesh
+            if (!this->finish_part(parts[0]))
+                return {};
+
+            const auto max_concavity = this->options_.max_concavity_ *
+                                       this->extent_;
+            while (parts.size() < this->options_.max_hulls_) {
+                size_t worst = 0;
+                for (size_t i = 1; i < parts.size(); ++i) {
+                    if (parts[i].concavity_ > parts[worst].concavity_)
+                        worst = i;
+                }
+                if (parts[worst].concavity_ <= max_concavity)
+                    break;
+
+                ::Part other;
+                if (!this->split(parts[worst], other)) {
+                    parts[worst].concavity_ = 0;
+                    continue;
+                }
+                this->finish_part(parts[worst]);
+                this->finish_part(other);
+                parts.push_back(std::move(other));
+            }
+
+            std::vector<dalp::CollisionGeometry> output;
+            for (auto& part : parts) {
+                if (!part.hull_.empty())
+                    output.push_back(std::move(part.hull_));
+            }
+            return output;
+        }
+
+    private:
+        std::vector<glm::vec3> gather_points(const ::Part& part) const {
+            std::vector<glm::vec3> output;
+            output.reserve(part.triangles_.size() * 4);
+            for (const auto t : part.triangles_) {
+                const auto* p = &this->positions_[t];
+                output.insert(output.end(), p, p + 3);
+                // Centers catch concave faces whose corners lie on the hull
+                output.push_back((p[0] + p[1] + p[2]) / 3.f);
+            }
+            return output;
+        }
+
+        // False if the part is flat and became a slab
+        bool finish_part(::Part& part) const {
+            auto points = this->gather_points(part);
+            part.hull_ = dalp::build_convex_hull(
+                points, this->options_.max_hull_vertices_
+            );
+
+            // A flat piece of a bigger mesh, such as a floor, becomes a slab
+            if (part.hull_.empty()) {
+                const auto normal = this->find_normal(part);
+                const auto thickness = this->extent_ * 0.001f;
+                const auto count = points.size();
+                for (size_t i = 0; i < count; ++i)
+                    points.push_back(points[i] - normal * thickness);
+                part.hull_ = dalp::build_convex_hull(
+                    points, this->options_.max_hull_vertices_
+                );
+                part.concavity_ = 0;
+                return false;
+            }
+
+            part.concavity_ = ::calc_concavity(part.hull_, points);
+            return true;
+        }
+
+        glm::vec3 find_normal(const ::Part& part) const {
+            for (const auto t : part.triangles_) {
+                const auto* p = &this->positions_[t];
+                const auto n = glm::cross(p[1] - p[0], p[2] - p[0]);
+                const auto len = glm::length(n);
+                if (len > 0)
+                    return n / len;
+            }
+            return glm::vec3{ 0, 1, 0 };
+        }
+
+        // Across the longest axis of triangle centers, moving the far half
+        // into `other`
+        bool split(::Part& part, ::Part& other) const {
+            auto& tris = part.triangles_;
+            if (tris.size() < 2)
+                return false;
+
+            const auto center_of = [this](const uint32_t t) {
+                const auto* p = &this->positions_[t];
+                return (p[0] + p[1] + p[2]) / 3.f;
+            };
+
+            glm::vec3 lo = center_of(tris[0]), hi = lo;
+            for (const auto t : tris) {
+                lo = glm::min(lo, center_of(t));
+                hi = glm::max(hi, center_of(t));
+            }
+            const auto extent = hi - lo;
+            int axis = 0;
+            if (extent.y > extent[axis])
+                axis = 1;
+            if (extent.z > extent[axis])
+                axis = 2;
+            if (extent[axis] <= 0)
+                return false;
+
+            const auto mid_value = (lo[axis] + hi[axis]) * 0.5f;
+            auto mid = std::partition(
+                tris.begin(), tris.end(), [&](const uint32_t t) {
+                    return center_of(t)[axis] < mid_value;
+                }
+            );
+            if (mid == tris.begin() || mid == tris.end()) {
+                mid = tris.begin() + tris.size() / 2;
+                std::nth_element(
+                    tris.begin(),
+                    mid,
+                    tris.end(),
+                    [&](const uint32_t a, const uint32_t b) {
+                        return center_of(a)[axis] < center_of(b)[axis];
+                    }
+                );
+            }
+
+            other.triangles_.assign(mid, tris.end());
+            tris.erase(mid, tris.end());
+            return true;
+        }
+
+        const std::vector<glm::vec3>& positions_;
+        const dalp::CollisionOptions& options_;
+        float extent_;
+    };
+
+}  // namespace
+
+
+// build_collision
+namespace {
+
+    // Corners of every triangle, 3 per triangle
+    std::vector<glm::vec3> make_triangle_soup(const scene_t::Mesh& mesh) {
+        std::vector<glm::vec3> output;
+        output.reserve(mesh.indices_.size());
+        for (const auto i : mesh.indices_)
+            output.push_back(mesh.vertices_[i].pos_);
+        output.resize(output.size() / 3 * 3);
+        return output;
+    }
+
+    dalp::CollisionGeometry make_trimesh(
+        const scene_t::Mesh& mesh, const dalp::CollisionOptions& options
+    ) {
+        // Normals and UVs don't matter, so seams weld together
+        dalp::Mesh_Indexed welded;
+        dalp::TVertexWeldIndex<dalp::Vertex> weld_index;
+        for (const auto i : mesh.indices_) {
+            dalp::Vertex vertex{};
+            vertex.pos_ = mesh.vertices_[i].pos_;
+            welded.add_vertex(vertex, weld_index);
+        }
+        welded.indices_.resize(welded.indices_.size() / 3 * 3);
+
+        std::vector<glm::vec3> positions;
+        positions.reserve(welded.vertices_.size());
+        for (auto& v : welded.vertices_) positions.push_back(v.pos_);
+
+        auto indices = welded.indices_;
+        if (options.trimesh_ratio_ < 1) {
+            const auto lod = dalp::simplify_mesh(
+                welded, options.trimesh_ratio_, options.trimesh_max_error_
+            );
+            if (!lod.indices_.empty())
+                indices = lod.indices_;
+        }
+
+        return ::make_compact_geometry(positions, indices);
+    }
+
+    dalp::CollisionMesh make_collision_mesh(
+        const scene_t::Mesh& mesh, const dalp::CollisionOptions& options
+    ) {
+        using Shape = dalp::CollisionShape;
+
+        dalp::CollisionMesh output;
+        output.name_ = mesh.name_;
+
+        const auto soup = ::make_triangle_soup(mesh);
+        if (soup.empty())
+            return output;
+
+        if (Shape::convex_hull == options.shape_) {
+            auto hull = dalp::build_convex_hull(
+                soup, options.max_hull_vertices_
+            );
+            if (!hull.empty())
+                output.hulls_.push_back(std::move(hull));
+        } else if (Shape::convex_decomposition == options.shape_) {
+            output.hulls_ = ::Decomposer{ soup, options }.run();
+        }
+
+        if (Shape::trimesh == options.shape_ || output.hulls_.empty())
+            output.trimesh_ = ::make_trimesh(mesh, options);
+
+        return output;
+    }
+
+}  // namespace
+
+
+namespace dal::parser {
+
+    CollisionGeometry build_convex_hull(
+        const std::vector<glm::vec3>& points, const uint32_t max_vertices
+    ) {
+        const auto limit = 0 == max_vertices ? 0 : std::max(max_vertices, 4u);
+        return ::QuickHull{ points }.run(limit);
+    }
+
+    CollisionScene build_collision(
+        const SceneIntermediate& scene,
+        const CollisionOptions& options,
+        const uint32_t thread_count
+    ) {
+        CollisionScene output;
+        std::vector<const scene_t::Mesh*> src_meshes;
+        std::unordered_map<std::string, uint32_t> mesh_indices;
+
+        for (auto& actor : scene.mesh_actors_) {
+            CollisionActor dst;
+            for (auto& pair : actor.render_pairs_) {
+                const auto mesh = scene.find_mesh_by_name(pair.mesh_name_);
+                if (nullptr == mesh || !mesh->skeleton_name_.empty())
+                    continue;
+
+                const auto [it, inserted] = mesh_indices.emplace(
+                    mesh->name_, static_cast<uint32_t>(src_meshes.size())
+                );
+                if (inserted)
+                    src_meshes.push_back(mesh);
+
+                auto& list = dst.meshes_;
+                const auto index = it->second;
+                if (list.end() == std::find(list.begin(), list.end(), index))
+                    list.push_back(index);
+            }
+
+            if (dst.meshes_.empty())
+                continue;
+            dst.name_ = actor.name_;
+            dst.transform_ = scene.make_hierarchy_transform(actor);
+            output.actors_.push_back(std::move(dst));
+        }
+
+        output.meshes_.resize(src_meshes.size());
+        dal::parallel_for(src_meshes.size(), thread_count, [&](size_t i) {
+            output.meshes_[i] = ::make_collision_mesh(*src_meshes[i], options);
+        });
+
+        return output;
+    }
+
+}  // namespace dal::parser
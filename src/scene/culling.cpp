@@ -0,0 +1,335 @@
+#include "daltools/scene/culling.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+
+#include "daltools/common/util.h"
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define DAL_CULLING_AVX2
+#elif defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+    #include <xmmintrin.h>
+    #define DAL_CULLING_SSE
+#endif
+
+
+namespace {
+
+    namespace dalp = dal::parser;
+
+}  // namespace
+
+
+// SIMD lanes
+namespace {
+
+#if defined(DAL_CULLING_AVX2)
+
+    struct Pack {
+        static constexpr size_t WIDTH = 8;
+        __m256 v_;
+    };
+
+    Pack pack_load(const float* p) { return { _mm256_loadu_ps(p) }; }
+    Pack pack_set(float x) { return { _mm256_set1_ps(x) }; }
+
+    Pack operator+(Pack a, Pack b) { return { _mm256_add_ps(a.v_, b.v_) }; }
+    Pack operator*(Pack a, Pack b) { return { _mm256_mul_ps(a.v_, b.v_) }; }
+
+    Pack pack_abs(Pack a) {
+        return { _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v_) };
+    }
+    Pack pack_max(Pack a, Pack b) { return { _mm256_max_ps(a.v_, b.v_) }; }
+    Pack pack_sqrt(Pack a) { return { _mm256_sqrt_ps(a.v_) }; }
+
+    // Bit i is set if lane i of `a` is not negative
+    uint32_t pack_non_negative(Pack a) {
+        const auto zero = _mm256_setzero_ps();
+        const auto cmp = _mm256_cmp_ps(a.v_, zero, _CMP_GE_OQ);
+        return static_cast<uint32_t>(_mm256_movemask_ps(cmp));
+    }
+
+    constexpr char SIMD_NAME[] = "AVX2";
+
+#elif defined(DAL_CULLING_SSE)
+
+    struct Pack {
+        static constexpr size_t WIDTH = 4;
+        __m128 v_;
+    };
+
+    Pack pack_load(const float* p) { return { _mm_loadu_ps(p) }; }
+    Pack pack_set(float x) { return { _mm_set1_ps(x) }; }
+
+    Pack operator+(Pack a, Pack b) { return { _mm_add_ps(a.v_, b.v_) }; }
+    Pack operator*(Pack a, Pack b) { return { _mm_mul_ps(a.v_, b.v_) }; }
+
+    Pack pack_abs(Pack a) {
+        return { _mm_andnot_ps(_mm_set1_ps(-0.f), a.v_) };
+    }
+    Pack pack_max(Pack a, Pack b) { return { _mm_max_ps(a.v_, b.v_) }; }
+    Pack pack_sqrt(Pack a) { return { _mm_sqrt_ps(a.v_) }; }
+
+    uint32_t pack_non_negative(Pack a) {
+        const auto cmp = _mm_cmpge_ps(a.v_, _mm_setzero_ps());
+        return static_cast<uint32_t>(_mm_movemask_ps(cmp));
+    }
+
+    constexpr char SIMD_NAME[] = "SSE";
+
+#else
+
+    struct Pack {
+        static constexpr size_t WIDTH = 1;
+        float v_;
+    };
+
+    Pack pack_load(const float* p) { return { *p }; }
+    Pack pack_set(float x) { return { x }; }
+
+    Pack operator+(Pack a, Pack b) { return { a.v_ + b.v_ }; }
+    Pack operator*(Pack a, Pack b) { return { a.v_ * b.v_ }; }
+
+    Pack pack_abs(Pack a) { return { std::abs(a.v_) }; }
+    Pack pack_max(Pack a, Pack b) { return { std::max(a.v_, b.v_) }; }
+    Pack pack_sqrt(Pack a) { return { std::sqrt(a.v_) }; }
+
+    uint32_t pack_non_negative(Pack a) { return a.v_ >= 0 ? 1 : 0; }
+
+    constexpr char SIMD_NAME[] = "none";
+
+#endif
+
+}  // namespace
+
+
+// Frustum tests
+namespace {
+
+    // Instances per task, a multiple of 64 so tasks never share a mask word
+    constexpr size_t CULLING_BLOCK_SIZE = 64 * 64;
+
+    struct Frustum {
+        // Normalized, inside is where dot(xyz, p) + w >= 0
+        std::array<glm::vec4, 6> planes_;
+    };
+
+    // Gribb and Hartmann. The near plane is the one for [-1, 1] depth, which
+    // contains the one for [0, 1].
+    ::Frustum make_frustum(const glm::mat4& m) {
+        const auto row = [&](const int i) {
+            return glm::vec4{ m[0][i], m[1][i], m[2][i], m[3][i] };
+        };
+
+        ::Frustum output;
+        output.planes_ = { row(3) + row(0), row(3) - row(0),
+                           row(3) + row(1), row(3) - row(1),
+                           row(3) + row(2), row(3) - row(2) };
+
+        for (auto& p : output.planes_) {
+            const auto len = glm::length(glm::vec3{ p });
+            if (len > 0)
+                p = p / len;
+        }
+        return output;
+    }
+
+    // Rows 0 to 2 of `Pack::WIDTH` affine transforms
+    struct PackTransform {
+        Pack m_[12];
+    };
+
+    ::PackTransform load_transforms(
+        const dalp::InstanceTransforms& instances,
+        const size_t first,
+        const size_t count
+    ) {
+        ::PackTransform output;
+
+        if (Pack::WIDTH == count) {
+            for (int i = 0; i < 12; ++i) {
+                const auto src = instances.data(i / 4, i % 4) + first;
+                output.m_[i] = ::pack_load(src);
+            }
+            return output;
+        }
+
+        // Lanes past the end are zero and masked out by the caller
+        for (int i = 0; i < 12; ++i) {
+            float buf[Pack::WIDTH] = {};
+            const auto src = instances.data(i / 4, i % 4) + first;
+            std::copy(src, src + count, buf);
+            output.m_[i] = ::pack_load(buf);
+        }
+        return output;
+    }
+
+    // World space center of `local` for each lane
+    void transform_point(
+        const ::PackTransform& t, const glm::vec3& local, Pack (&output)[3]
+    ) {
+        for (int r = 0; r < 3; ++r) {
+            const auto m = &t.m_[4 * r];
+            output[r] = m[0] * ::pack_set(local.x) +
+                        m[1] * ::pack_set(local.y) +
+                        m[2] * ::pack_set(local.z) + m[3];
+        }
+    }
+
+    Pack plane_distance(const glm::vec4& plane, const Pack (&p)[3]) {
+        return p[0] * ::pack_set(plane.x) + p[1] * ::pack_set(plane.y) +
+               p[2] * ::pack_set(plane.z) + ::pack_set(plane.w);
+    }
+
+    uint32_t test_aabb(
+        const ::Frustum& frustum,
+        const ::PackTransform& t,
+        const glm::vec3& center,
+        const glm::vec3& extent
+    ) {
+        Pack world_center[3], world_extent[3];
+        ::transform_point(t, center, world_center);
+
+        // Extents of the transformed box, which is the AABB of it
+        for (int r = 0; r < 3; ++r) {
+            const auto m = &t.m_[4 * r];
+            world_extent[r] = ::pack_abs(m[0]) * ::pack_set(extent.x) +
+                              ::pack_abs(m[1]) * ::pack_set(extent.y) +
+                              ::pack_abs(m[2]) * ::pack_set(extent.z);
+        }
+
+        uint32_t output = ~0u;
+        for (auto& plane : frustum.planes_) {
+            const auto dist = ::plane_distance(plane, world_center);
+            const auto abs_n = glm::abs(glm::vec3{ plane });
+            const auto radius = world_extent[0] * ::pack_set(abs_n.x) +
+                                world_extent[1] * ::pack_set(abs_n.y) +
+                                world_extent[2] * ::pack_set(abs_n.z);
+            output &= ::pack_non_negative(dist + radius);
+        }
+        return output;
+    }
+
+    uint32_t test_sphere(
+        const ::Frustum& frustum,
+        const ::PackTransform& t,
+        const glm::vec3& center,
+        const float radius
+    ) {
+        Pack world_center[3];
+        ::transform_point(t, center, world_center);
+
+        // Largest column length of the linear part
+        auto scale2 = ::pack_set(0);
+        for (int c = 0; c < 3; ++c) {
+            const auto x = t.m_[c], y = t.m_[4 + c], z = t.m_[8 + c];
+            scale2 = ::pack_max(scale2, x * x + y * y + z * z);
+        }
+        const auto world_radius = ::pack_sqrt(scale2) * ::pack_set(radius);
+
+        uint32_t output = ~0u;
+        for (auto& plane : frustum.planes_) {
+            const auto dist = ::plane_distance(plane, world_center);
+            output &= ::pack_non_negative(dist + world_radius);
+        }
+        return output;
+    }
+
+    template <typename _Test>
+    size_t cull_blocks(
+        const dalp::InstanceTransforms& instances,
+        std::vector<uint64_t>& visible,
+        const uint32_t thread_count,
+        const _Test& test
+    ) {
+        const auto count = instances.size();
+        const auto block_count = (count + CULLING_BLOCK_SIZE - 1) /
+                                 CULLING_BLOCK_SIZE;
+        visible.assign((count + 63) / 64, 0);
+        std::vector<size_t> block_visible(block_count, 0);
+
+        dal::parallel_for(block_count, thread_count, [&](const size_t b) {
+            const auto begin = b * CULLING_BLOCK_SIZE;
+            const auto end = std::min(begin + CULLING_BLOCK_SIZE, count);
+
+            size_t visible_count = 0;
+            for (size_t i = begin; i < end; i += Pack::WIDTH) {
+                const auto lanes = std::min(Pack::WIDTH, end - i);
+                const auto t = ::load_transforms(instances, i, lanes);
+                const auto mask = test(t) & ((1u << lanes) - 1);
+
+                // `Pack::WIDTH` divides 64 so a pack never spans two words
+                visible[i / 64] |= uint64_t{ mask } << (i % 64);
+                visible_count += std::bitset<32>{ mask }.count();
+            }
+            block_visible[b] = visible_count;
+        });
+
+        size_t output = 0;
+        for (const auto x : block_visible) output += x;
+        return output;
+    }
+
+}  // namespace
+
+
+namespace dal::parser {
+
+    void InstanceTransforms::push_back(const glm::mat4& transform) {
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 4; ++col) {
+                this->elements_[4 * row + col].push_back(transform[col][row]);
+            }
+        }
+    }
+
+    void InstanceTransforms::reserve(const size_t count) {
+        for (auto& x : this->elements_) x.reserve(count);
+    }
+
+    void InstanceTransforms::clear() {
+        for (auto& x : this->elements_) x.clear();
+    }
+
+
+    size_t cull_instances(
+        const glm::mat4& view_proj,
+        const InstanceTransforms& instances,
+        const AABB3& bounds,
+        std::vector<uint64_t>& visible,
+        const uint32_t thread_count
+    ) {
+        const auto frustum = ::make_frustum(view_proj);
+        const auto center = (bounds.min_ + bounds.max_) * 0.5f;
+        const auto extent = (bounds.max_ - bounds.min_) * 0.5f;
+
+        return ::cull_blocks(
+            instances, visible, thread_count, [&](const ::PackTransform& t) {
+                return ::test_aabb(frustum, t, center, extent);
+            }
+        );
+    }
+
+    size_t cull_instances(
+        const glm::mat4& view_proj,
+        const InstanceTransforms& instances,
+        const BoundingSphere& bounds,
+        std::vector<uint64_t>& visible,
+        const uint32_t thread_count
+    ) {
+        const auto frustum = ::make_frustum(view_proj);
+
+        return ::cull_blocks(
+            instances, visible, thread_count, [&](const ::PackTransform& t) {
+                return ::test_sphere(
+                    frustum, t, bounds.center_, bounds.radius_
+                );
+            }
+        );
+    }
+
+    const char* culling_simd_name() { return ::SIMD_NAME; }
+
+}  // namespace dal::parser
@@ -3,6 +3,8 @@
 #include <unordered_map>
 #include <unordered_set>
 
+#include "daltools/common/util.h"
+
 
 namespace {
 
@@ -13,6 +15,10 @@ namespace {
         dalp::Mesh_IndexedJoint& output, const dalp::Mesh_StraightJoint& input
     ) {
         const auto vertex_count = input.vertices_.size() / 3;
+        output.indices_.reserve(output.indices_.size() + vertex_count);
+        dalp::TVertexWeldIndex<dalp::VertexJoint> weld_index;
+        weld_index.build_from(output.vertices_);
+        weld_index.reserve(output.vertices_.size() + vertex_count);
 
         for (size_t i = 0; i < vertex_count; ++i) {
             dalp::VertexJoint vert;
@@ -45,7 +51,7 @@ namespace {
                 input.joint_indices_[dalp::NUM_JOINTS_PER_VERTEX * i + 3]
             };
 
-            output.add_vertex(vert);
+            output.add_vertex(vert, weld_index);
         }
     }
 
@@ -53,6 +59,10 @@ namespace {
         dalp::Mesh_Indexed& output, const dalp::Mesh_Straight& input
     ) {
         const auto vertex_count = input.vertices_.size() / 3;
+        output.indices_.reserve(output.indices_.size() + vertex_count);
+        dalp::TVertexWeldIndex<dalp::Vertex> weld_index;
+        weld_index.build_from(output.vertices_);
+        weld_index.reserve(output.vertices_.size() + vertex_count);
 
         for (size_t i = 0; i < vertex_count; ++i) {
             dalp::Vertex vert;
@@ -69,7 +79,7 @@ namespace {
                                                      input.normals_[3 * i + 2] }
             );
 
-            output.add_vertex(vert);
+            output.add_vertex(vert, weld_index);
         }
     }
 
@@ -80,12 +90,63 @@ namespace {
         std::vector<dalp::RenderUnit<_Mesh>>& units
     ) {
         for (auto& x : units)
-            if (x.material_.is_physically_same(criteria.material_))
+            if (x.material_.is_physically_same(criteria.material_) &&
+                x.instances_ == criteria.instances_)
                 return &x;
 
         return nullptr;
     };
 
+    // Concatenates meshes into one destination. Straight meshes have
+    // nothing to weld.
+    template <typename _Mesh>
+    class MeshConcatenator {
+
+    public:
+        explicit MeshConcatenator(const _Mesh&) {}
+
+        template <typename _Src>
+        void concat(_Mesh& dst, _Src&& src) {
+            dst.concat(std::forward<_Src>(src));
+        }
+    };
+
+    // Indexed meshes share one weld index across merges
+    template <typename _Vertex>
+    class MeshConcatenator<dalp::TMesh_Indexed<_Vertex>> {
+
+    public:
+        explicit MeshConcatenator(const dalp::TMesh_Indexed<_Vertex>& dst) {
+            this->weld_index_.build_from(dst.vertices_);
+        }
+
+        template <typename _Src>
+        void concat(dalp::TMesh_Indexed<_Vertex>& dst, _Src&& src) {
+            dst.concat(std::forward<_Src>(src), this->weld_index_);
+        }
+
+    private:
+        dalp::TVertexWeldIndex<_Vertex> weld_index_;
+    };
+
+    // Created on the first merge into each unit of `output`, before which
+    // the unit is unchanged
+    template <typename _Mesh>
+    ::MeshConcatenator<_Mesh>& get_concatenator(
+        std::vector<std::optional<::MeshConcatenator<_Mesh>>>& concatenators,
+        const std::vector<dalp::RenderUnit<_Mesh>>& output,
+        const dalp::RenderUnit<_Mesh>& dst_unit
+    ) {
+        const auto index = static_cast<size_t>(&dst_unit - output.data());
+        if (concatenators.size() < output.size())
+            concatenators.resize(output.size());
+
+        auto& concatenator = concatenators[index];
+        if (!concatenator.has_value())
+            concatenator.emplace(dst_unit.mesh_);
+        return concatenator.value();
+    }
+
     template <typename _Mesh>
     std::vector<dalp::RenderUnit<_Mesh>> merge_by_material(
         const std::vector<dalp::RenderUnit<_Mesh>>& units
@@ -94,6 +155,7 @@ namespace {
         if (units.empty())
             return output;
 
+        std::vector<std::optional<::MeshConcatenator<_Mesh>>> concatenators;
         output.push_back(units[0]);
 
         for (size_t i = 1; i < units.size(); ++i) {
@@ -107,7 +169,8 @@ namespace {
             auto dst_unit = ::find_same_material(this_unit, output);
 
             if (nullptr != dst_unit)
-                dst_unit->mesh_.concat(this_unit.mesh_);
+                ::get_concatenator(concatenators, output, *dst_unit)
+                    .concat(dst_unit->mesh_, this_unit.mesh_);
             else
                 output.push_back(this_unit);
         }
@@ -115,6 +178,56 @@ namespace {
         return output;
     }
 
+    // Moves units into the output and meshes into their merge targets
+    template <typename _Mesh>
+    std::vector<dalp::RenderUnit<_Mesh>> merge_by_material(
+        std::vector<dalp::RenderUnit<_Mesh>>&& units
+    ) {
+        std::vector<dalp::RenderUnit<_Mesh>> output;
+        if (units.empty())
+            return output;
+
+        std::vector<std::optional<::MeshConcatenator<_Mesh>>> concatenators;
+        output.reserve(units.size());
+        output.push_back(std::move(units[0]));
+
+        for (size_t i = 1; i < units.size(); ++i) {
+            auto& this_unit = units[i];
+
+            if (this_unit.material_.transparency_) {
+                output.push_back(std::move(this_unit));
+                continue;
+            }
+
+            auto dst_unit = ::find_same_material(this_unit, output);
+
+            if (nullptr != dst_unit)
+                ::get_concatenator(concatenators, output, *dst_unit)
+                    .concat(dst_unit->mesh_, std::move(this_unit.mesh_));
+            else
+                output.push_back(std::move(this_unit));
+        }
+
+        units.clear();
+        return output;
+    }
+
+    template <typename _DstMesh, typename _SrcMesh>
+    std::vector<dalp::RenderUnit<_DstMesh>> convert_units_to_indexed(
+        const std::vector<dalp::RenderUnit<_SrcMesh>>& units,
+        const uint32_t thread_count
+    ) {
+        std::vector<dalp::RenderUnit<_DstMesh>> output(units.size());
+
+        dal::parallel_for(units.size(), thread_count, [&](const size_t i) {
+            output[i].name_ = units[i].name_;
+            output[i].material_ = units[i].material_;
+            output[i].mesh_ = dalp::convert_to_indexed(units[i].mesh_);
+        });
+
+        return output;
+    }
+
 }  // namespace
 
 
@@ -422,6 +535,23 @@ namespace dal::parser {
     }
 
 
+    std::vector<RenderUnit<Mesh_Indexed>> convert_to_indexed(
+        const std::vector<RenderUnit<Mesh_Straight>>& units,
+        const uint32_t thread_count
+    ) {
+        return ::convert_units_to_indexed<Mesh_Indexed>(units, thread_count);
+    }
+
+    std::vector<RenderUnit<Mesh_IndexedJoint>> convert_to_indexed(
+        const std::vector<RenderUnit<Mesh_StraightJoint>>& units,
+        const uint32_t thread_count
+    ) {
+        return ::convert_units_to_indexed<Mesh_IndexedJoint>(
+            units, thread_count
+        );
+    }
+
+
     std::vector<RenderUnit<Mesh_Straight>> merge_by_material(
         const std::vector<RenderUnit<Mesh_Straight>>& units
     ) {
@@ -447,6 +577,31 @@ namespace dal::parser {
     }
 
 
+    std::vector<RenderUnit<Mesh_Straight>> merge_by_material(
+        std::vector<RenderUnit<Mesh_Straight>>&& units
+    ) {
+        return ::merge_by_material(std::move(units));
+    }
+
+    std::vector<RenderUnit<Mesh_StraightJoint>> merge_by_material(
+        std::vector<RenderUnit<Mesh_StraightJoint>>&& units
+    ) {
+        return ::merge_by_material(std::move(units));
+    }
+
+    std::vector<RenderUnit<Mesh_Indexed>> merge_by_material(
+        std::vector<RenderUnit<Mesh_Indexed>>&& units
+    ) {
+        return ::merge_by_material(std::move(units));
+    }
+
+    std::vector<RenderUnit<Mesh_IndexedJoint>> merge_by_material(
+        std::vector<RenderUnit<Mesh_IndexedJoint>>&& units
+    ) {
+        return ::merge_by_material(std::move(units));
+    }
+
+
     JointReductionResult reduce_joints(dalp::Model& model) {
         if (model.animations_.empty())
             return JointReductionResult::needless;
@@ -0,0 +1,1561 @@
+#include "daltools/scene/modifier.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "daltools/common/quantize.h"
+#include "daltools/common/util.h"
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+    #include <xmmintrin.h>
+    #define DAL_BOUNDS_SSE
+#endif
+
+
+namespace {
+
+    namespace dalp = dal::parser;
+
+    using index_t = uint32_t;
+
+}  // namespace
+
+
+// Vertex cache optimization
+namespace {
+
+    // Tom Forsyth, "Linear-Speed Vertex Cache Optimisation" (2006)
+    class ForsythOptimizer {
+
+    public:
+        static constexpr int CACHE_SIZE = dalp::VERTEX_CACHE_SIZE;
+
+        void run(std::vector<index_t>& indices, const size_t vertex_count) {
+            const auto tri_count = indices.size() / 3;
+            if (tri_count < 2)
+                return;
+
+            this->build_adjacency(indices, vertex_count);
+
+            scores_.resize(vertex_count);
+            for (size_t v = 0; v < vertex_count; ++v)
+                scores_[v] = this->vertex_score(v);
+
+            std::vector<index_t> output;
+            output.reserve(tri_count * 3);
+            emitted_.assign(tri_count, false);
+            cache_.clear();
+
+            size_t scan_cursor = 0;
+            auto best_tri = this->find_best_unemitted(scan_cursor);
+
+            while (best_tri < tri_count) {
+                emitted_[best_tri] = true;
+                for (int c = 0; c < 3; ++c) {
+                    const auto v = indices[3 * best_tri + c];
+                    output.push_back(v);
+                    this->remove_adjacency(v, best_tri);
+                }
+
+                this->update_cache(&indices[3 * best_tri]);
+                best_tri = this->best_in_cache(indices);
+                if (best_tri >= tri_count)
+                    best_tri = this->find_best_unemitted(scan_cursor);
+            }
+
+            indices.swap(output);
+        }
+
+    private:
+        static float cache_score(const int position) {
+            constexpr float CACHE_DECAY_POWER = 1.5f;
+            constexpr float LAST_TRI_SCORE = 0.75f;
+
+            if (position < 0)
+                return 0;
+            if (position < 3)
+                return LAST_TRI_SCORE;
+
+            const float scaler = 1.f / (CACHE_SIZE - 3);
+            const float score = 1.f - (position - 3) * scaler;
+            return std::pow(score, CACHE_DECAY_POWER);
+        }
+
+        float vertex_score(const size_t v) const {
+            constexpr float VALENCE_BOOST_SCALE = 2.f;
+            constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+            const auto remaining = adj_count_[v];
+            if (0 == remaining)
+                return -1;
+
+            const auto boost = std::pow(
+                static_cast<float>(remaining), -VALENCE_BOOST_POWER
+            );
+            return cache_score(cache_pos_[v]) + VALENCE_BOOST_SCALE * boost;
+        }
+
+        void build_adjacency(
+            const std::vector<index_t>& indices, const size_t vertex_count
+        ) {
+            adj_count_.assign(vertex_count, 0);
+            for (const auto v : indices) ++adj_count_[v];
+
+            adj_offset_.resize(vertex_count + 1);
+            adj_offset_[0] = 0;
+            for (size_t v = 0; v < vertex_count; ++v)
+                adj_offset_[v + 1] = adj_offset_[v] + adj_count_[v];
+
+            adj_tris_.resize(indices.size());
+            std::vector<uint32_t> fill(vertex_count, 0);
+            for (size_t i = 0; i < indices.size(); ++i) {
+                const auto v = indices[i];
+                adj_tris_[adj_offset_[v] + fill[v]++] = i / 3;
+            }
+
+            cache_pos_.assign(vertex_count, -1);
+        }
+
+        void remove_adjacency(const index_t v, const size_t tri) {
+            const auto begin = adj_tris_.begin() + adj_offset_[v];
+            const auto end = begin + adj_count_[v];
+            const auto found = std::find(begin, end, tri);
+            if (found == end)
+                return;
+
+            std::iter_swap(found, end - 1);
+            --adj_count_[v];
+        }
+
+        void update_cache(const index_t* const tri) {
+            std::vector<index_t> new_cache{ tri[0], tri[1], tri[2] };
+            for (const auto v : cache_) {
+                if (v != tri[0] && v != tri[1] && v != tri[2])
+                    new_cache.push_back(v);
+            }
+
+            // Evicted vertices also need their scores refreshed
+            for (size_t i = 0; i < new_cache.size(); ++i) {
+                const auto v = new_cache[i];
+                cache_pos_[v] = i < CACHE_SIZE ? static_cast<int>(i) : -1;
+            }
+
+            touched_ = new_cache;
+            if (new_cache.size() > CACHE_SIZE)
+                new_cache.resize(CACHE_SIZE);
+            cache_.swap(new_cache);
+        }
+
+        size_t best_in_cache(const std::vector<index_t>& indices) {
+            for (const auto v : touched_) {
+                scores_[v] = this->vertex_score(v);
+            }
+
+            size_t best_tri = emitted_.size();
+            float best_score = -1;
+
+            for (const auto v : touched_) {
+                const auto begin = adj_offset_[v];
+                const auto end = begin + adj_count_[v];
+
+                for (auto i = begin; i < end; ++i) {
+                    const auto t = adj_tris_[i];
+                    const auto score = scores_[indices[3 * t + 0]] +
+                                       scores_[indices[3 * t + 1]] +
+                                       scores_[indices[3 * t + 2]];
+
+                    if (score > best_score ||
+                        (score == best_score && t < best_tri)) {
+                        best_score = score;
+                        best_tri = t;
+                    }
+                }
+            }
+
+            return best_tri;
+        }
+
+        // Used when the cache holds no vertex with remaining triangles.
+        // Picking the first remaining triangle keeps this linear overall.
+        size_t find_best_unemitted(size_t& cursor) const {
+            while (cursor < emitted_.size() && emitted_[cursor]) ++cursor;
+            return cursor;
+        }
+
+        std::vector<uint32_t> adj_count_, adj_offset_, adj_tris_;
+        std::vector<int> cache_pos_;
+        std::vector<float> scores_;
+        std::vector<bool> emitted_;
+        std::vector<index_t> cache_, touched_;
+    };
+
+
+    template <typename _Mesh>
+    void optimize_units_vertex_cache(
+        std::vector<dalp::RenderUnit<_Mesh>>& units,
+        std::vector<dalp::VertexCacheStats>& before,
+        std::vector<dalp::VertexCacheStats>& after,
+        const uint32_t thread_count
+    ) {
+        const auto offset = before.size();
+        before.resize(offset + units.size());
+        after.resize(offset + units.size());
+
+        dal::parallel_for(units.size(), thread_count, [&](const size_t i) {
+            auto& mesh = units[i].mesh_;
+            const auto vertex_count = mesh.vertices_.size();
+
+            before[offset + i] = dalp::analyze_vertex_cache(
+                mesh.indices_, vertex_count
+            );
+            dalp::optimize_vertex_cache(mesh.indices_, vertex_count);
+            after[offset + i] = dalp::analyze_vertex_cache(
+                mesh.indices_, vertex_count
+            );
+        });
+    }
+
+    dalp::VertexCacheStats sum_stats(
+        const std::vector<dalp::VertexCacheStats>& v
+    ) {
+        dalp::VertexCacheStats output;
+        for (auto& x : v) {
+            output.triangle_count_ += x.triangle_count_;
+            output.vertex_count_ += x.vertex_count_;
+            output.transform_count_ += x.transform_count_;
+        }
+        return output;
+    }
+
+}  // namespace
+
+
+// Mesh cleanup
+namespace {
+
+    template <typename _Vertex>
+    size_t remove_degenerate_triangles(dalp::TMesh_Indexed<_Vertex>& mesh) {
+        auto& indices = mesh.indices_;
+        const auto& vertices = mesh.vertices_;
+        const auto tri_count = indices.size() / 3;
+
+        size_t kept = 0;
+        for (size_t t = 0; t < tri_count; ++t) {
+            const auto i0 = indices[3 * t + 0];
+            const auto i1 = indices[3 * t + 1];
+            const auto i2 = indices[3 * t + 2];
+            if (i0 == i1 || i1 == i2 || i2 == i0)
+                continue;
+
+            // Exactly zero, which is what welding leaves behind
+            const auto& p0 = vertices[i0].pos_;
+            const auto edge_cross = glm::cross(
+                vertices[i1].pos_ - p0, vertices[i2].pos_ - p0
+            );
+            if (glm::dot(edge_cross, edge_cross) == 0.f)
+                continue;
+
+            indices[3 * kept + 0] = i0;
+            indices[3 * kept + 1] = i1;
+            indices[3 * kept + 2] = i2;
+            ++kept;
+        }
+
+        indices.resize(3 * kept);
+        return tri_count - kept;
+    }
+
+    template <typename _Vertex>
+    size_t optimize_vertex_fetch(dalp::TMesh_Indexed<_Vertex>& mesh) {
+        constexpr auto NOT_YET = std::numeric_limits<index_t>::max();
+
+        std::vector<index_t> remap(mesh.vertices_.size(), NOT_YET);
+        std::vector<_Vertex> vertices;
+        vertices.reserve(mesh.vertices_.size());
+
+        const auto remap_indices = [&](std::vector<index_t>& indices) {
+            for (auto& index : indices) {
+                auto& new_index = remap[index];
+                if (NOT_YET == new_index) {
+                    new_index = static_cast<index_t>(vertices.size());
+                    vertices.push_back(mesh.vertices_[index]);
+                }
+                index = new_index;
+            }
+        };
+
+        // LODs and meshlets only use a subset of the full level vertices
+        remap_indices(mesh.indices_);
+        for (auto& lod : mesh.lods_) remap_indices(lod.indices_);
+        remap_indices(mesh.meshlets_.vertices_);
+
+        const auto removed = mesh.vertices_.size() - vertices.size();
+        mesh.vertices_.swap(vertices);
+        return removed;
+    }
+
+    template <typename _Mesh>
+    void cleanup_units(
+        std::vector<dalp::RenderUnit<_Mesh>>& units,
+        std::vector<dalp::MeshCleanupReport>& reports,
+        const uint32_t thread_count
+    ) {
+        const auto offset = reports.size();
+        reports.resize(offset + units.size());
+
+        dal::parallel_for(units.size(), thread_count, [&](const size_t i) {
+            auto& mesh = units[i].mesh_;
+            auto& report = reports[offset + i];
+
+            report.degenerate_triangles_ = ::remove_degenerate_triangles(mesh);
+            report.duplicate_triangles_ = dalp::remove_duplicate_triangles(
+                mesh.indices_
+            );
+            report.unused_vertices_ = ::optimize_vertex_fetch(mesh);
+        });
+    }
+
+}  // namespace
+
+
+// Simplification
+namespace {
+
+    // Sum of squared distances to planes, p^T A p + 2 b^T p + c
+    class Quadric {
+
+    public:
+        void add_plane(const glm::dvec3& n, const double d, const double w) {
+            a00_ += w * n.x * n.x;
+            a01_ += w * n.x * n.y;
+            a02_ += w * n.x * n.z;
+            a11_ += w * n.y * n.y;
+            a12_ += w * n.y * n.z;
+            a22_ += w * n.z * n.z;
+            b0_ += w * n.x * d;
+            b1_ += w * n.y * d;
+            b2_ += w * n.z * d;
+            c_ += w * d * d;
+        }
+
+        Quadric& operator+=(const Quadric& other) {
+            a00_ += other.a00_;
+            a01_ += other.a01_;
+            a02_ += other.a02_;
+            a11_ += other.a11_;
+            a12_ += other.a12_;
+            a22_ += other.a22_;
+            b0_ += other.b0_;
+            b1_ += other.b1_;
+            b2_ += other.b2_;
+            c_ += other.c_;
+            return *this;
+        }
+
+        double eval(const glm::vec3& p) const {
+            const double x = p.x, y = p.y, z = p.z;
+            const auto quad = a00_ * x * x + a11_ * y * y + a22_ * z * z +
+                              2 * (a01_ * x * y + a02_ * x * z + a12_ * y * z);
+            const auto lin = 2 * (b0_ * x + b1_ * y + b2_ * z);
+            // Rounding can make it slightly negative
+            return std::max(0.0, quad + lin + c_);
+        }
+
+    private:
+        double a00_ = 0, a01_ = 0, a02_ = 0, a11_ = 0, a12_ = 0, a22_ = 0;
+        double b0_ = 0, b1_ = 0, b2_ = 0;
+        double c_ = 0;
+    };
+
+
+    template <typename _Vertex>
+    float surface_distance2(const _Vertex& a, const _Vertex& b) {
+        const auto normal = a.normal_ - b.normal_;
+        const auto uv = a.uv_ - b.uv_;
+        return glm::dot(normal, normal) + glm::dot(uv, uv);
+    }
+
+    float attribute_distance2(const dalp::Vertex& a, const dalp::Vertex& b) {
+        return ::surface_distance2(a, b);
+    }
+
+    // Weights are compared per joint, regardless of the slot they are in
+    float attribute_distance2(
+        const dalp::VertexJoint& a, const dalp::VertexJoint& b
+    ) {
+        constexpr auto J = dalp::NUM_JOINTS_PER_VERTEX;
+
+        const auto weight_of = [](const dalp::VertexJoint& v, const int joint) {
+            float output = 0;
+            for (int i = 0; i < J; ++i) {
+                if (v.joint_indices_[i] == joint)
+                    output += v.joint_weights_[i];
+            }
+            return output;
+        };
+
+        std::array<int32_t, 2 * J> joints;
+        for (int i = 0; i < J; ++i) {
+            joints[i] = a.joint_indices_[i];
+            joints[J + i] = b.joint_indices_[i];
+        }
+
+        float skin = 0;
+        for (auto it = joints.begin(); it != joints.end(); ++it) {
+            if (std::find(joints.begin(), it, *it) != it)
+                continue;
+
+            const auto diff = weight_of(a, *it) - weight_of(b, *it);
+            skin += diff * diff;
+        }
+
+        return ::surface_distance2(a, b) + skin;
+    }
+
+
+    // Garland-Heckbert edge collapses onto existing vertices, so levels can
+    // share the vertex buffer. Vertices on borders and on attribute seams
+    // (position shared by several vertices) never move, which keeps UV
+    // charts, hard normals and skin weight boundaries intact.
+    template <typename _Vertex>
+    class MeshSimplifier {
+
+    public:
+        explicit MeshSimplifier(const dalp::TMesh_Indexed<_Vertex>& mesh)
+            : vertices_(mesh.vertices_), indices_(mesh.indices_) {
+            this->find_locked_vertices();
+            this->build_quadrics();
+        }
+
+        dalp::MeshLod run(size_t target_tri_count, float max_error) {
+            dalp::MeshLod output;
+            output.indices_ = indices_;
+
+            auto quadrics = quadrics_;
+            const auto max_cost = static_cast<double>(max_error) * extent_ *
+                                  max_error * extent_;
+            double reached_cost = 0;
+
+            const auto vert_count = vertices_.size();
+            std::vector<index_t> collapse_to(vert_count);
+            std::vector<bool> touched(vert_count);
+
+            while (output.indices_.size() / 3 > target_tri_count) {
+                auto& indices = output.indices_;
+                const auto tri_count = indices.size() / 3;
+                const auto needed = tri_count - target_tri_count;
+
+                this->build_adjacency(indices);
+                this->collect_candidates(indices, quadrics);
+
+                for (index_t i = 0; i < vert_count; ++i) collapse_to[i] = i;
+                std::fill(touched.begin(), touched.end(), false);
+                size_t removed = 0;
+
+                // Each collapse freezes its neighbourhood for this pass so
+                // the flip test always sees up to date triangles
+                for (auto& c : candidates_) {
+                    if (c.cost_ > max_cost)
+                        break;
+                    if (c.from_ == c.to_)
+                        continue;
+                    if (touched[c.from_] || touched[c.to_])
+                        continue;
+                    if (this->would_flip(c.from_, c.to_, indices))
+                        continue;
+
+                    collapse_to[c.from_] = c.to_;
+                    quadrics[c.to_] += quadrics[c.from_];
+                    reached_cost = std::max(reached_cost, c.cost_);
+
+                    for (auto t : this->triangles_of(c.from_)) {
+                        bool has_to = false;
+                        for (int k = 0; k < 3; ++k) {
+                            touched[indices[3 * t + k]] = true;
+                            has_to |= indices[3 * t + k] == c.to_;
+                        }
+                        if (has_to)
+                            ++removed;
+                    }
+
+                    if (removed >= needed)
+                        break;
+                }
+
+                if (0 == removed)
+                    break;
+
+                size_t kept = 0;
+                for (size_t t = 0; t < tri_count; ++t) {
+                    const auto i0 = collapse_to[indices[3 * t + 0]];
+                    const auto i1 = collapse_to[indices[3 * t + 1]];
+                    const auto i2 = collapse_to[indices[3 * t + 2]];
+                    if (i0 == i1 || i1 == i2 || i2 == i0)
+                        continue;
+
+                    indices[3 * kept + 0] = i0;
+                    indices[3 * kept + 1] = i1;
+                    indices[3 * kept + 2] = i2;
+                    ++kept;
+                }
+                indices.resize(3 * kept);
+            }
+
+            output.error_ = static_cast<float>(
+                std::sqrt(reached_cost) / extent_
+            );
+            return output;
+        }
+
+    private:
+        struct Collapse {
+            double cost_;
+            index_t from_;
+            index_t to_;
+
+            bool operator<(const Collapse& other) const {
+                if (cost_ != other.cost_)
+                    return cost_ < other.cost_;
+                if (from_ != other.from_)
+                    return from_ < other.from_;
+                return to_ < other.to_;
+            }
+        };
+
+        struct Span {
+            const index_t* begin_;
+            const index_t* end_;
+
+            const index_t* begin() const { return begin_; }
+            const index_t* end() const { return end_; }
+        };
+
+        // Attribute differences are scaled by the edge length squared so
+        // they are in the same unit as the quadric error
+        static constexpr double ATTRIBUTE_WEIGHT = 1;
+        static constexpr float MAX_NORMAL_CHANGE_COS = 0.25f;
+
+        void find_locked_vertices() {
+            const auto vert_count = vertices_.size();
+            locked_.assign(vert_count, false);
+
+            // Seams, found by sorting vertices by position
+            std::vector<index_t> order(vert_count);
+            for (index_t i = 0; i < vert_count; ++i) order[i] = i;
+
+            const auto pos_less = [this](index_t a, index_t b) {
+                const auto& pa = vertices_[a].pos_;
+                const auto& pb = vertices_[b].pos_;
+                if (pa.x != pb.x)
+                    return pa.x < pb.x;
+                if (pa.y != pb.y)
+                    return pa.y < pb.y;
+                return pa.z < pb.z;
+            };
+            std::sort(order.begin(), order.end(), pos_less);
+
+            for (size_t i = 1; i < order.size(); ++i) {
+                const auto a = order[i - 1];
+                const auto b = order[i];
+                if (!pos_less(a, b) && !pos_less(b, a)) {
+                    locked_[a] = true;
+                    locked_[b] = true;
+                }
+            }
+
+            // Borders, which are edges used by a single triangle
+            std::vector<uint64_t> edges;
+            edges.reserve(indices_.size());
+            for (size_t t = 0; t < indices_.size() / 3; ++t) {
+                for (int k = 0; k < 3; ++k) {
+                    const uint64_t a = indices_[3 * t + k];
+                    const uint64_t b = indices_[3 * t + (k + 1) % 3];
+                    edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+
+            for (size_t i = 0; i < edges.size();) {
+                size_t j = i + 1;
+                while (j < edges.size() && edges[j] == edges[i]) ++j;
+                if (j - i == 1) {
+                    locked_[edges[i] >> 32] = true;
+                    locked_[edges[i] & 0xFFFFFFFF] = true;
+                }
+                i = j;
+            }
+        }
+
+        void build_quadrics() {
+            quadrics_.assign(vertices_.size(), Quadric{});
+
+            glm::vec3 min_pos{ std::numeric_limits<float>::max() };
+            glm::vec3 max_pos{ std::numeric_limits<float>::lowest() };
+            for (auto& v : vertices_) {
+                min_pos = glm::min(min_pos, v.pos_);
+                max_pos = glm::max(max_pos, v.pos_);
+            }
+            extent_ = vertices_.empty() ? 0 : glm::distance(min_pos, max_pos);
+            if (extent_ <= 0)
+                extent_ = 1;
+
+            for (size_t t = 0; t < indices_.size() / 3; ++t) {
+                const auto i0 = indices_[3 * t + 0];
+                const auto i1 = indices_[3 * t + 1];
+                const auto i2 = indices_[3 * t + 2];
+
+                const glm::dvec3 p0{ vertices_[i0].pos_ };
+                const glm::dvec3 p1{ vertices_[i1].pos_ };
+                const glm::dvec3 p2{ vertices_[i2].pos_ };
+                const auto normal = glm::cross(p1 - p0, p2 - p0);
+                const auto double_area = glm::length(normal);
+                if (double_area <= 0)
+                    continue;
+
+                // Area weighted so small slivers don't dominate
+                const auto n = normal / double_area;
+                const auto d = -glm::dot(n, p0);
+                Quadric q;
+                q.add_plane(n, d, double_area * 0.5);
+
+                quadrics_[i0] += q;
+                quadrics_[i1] += q;
+                quadrics_[i2] += q;
+            }
+        }
+
+        void build_adjacency(const std::vector<index_t>& indices) {
+            const auto vert_count = vertices_.size();
+            adj_offset_.assign(vert_count + 1, 0);
+            for (const auto v : indices) ++adj_offset_[v + 1];
+            for (size_t v = 0; v < vert_count; ++v)
+                adj_offset_[v + 1] += adj_offset_[v];
+
+            adj_tris_.resize(indices.size());
+            adj_fill_.assign(adj_offset_.begin(), adj_offset_.end() - 1);
+            for (size_t i = 0; i < indices.size(); ++i)
+                adj_tris_[adj_fill_[indices[i]]++] = i / 3;
+        }
+
+        Span triangles_of(const index_t v) const {
+            return Span{ adj_tris_.data() + adj_offset_[v],
+                         adj_tris_.data() + adj_offset_[v + 1] };
+        }
+
+        void collect_candidates(
+            const std::vector<index_t>& indices,
+            const std::vector<Quadric>& quadrics
+        ) {
+            candidates_.clear();
+
+            const auto push = [&](const index_t from, const index_t to) {
+                if (locked_[from])
+                    return;
+
+                const auto& pf = vertices_[from].pos_;
+                const auto& pt = vertices_[to].pos_;
+                const auto edge = pf - pt;
+                const auto attrib = ::attribute_distance2(
+                    vertices_[from], vertices_[to]
+                );
+
+                auto q = quadrics[from];
+                q += quadrics[to];
+                const auto cost = q.eval(pt) + ATTRIBUTE_WEIGHT *
+                                                   glm::dot(edge, edge) *
+                                                   attrib;
+                candidates_.push_back(Collapse{ cost, from, to });
+            };
+
+            for (size_t t = 0; t < indices.size() / 3; ++t) {
+                for (int k = 0; k < 3; ++k) {
+                    const auto a = indices[3 * t + k];
+                    const auto b = indices[3 * t + (k + 1) % 3];
+                    push(a, b);
+                    push(b, a);
+                }
+            }
+
+            std::sort(candidates_.begin(), candidates_.end());
+        }
+
+        bool would_flip(
+            const index_t from,
+            const index_t to,
+            const std::vector<index_t>& indices
+        ) const {
+            for (auto t : this->triangles_of(from)) {
+                const index_t* const tri = &indices[3 * t];
+                if (tri[0] == to || tri[1] == to || tri[2] == to)
+                    continue;
+
+                glm::vec3 before[3], after[3];
+                for (int k = 0; k < 3; ++k) {
+                    before[k] = vertices_[tri[k]].pos_;
+                    after[k] = tri[k] == from ? vertices_[to].pos_ : before[k];
+                }
+
+                const auto n0 = glm::cross(
+                    before[1] - before[0], before[2] - before[0]
+                );
+                const auto n1 = glm::cross(
+                    after[1] - after[0], after[2] - after[0]
+                );
+                // Also rejects triangles folding to near perpendicular
+                const auto limit = MAX_NORMAL_CHANGE_COS * glm::length(n0) *
+                                   glm::length(n1);
+                if (glm::dot(n0, n1) <= limit)
+                    return true;
+            }
+
+            return false;
+        }
+
+        const std::vector<_Vertex>& vertices_;
+        const std::vector<index_t>& indices_;
+        std::vector<bool> locked_;
+        std::vector<Quadric> quadrics_;
+        double extent_ = 1;
+
+        std::vector<uint32_t> adj_offset_, adj_fill_, adj_tris_;
+        std::vector<Collapse> candidates_;
+    };
+
+
+    template <typename _Vertex>
+    void generate_mesh_lods(
+        dalp::TMesh_Indexed<_Vertex>& mesh, const dalp::LodOptions& options
+    ) {
+        mesh.lods_.clear();
+
+        ::MeshSimplifier<_Vertex> simplifier{ mesh };
+        auto prev_tri_count = mesh.indices_.size() / 3;
+
+        for (const auto ratio : options.ratios_) {
+            const auto target = static_cast<size_t>(
+                mesh.indices_.size() / 3 * static_cast<double>(ratio)
+            );
+            auto lod = simplifier.run(target, options.max_error_);
+
+            // Stuck on locked vertices or the error limit
+            const auto tri_count = lod.indices_.size() / 3;
+            if (0 == tri_count || tri_count >= prev_tri_count)
+                break;
+
+            dalp::optimize_vertex_cache(lod.indices_, mesh.vertices_.size());
+            mesh.lods_.push_back(std::move(lod));
+            prev_tri_count = tri_count;
+        }
+    }
+
+    template <typename _Mesh>
+    void generate_units_lods(
+        std::vector<dalp::RenderUnit<_Mesh>>& units,
+        const dalp::LodOptions& options,
+        const uint32_t thread_count
+    ) {
+        dal::parallel_for(units.size(), thread_count, [&](const size_t i) {
+            ::generate_mesh_lods(units[i].mesh_, options);
+        });
+    }
+
+}  // namespace
+
+
+// Meshlets
+namespace {
+
+    template <typename _Vertex>
+    void compute_meshlet_bounds(
+        dalp::Meshlet& meshlet,
+        const dalp::MeshletSet& set,
+        const std::vector<_Vertex>& vertices
+    ) {
+        const auto vert_at = [&](const uint32_t local) -> const glm::vec3& {
+            const auto index = set.vertices_[meshlet.vertex_offset_ + local];
+            return vertices[index].pos_;
+        };
+
+        // Sphere around the AABB center, not minimal but cheap
+        glm::vec3 min_pos = vert_at(0), max_pos = vert_at(0);
+        for (uint32_t i = 1; i < meshlet.vertex_count_; ++i) {
+            min_pos = glm::min(min_pos, vert_at(i));
+            max_pos = glm::max(max_pos, vert_at(i));
+        }
+        meshlet.center_ = (min_pos + max_pos) * 0.5f;
+        meshlet.radius_ = 0;
+        for (uint32_t i = 0; i < meshlet.vertex_count_; ++i) {
+            meshlet.radius_ = std::max(
+                meshlet.radius_, glm::distance(meshlet.center_, vert_at(i))
+            );
+        }
+
+        // Normal cone, same formulation as meshoptimizer
+        std::vector<std::pair<glm::vec3, glm::vec3>> tris;  // Normal, corner
+        glm::vec3 normal_sum{ 0 };
+        for (uint32_t t = 0; t < meshlet.triangle_count_; ++t) {
+            const auto tri = &set.triangles_[meshlet.triangle_offset_ + 3 * t];
+            const auto& p0 = vert_at(tri[0]);
+            const auto n = glm::cross(
+                vert_at(tri[1]) - p0, vert_at(tri[2]) - p0
+            );
+            const auto len = glm::length(n);
+            if (len <= 0)
+                continue;
+
+            tris.emplace_back(n / len, p0);
+            normal_sum = normal_sum + n / len;
+        }
+
+        meshlet.cone_apex_ = meshlet.center_;
+        meshlet.cone_axis_ = glm::vec3{ 0 };
+        meshlet.cone_cutoff_ = 1;
+
+        const auto axis_len = glm::length(normal_sum);
+        if (tris.empty() || axis_len <= 0)
+            return;
+        const auto axis = normal_sum / axis_len;
+
+        float min_dot = 1;
+        for (auto& [n, corner] : tris)
+            min_dot = std::min(min_dot, glm::dot(n, axis));
+
+        meshlet.cone_axis_ = axis;
+        // Wider than about 84 degrees can never be culled
+        if (min_dot <= 0.1f)
+            return;
+
+        float max_t = 0;
+        for (auto& [n, corner] : tris) {
+            const auto t = glm::dot(meshlet.center_ - corner, n) /
+                           glm::dot(axis, n);
+            max_t = std::max(max_t, t);
+        }
+
+        meshlet.cone_apex_ = meshlet.center_ - axis * max_t;
+        meshlet.cone_cutoff_ = std::sqrt(1 - min_dot * min_dot);
+    }
+
+
+    // Greedy. Grows the current meshlet with the adjacent triangle adding the
+    // fewest new vertices, and starts a new one when it is full.
+    template <typename _Vertex>
+    dalp::MeshletSet build_mesh_meshlets(
+        const dalp::TMesh_Indexed<_Vertex>& mesh,
+        const dalp::MeshletOptions& options
+    ) {
+        constexpr uint8_t NOT_IN = 0xFF;
+
+        if (options.max_vertices_ < 3 || options.max_vertices_ > NOT_IN)
+            throw std::invalid_argument{ "Meshlet max vertices out of range" };
+        if (0 == options.max_triangles_)
+            throw std::invalid_argument{ "Meshlet max triangles is zero" };
+
+        const auto& indices = mesh.indices_;
+        const auto tri_count = indices.size() / 3;
+        const auto vert_count = mesh.vertices_.size();
+
+        std::vector<uint32_t> adj_offset(vert_count + 1, 0);
+        for (const auto v : indices) ++adj_offset[v + 1];
+        for (size_t v = 0; v < vert_count; ++v)
+            adj_offset[v + 1] += adj_offset[v];
+        std::vector<uint32_t> adj_tris(indices.size());
+        {
+            std::vector<uint32_t> fill(adj_offset.begin(), adj_offset.end());
+            for (size_t i = 0; i < indices.size(); ++i)
+                adj_tris[fill[indices[i]]++] = i / 3;
+        }
+
+        dalp::MeshletSet output;
+        std::vector<uint8_t> local(vert_count, NOT_IN);
+        std::vector<bool> emitted(tri_count, false);
+        dalp::Meshlet current;
+
+        const auto new_vertex_count = [&](const size_t t) {
+            uint32_t count = 0;
+            for (int k = 0; k < 3; ++k) {
+                if (NOT_IN == local[indices[3 * t + k]])
+                    ++count;
+            }
+            return count;
+        };
+
+        const auto flush = [&]() {
+            if (0 == current.triangle_count_)
+                return;
+
+            for (uint32_t i = 0; i < current.vertex_count_; ++i)
+                local[output.vertices_[current.vertex_offset_ + i]] = NOT_IN;
+
+            ::compute_meshlet_bounds(current, output, mesh.vertices_);
+            output.meshlets_.push_back(current);
+
+            current = dalp::Meshlet{};
+            current.vertex_offset_ = output.vertices_.size();
+            current.triangle_offset_ = output.triangles_.size();
+        };
+
+        const auto append = [&](const size_t t) {
+            emitted[t] = true;
+            for (int k = 0; k < 3; ++k) {
+                const auto v = indices[3 * t + k];
+                if (NOT_IN == local[v]) {
+                    local[v] = static_cast<uint8_t>(current.vertex_count_++);
+                    output.vertices_.push_back(v);
+                }
+                output.triangles_.push_back(local[v]);
+            }
+            ++current.triangle_count_;
+        };
+
+        size_t cursor = 0;
+        for (size_t done = 0; done < tri_count; ++done) {
+            size_t best = tri_count;
+            uint32_t best_new = 4;
+
+            for (uint32_t i = 0; i < current.vertex_count_; ++i) {
+                const auto v = output.vertices_[current.vertex_offset_ + i];
+                for (auto a = adj_offset[v]; a < adj_offset[v + 1]; ++a) {
+                    const auto t = adj_tris[a];
+                    if (emitted[t])
+                        continue;
+                    const auto n = new_vertex_count(t);
+                    if (n < best_new || (n == best_new && t < best)) {
+                        best = t;
+                        best_new = n;
+                    }
+                }
+            }
+
+            if (best == tri_count) {
+                while (emitted[cursor]) ++cursor;
+                best = cursor;
+                best_new = new_vertex_count(best);
+            }
+
+            const auto full = current.triangle_count_ >= options.max_triangles_;
+            const auto overflow = current.vertex_count_ + best_new >
+                                  options.max_vertices_;
+            if (full || overflow)
+                flush();
+
+            append(best);
+        }
+
+        flush();
+        return output;
+    }
+
+    template <typename _Mesh>
+    void build_units_meshlets(
+        std::vector<dalp::RenderUnit<_Mesh>>& units,
+        const dalp::MeshletOptions& options,
+        const uint32_t thread_count
+    ) {
+        dal::parallel_for(units.size(), thread_count, [&](const size_t i) {
+            auto& mesh = units[i].mesh_;
+            mesh.meshlets_ = ::build_mesh_meshlets(mesh, options);
+        });
+    }
+
+}  // namespace
+
+
+// Unit splitting
+namespace {
+
+    template <typename _Vertex>
+    std::vector<dalp::TMesh_Indexed<_Vertex>> split_mesh(
+        const dalp::TMesh_Indexed<_Vertex>& mesh, const size_t max_vertices
+    ) {
+        constexpr auto NOT_YET = std::numeric_limits<index_t>::max();
+
+        std::vector<dalp::TMesh_Indexed<_Vertex>> output(1);
+        std::vector<index_t> remap(mesh.vertices_.size(), NOT_YET);
+        std::vector<index_t> used;
+
+        const auto& indices = mesh.indices_;
+        for (size_t t = 0; t < indices.size() / 3; ++t) {
+            const auto tri = &indices[3 * t];
+
+            size_t new_count = 0;
+            for (int k = 0; k < 3; ++k) {
+                const auto v = tri[k];
+                const auto repeated = (k > 0 && tri[0] == v) ||
+                                      (k > 1 && tri[1] == v);
+                if (NOT_YET == remap[v] && !repeated)
+                    ++new_count;
+            }
+
+            if (output.back().vertices_.size() + new_count > max_vertices) {
+                for (const auto v : used) remap[v] = NOT_YET;
+                used.clear();
+                output.emplace_back();
+            }
+
+            auto& part = output.back();
+            for (int k = 0; k < 3; ++k) {
+                const auto v = tri[k];
+                if (NOT_YET == remap[v]) {
+                    remap[v] = static_cast<index_t>(part.vertices_.size());
+                    part.vertices_.push_back(mesh.vertices_[v]);
+                    used.push_back(v);
+                }
+                part.indices_.push_back(remap[v]);
+            }
+        }
+
+        for (auto& part : output) part.vertex_format_ = mesh.vertex_format_;
+        return output;
+    }
+
+    template <typename _Mesh>
+    size_t split_units(
+        std::vector<dalp::RenderUnit<_Mesh>>& units, const size_t max_vertices
+    ) {
+        std::vector<dalp::RenderUnit<_Mesh>> output;
+        output.reserve(units.size());
+        size_t added = 0;
+
+        for (auto& unit : units) {
+            if (unit.mesh_.vertices_.size() <= max_vertices) {
+                output.push_back(std::move(unit));
+                continue;
+            }
+
+            auto parts = ::split_mesh(unit.mesh_, max_vertices);
+            for (size_t i = 0; i < parts.size(); ++i) {
+                auto& dst = output.emplace_back();
+                dst.name_ = unit.name_;
+                if (i > 0)
+                    dst.name_ += "#" + std::to_string(i);
+                dst.material_ = unit.material_;
+                dst.mesh_ = std::move(parts[i]);
+                dst.instances_ = unit.instances_;
+            }
+            added += parts.size() - 1;
+        }
+
+        units = std::move(output);
+        return added;
+    }
+
+}  // namespace
+
+
+// Skin formats
+namespace {
+
+    bool is_valid_influence(const dalp::VertexJoint& vert, const int i) {
+        return vert.joint_weights_[i] > 0 &&
+               vert.joint_indices_[i] != dalp::NULL_JID;
+    }
+
+    // Largest weight difference from the normalized weights after quantizing
+    // them to `max_value` steps
+    float calc_weight_error(
+        const dalp::VertexJoint& vert, const uint32_t max_value
+    ) {
+        float weights[dalp::NUM_JOINTS_PER_VERTEX];
+        size_t count = 0;
+        double sum = 0;
+        for (int i = 0; i < dalp::NUM_JOINTS_PER_VERTEX; ++i) {
+            if (!::is_valid_influence(vert, i))
+                continue;
+            weights[count++] = vert.joint_weights_[i];
+            sum += vert.joint_weights_[i];
+        }
+        if (0 == count)
+            return 0;
+
+        uint32_t quantized[dalp::NUM_JOINTS_PER_VERTEX];
+        dal::encode_unorm_weights(weights, count, max_value, quantized);
+
+        double error = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const auto decoded = static_cast<double>(quantized[i]) / max_value;
+            error = std::max(error, std::abs(weights[i] / sum - decoded));
+        }
+        return static_cast<float>(error);
+    }
+
+    void select_mesh_skin_format(
+        dalp::Mesh_IndexedJoint& mesh, const dalp::SkinFormatOptions& options
+    ) {
+        using Format = dalp::VertexFormat;
+
+        int influences = 1;
+        int32_t max_joint = 0;
+        float error_8 = 0;
+        float error_16 = 0;
+        for (auto& vert : mesh.vertices_) {
+            int count = 0;
+            for (int i = 0; i < dalp::NUM_JOINTS_PER_VERTEX; ++i) {
+                if (!::is_valid_influence(vert, i))
+                    continue;
+                ++count;
+                max_joint = std::max(max_joint, vert.joint_indices_[i]);
+            }
+            influences = std::max(influences, count);
+            error_8 = std::max(error_8, ::calc_weight_error(vert, 255));
+            error_16 = std::max(error_16, ::calc_weight_error(vert, 65535));
+        }
+
+        auto& format = mesh.vertex_format_;
+        format.influences_ = influences <= 2 ? influences : 4;
+
+        // The max value of each is reserved for `NULL_JID`
+        if (max_joint < 255)
+            format.joint_index_ = Format::JointIndex::uint8;
+        else if (max_joint < 65535)
+            format.joint_index_ = Format::JointIndex::uint16;
+        else
+            format.joint_index_ = Format::JointIndex::int32;
+
+        if (error_8 <= options.max_weight_error_)
+            format.joint_weight_ = Format::JointWeight::unorm8;
+        else if (error_16 <= options.max_weight_error_)
+            format.joint_weight_ = Format::JointWeight::unorm16;
+        else
+            format.joint_weight_ = Format::JointWeight::float32;
+    }
+
+}  // namespace
+
+
+// Bounds
+namespace {
+
+    // Vertices per task, so big units are split across threads
+    constexpr size_t BOUNDS_CHUNK_SIZE = 1 << 15;
+
+    // Positions of one mesh, `stride_` bytes apart
+    struct PositionSpan {
+        const uint8_t* first_ = nullptr;
+        size_t count_ = 0;
+        size_t stride_ = 0;
+
+        const float* at(const size_t i) const {
+            return reinterpret_cast<const float*>(first_ + i * stride_);
+        }
+    };
+
+    dalp::AABB3 calc_span_aabb(const ::PositionSpan& span) {
+        dalp::AABB3 output;
+        if (0 == span.count_)
+            return output;
+
+#ifdef DAL_BOUNDS_SSE
+        // 4 lanes are loaded, the last one is garbage from whatever follows
+        // the position. The last vertex is loaded separately since nothing
+        // may follow it.
+        const auto last = span.at(span.count_ - 1);
+        auto min = _mm_setr_ps(last[0], last[1], last[2], 0);
+        auto max = min;
+        for (size_t i = 0; i + 1 < span.count_; ++i) {
+            const auto v = _mm_loadu_ps(span.at(i));
+            min = _mm_min_ps(min, v);
+            max = _mm_max_ps(max, v);
+        }
+
+        float min_buf[4], max_buf[4];
+        _mm_storeu_ps(min_buf, min);
+        _mm_storeu_ps(max_buf, max);
+        output.min_ = glm::vec3(min_buf[0], min_buf[1], min_buf[2]);
+        output.max_ = glm::vec3(max_buf[0], max_buf[1], max_buf[2]);
+#else
+        const auto first = span.at(0);
+        output.min_ = output.max_ = glm::vec3(first[0], first[1], first[2]);
+        for (size_t i = 1; i < span.count_; ++i) {
+            const auto p = span.at(i);
+            const glm::vec3 v{ p[0], p[1], p[2] };
+            output.min_ = glm::min(output.min_, v);
+            output.max_ = glm::max(output.max_, v);
+        }
+#endif
+
+        return output;
+    }
+
+    float calc_span_radius2(
+        const ::PositionSpan& span, const glm::vec3& center
+    ) {
+        float output = 0;
+        for (size_t i = 0; i < span.count_; ++i) {
+            const auto p = span.at(i);
+            const auto d = glm::vec3(p[0], p[1], p[2]) - center;
+            output = std::max(output, glm::dot(d, d));
+        }
+        return output;
+    }
+
+    ::PositionSpan make_position_span(const dalp::Mesh_Straight& mesh) {
+        ::PositionSpan output;
+        output.first_ = reinterpret_cast<const uint8_t*>(mesh.vertices_.data());
+        output.count_ = mesh.vertices_.size() / 3;
+        output.stride_ = sizeof(float) * 3;
+        return output;
+    }
+
+    template <typename _Vertex>
+    ::PositionSpan make_position_span(
+        const dalp::TMesh_Indexed<_Vertex>& mesh
+    ) {
+        ::PositionSpan output;
+        if (mesh.vertices_.empty())
+            return output;
+
+        static_assert(sizeof(float) * 3 == sizeof(_Vertex::pos_));
+        output.first_ = reinterpret_cast<const uint8_t*>(
+            &mesh.vertices_.front().pos_
+        );
+        output.count_ = mesh.vertices_.size();
+        output.stride_ = sizeof(_Vertex);
+        return output;
+    }
+
+    // Bounds of every unit of a model, computed over (unit, chunk) tasks
+    class ModelBoundsBuilder {
+
+    public:
+        template <typename _Mesh>
+        void add_units(std::vector<dalp::RenderUnit<_Mesh>>& units) {
+            for (auto& unit : units) {
+                const auto span = ::make_position_span(unit.mesh_);
+                const auto unit_index = this->units_.size();
+                this->units_.push_back(
+                    { &unit.aabb_, &unit.sphere_, &unit.instances_ }
+                );
+
+                for (size_t i = 0; i < span.count_; i += BOUNDS_CHUNK_SIZE) {
+                    auto& task = this->tasks_.emplace_back();
+                    task.unit_ = unit_index;
+                    task.span_ = span;
+                    task.span_.first_ += i * span.stride_;
+                    task.span_.count_ = std::min(
+                        BOUNDS_CHUNK_SIZE, span.count_ - i
+                    );
+                }
+            }
+        }
+
+        dalp::AABB3 run(const uint32_t thread_count) {
+            auto& tasks = this->tasks_;
+            auto& units = this->units_;
+
+            dal::parallel_for(tasks.size(), thread_count, [&](size_t i) {
+                tasks[i].aabb_ = ::calc_span_aabb(tasks[i].span_);
+            });
+
+            std::vector<bool> started(units.size(), false);
+            for (auto& task : tasks) {
+                auto& dst = *units[task.unit_].aabb_;
+                if (started[task.unit_])
+                    dst.merge(task.aabb_);
+                else
+                    dst = task.aabb_;
+                started[task.unit_] = true;
+            }
+
+            dalp::AABB3 output;
+            bool has_any = false;
+            for (size_t i = 0; i < units.size(); ++i) {
+                auto& unit = units[i];
+                if (!started[i]) {
+                    *unit.aabb_ = dalp::AABB3{};
+                    *unit.sphere_ = dalp::BoundingSphere{};
+                    continue;
+                }
+
+                const auto& aabb = *unit.aabb_;
+                unit.sphere_->center_ = (aabb.min_ + aabb.max_) * 0.5f;
+
+                // Instanced meshes are in their own local space
+                for (auto& m : *unit.instances_) {
+                    const auto world = aabb.transform(m);
+                    if (has_any)
+                        output.merge(world);
+                    else
+                        output = world;
+                    has_any = true;
+                }
+                if (!unit.instances_->empty())
+                    continue;
+
+                if (has_any)
+                    output.merge(aabb);
+                else
+                    output = aabb;
+                has_any = true;
+            }
+
+            dal::parallel_for(tasks.size(), thread_count, [&](size_t i) {
+                auto& task = tasks[i];
+                const auto& center = units[task.unit_].sphere_->center_;
+                task.radius2_ = ::calc_span_radius2(task.span_, center);
+            });
+
+            std::vector<float> radius2(units.size(), 0);
+            for (auto& task : tasks) {
+                auto& dst = radius2[task.unit_];
+                dst = std::max(dst, task.radius2_);
+            }
+            for (size_t i = 0; i < units.size(); ++i)
+                units[i].sphere_->radius_ = std::sqrt(radius2[i]);
+
+            return output;
+        }
+
+    private:
+        struct Unit {
+            dalp::AABB3* aabb_;
+            dalp::BoundingSphere* sphere_;
+            const std::vector<glm::mat4>* instances_;
+        };
+
+        struct Task {
+            ::PositionSpan span_;
+            size_t unit_ = 0;
+            dalp::AABB3 aabb_;
+            float radius2_ = 0;
+        };
+
+        std::vector<Unit> units_;
+        std::vector<Task> tasks_;
+    };
+
+}  // namespace
+
+
+namespace dal::parser {
+
+    double VertexCacheStats::acmr() const {
+        if (0 == this->triangle_count_)
+            return 0;
+        return static_cast<double>(this->transform_count_) /
+               static_cast<double>(this->triangle_count_);
+    }
+
+    double VertexCacheStats::atvr() const {
+        if (0 == this->vertex_count_)
+            return 0;
+        return static_cast<double>(this->transform_count_) /
+               static_cast<double>(this->vertex_count_);
+    }
+
+    VertexCacheStats analyze_vertex_cache(
+        const std::vector<uint32_t>& indices,
+        const size_t vertex_count,
+        const uint32_t cache_size
+    ) {
+        VertexCacheStats output;
+        output.triangle_count_ = indices.size() / 3;
+
+        // FIFO, like most post-transform caches. Zero size misses every time.
+        std::vector<uint32_t> fifo(cache_size, UINT32_MAX);
+        std::vector<bool> used(vertex_count, false);
+        size_t head = 0;
+
+        for (const auto v : indices) {
+            if (!used[v]) {
+                used[v] = true;
+                ++output.vertex_count_;
+            }
+
+            if (std::find(fifo.begin(), fifo.end(), v) != fifo.end())
+                continue;
+
+            if (!fifo.empty()) {
+                fifo[head] = v;
+                head = (head + 1) % cache_size;
+            }
+            ++output.transform_count_;
+        }
+
+        return output;
+    }
+
+    void optimize_vertex_cache(
+        std::vector<uint32_t>& indices, const size_t vertex_count
+    ) {
+        ::ForsythOptimizer{}.run(indices, vertex_count);
+    }
+
+    VertexCacheReport optimize_vertex_cache(
+        Model& model, const uint32_t thread_count
+    ) {
+        std::vector<VertexCacheStats> before, after;
+
+        ::optimize_units_vertex_cache(
+            model.units_indexed_, before, after, thread_count
+        );
+        ::optimize_units_vertex_cache(
+            model.units_indexed_joint_, before, after, thread_count
+        );
+
+        VertexCacheReport output;
+        output.before_ = ::sum_stats(before);
+        output.after_ = ::sum_stats(after);
+        return output;
+    }
+
+
+    size_t remove_degenerate_triangles(Mesh_Indexed& mesh) {
+        return ::remove_degenerate_triangles(mesh);
+    }
+
+    size_t remove_degenerate_triangles(Mesh_IndexedJoint& mesh) {
+        return ::remove_degenerate_triangles(mesh);
+    }
+
+    size_t remove_duplicate_triangles(std::vector<uint32_t>& indices) {
+        using Triangle = std::array<index_t, 3>;
+        const auto tri_count = indices.size() / 3;
+
+        // Rotated so the smallest index comes first, winding is preserved
+        std::vector<std::pair<Triangle, size_t>> keys(tri_count);
+        for (size_t t = 0; t < tri_count; ++t) {
+            Triangle tri{ indices[3 * t + 0],
+                          indices[3 * t + 1],
+                          indices[3 * t + 2] };
+            const auto min_pos = std::min_element(tri.begin(), tri.end());
+            std::rotate(tri.begin(), min_pos, tri.end());
+            keys[t] = std::make_pair(tri, t);
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<bool> is_duplicate(tri_count, false);
+        for (size_t i = 1; i < keys.size(); ++i) {
+            if (keys[i].first == keys[i - 1].first)
+                is_duplicate[keys[i].second] = true;
+        }
+
+        size_t kept = 0;
+        for (size_t t = 0; t < tri_count; ++t) {
+            if (is_duplicate[t])
+                continue;
+            for (int c = 0; c < 3; ++c)
+                indices[3 * kept + c] = indices[3 * t + c];
+            ++kept;
+        }
+
+        indices.resize(3 * kept);
+        return tri_count - kept;
+    }
+
+    size_t optimize_vertex_fetch(Mesh_Indexed& mesh) {
+        return ::optimize_vertex_fetch(mesh);
+    }
+
+    size_t optimize_vertex_fetch(Mesh_IndexedJoint& mesh) {
+        return ::optimize_vertex_fetch(mesh);
+    }
+
+    MeshCleanupReport cleanup_meshes(
+        Model& model, const uint32_t thread_count
+    ) {
+        std::vector<MeshCleanupReport> reports;
+        ::cleanup_units(model.units_indexed_, reports, thread_count);
+        ::cleanup_units(model.units_indexed_joint_, reports, thread_count);
+
+        MeshCleanupReport output;
+        for (auto& x : reports) {
+            output.degenerate_triangles_ += x.degenerate_triangles_;
+            output.duplicate_triangles_ += x.duplicate_triangles_;
+            output.unused_vertices_ += x.unused_vertices_;
+        }
+        return output;
+    }
+
+
+    MeshLod simplify_mesh(
+        const Mesh_Indexed& mesh, const float ratio, const float max_error
+    ) {
+        const auto target = static_cast<size_t>(
+            mesh.indices_.size() / 3 * static_cast<double>(ratio)
+        );
+        return ::MeshSimplifier<Vertex>{ mesh }.run(target, max_error);
+    }
+
+    MeshLod simplify_mesh(
+        const Mesh_IndexedJoint& mesh, const float ratio, const float max_error
+    ) {
+        const auto target = static_cast<size_t>(
+            mesh.indices_.size() / 3 * static_cast<double>(ratio)
+        );
+        return ::MeshSimplifier<VertexJoint>{ mesh }.run(target, max_error);
+    }
+
+    void generate_lods(
+        Model& model, const LodOptions& options, const uint32_t thread_count
+    ) {
+        ::generate_units_lods(model.units_indexed_, options, thread_count);
+        ::generate_units_lods(
+            model.units_indexed_joint_, options, thread_count
+        );
+    }
+
+
+    MeshletSet build_meshlets(
+        const Mesh_Indexed& mesh, const MeshletOptions& options
+    ) {
+        return ::build_mesh_meshlets(mesh, options);
+    }
+
+    MeshletSet build_meshlets(
+        const Mesh_IndexedJoint& mesh, const MeshletOptions& options
+    ) {
+        return ::build_mesh_meshlets(mesh, options);
+    }
+
+    void build_meshlets(
+        Model& model, const MeshletOptions& options, const uint32_t thread_count
+    ) {
+        ::build_units_meshlets(model.units_indexed_, options, thread_count);
+        ::build_units_meshlets(
+            model.units_indexed_joint_, options, thread_count
+        );
+    }
+
+
+    size_t split_large_units(Model& model, const size_t max_vertices) {
+        if (max_vertices < 3)
+            throw std::invalid_argument{ "Max vertices must be at least 3" };
+
+        return ::split_units(model.units_indexed_, max_vertices) +
+               ::split_units(model.units_indexed_joint_, max_vertices);
+    }
+
+
+    void select_skin_format(
+        Mesh_IndexedJoint& mesh, const SkinFormatOptions& options
+    ) {
+        ::select_mesh_skin_format(mesh, options);
+    }
+
+    void select_skin_format(
+        Model& model,
+        const SkinFormatOptions& options,
+        const uint32_t thread_count
+    ) {
+        auto& units = model.units_indexed_joint_;
+        dal::parallel_for(units.size(), thread_count, [&](const size_t i) {
+            ::select_mesh_skin_format(units[i].mesh_, options);
+        });
+    }
+
+
+    void compute_bounds(Model& model, const uint32_t thread_count) {
+        ::ModelBoundsBuilder builder;
+        builder.add_units(model.units_straight_);
+        builder.add_units(model.units_straight_joint_);
+        builder.add_units(model.units_indexed_);
+        builder.add_units(model.units_indexed_joint_);
+        model.aabb_ = builder.run(thread_count);
+    }
+
+}  // namespace dal::parser
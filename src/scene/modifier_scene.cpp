@@ -1,7 +1,12 @@
 #include "daltools/scene/modifier.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <stdexcept>
 #include <unordered_map>
 #include <unordered_set>
@@ -10,6 +15,7 @@
 #include <sung/basic/geometry2d.hpp>
 
 #include "daltools/common/glm_tool.hpp"
+#include "daltools/common/util.h"
 #include "daltools/img/backend/ktx.hpp"
 #include "daltools/img/img.hpp"
 #include "daltools/img/img2d.hpp"
@@ -130,6 +136,164 @@ namespace {
 }  // namespace
 
 
+// Batching
+namespace {
+
+    constexpr int KMEANS_MAX_ITERATIONS = 32;
+
+    using CellKey = std::array<int32_t, 3>;
+
+    // Lloyd's algorithm seeded by farthest point sampling, so the result
+    // only depends on the input order
+    std::vector<int32_t> cluster_kmeans(
+        const std::vector<glm::vec3>& points, const uint32_t cluster_count
+    ) {
+        std::vector<int32_t> labels(points.size(), 0);
+        const auto k = std::min<size_t>(cluster_count, points.size());
+        if (k <= 1)
+            return labels;
+
+        std::vector<glm::vec3> centers{ points[0] };
+        std::vector<float> dist2(
+            points.size(), std::numeric_limits<float>::infinity()
+        );
+        while (centers.size() < k) {
+            size_t farthest = 0;
+            for (size_t i = 0; i < points.size(); ++i) {
+                const auto d = points[i] - centers.back();
+                dist2[i] = std::min(dist2[i], glm::dot(d, d));
+                if (dist2[i] > dist2[farthest])
+                    farthest = i;
+            }
+            // Fewer distinct points than clusters
+            if (dist2[farthest] <= 0)
+                break;
+            centers.push_back(points[farthest]);
+        }
+
+        for (int iter = 0; iter < KMEANS_MAX_ITERATIONS; ++iter) {
+            bool changed = false;
+            for (size_t i = 0; i < points.size(); ++i) {
+                int32_t nearest = 0;
+                float nearest_dist2 = std::numeric_limits<float>::infinity();
+                for (size_t c = 0; c < centers.size(); ++c) {
+                    const auto d = points[i] - centers[c];
+                    const auto x = glm::dot(d, d);
+                    if (x < nearest_dist2) {
+                        nearest_dist2 = x;
+                        nearest = static_cast<int32_t>(c);
+                    }
+                }
+                if (labels[i] != nearest) {
+                    labels[i] = nearest;
+                    changed = true;
+                }
+            }
+            if (!changed && iter > 0)
+                break;
+
+            std::vector<glm::vec3> sums(centers.size(), glm::vec3{ 0 });
+            std::vector<size_t> counts(centers.size(), 0);
+            for (size_t i = 0; i < points.size(); ++i) {
+                sums[labels[i]] += points[i];
+                ++counts[labels[i]];
+            }
+            for (size_t c = 0; c < centers.size(); ++c) {
+                if (counts[c] > 0)
+                    centers[c] = sums[c] / static_cast<float>(counts[c]);
+            }
+        }
+
+        return labels;
+    }
+
+    // Clamped so that the cast is defined. NaN goes to cell 0.
+    int32_t make_cell_coord(const float x, const float cell_size) {
+        using limits_t = std::numeric_limits<int32_t>;
+        const auto cell = std::floor(static_cast<double>(x) / cell_size);
+        if (std::isnan(cell))
+            return 0;
+        return static_cast<int32_t>(std::clamp<double>(
+            cell, limits_t::min(), limits_t::max()
+        ));
+    }
+
+    // Cell of every mesh actor by its position, all the same if `batching`
+    // is null
+    std::vector<::CellKey> assign_cells(
+        const std::vector<glm::mat4>& actor_transforms,
+        const dalp::BatchingOptions* const batching
+    ) {
+        std::vector<::CellKey> output(
+            actor_transforms.size(), ::CellKey{ 0, 0, 0 }
+        );
+        if (nullptr == batching)
+            return output;
+
+        std::vector<glm::vec3> positions;
+        positions.reserve(actor_transforms.size());
+        for (auto& m : actor_transforms) positions.emplace_back(m[3]);
+
+        using Clustering = dalp::BatchingOptions::Clustering;
+        if (Clustering::kmeans == batching->clustering_) {
+            const auto labels = ::cluster_kmeans(
+                positions, batching->cluster_count_
+            );
+            for (size_t i = 0; i < labels.size(); ++i)
+                output[i] = { labels[i], 0, 0 };
+            return output;
+        }
+
+        const auto cell_size = std::max(batching->cell_size_, 1e-6f);
+        for (size_t i = 0; i < positions.size(); ++i) {
+            const auto& pos = positions[i];
+            output[i] = { ::make_cell_coord(pos.x, cell_size),
+                          ::make_cell_coord(pos.y, cell_size),
+                          ::make_cell_coord(pos.z, cell_size) };
+        }
+        return output;
+    }
+
+    // Merges by material within each cell, up to a vertex budget
+    class BatchUnitFinder {
+
+    public:
+        BatchUnitFinder(
+            std::vector<dalp::RenderUnit<dalp::Mesh_Indexed>>& units,
+            const size_t max_vertices
+        )
+            : units_(units), max_vertices_(max_vertices) {}
+
+        dalp::RenderUnit<dalp::Mesh_Indexed>& find_or_create(
+            const ::CellKey& cell,
+            const scene_t::Material& material,
+            const size_t vertex_count
+        ) {
+            auto& candidates = this->cells_[cell];
+            for (const auto i : candidates) {
+                auto& unit = this->units_[i];
+                if (!unit.material_.is_physically_same(material))
+                    continue;
+                const auto new_count = unit.mesh_.vertices_.size() +
+                                       vertex_count;
+                if (new_count > this->max_vertices_)
+                    continue;
+                return unit;
+            }
+
+            candidates.push_back(this->units_.size());
+            return this->units_.emplace_back();
+        }
+
+    private:
+        std::map<::CellKey, std::vector<size_t>> cells_;
+        std::vector<dalp::RenderUnit<dalp::Mesh_Indexed>>& units_;
+        size_t max_vertices_;
+    };
+
+}  // namespace
+
+
 // convert_to_model_dmd
 namespace {
 
@@ -146,14 +310,149 @@ namespace {
         return units.emplace_back();
     }
 
+    // Weld index of `unit`, which is kept in `indices` at the same position
+    // as the unit in `units` so that units can be filled by several calls
+    // to `add_vertices`
+    template <typename _Vertex>
+    dalp::TVertexWeldIndex<_Vertex>& get_weld_index(
+        std::vector<dalp::TVertexWeldIndex<_Vertex>>& indices,
+        const std::vector<dalp::RenderUnit<dalp::TMesh_Indexed<_Vertex>>>&
+            units,
+        const dalp::RenderUnit<dalp::TMesh_Indexed<_Vertex>>& unit
+    ) {
+        while (indices.size() < units.size()) {
+            const auto& vertices = units[indices.size()].mesh_.vertices_;
+            indices.emplace_back().build_from(vertices);
+        }
+        return indices[&unit - units.data()];
+    }
+
+    void add_vertices(
+        dalp::Mesh_Indexed& dst,
+        dalp::TVertexWeldIndex<dalp::Vertex>& weld_index,
+        const scene_t::Mesh& src,
+        const glm::mat4& transform
+    ) {
+        const auto transform3 = glm::mat3{ transform };
+
+        for (auto src_index : src.indices_) {
+            auto& src_vert = src.vertices_[src_index];
+
+            dalp::Vertex vertex;
+            vertex.pos_ = transform * glm::vec4{ src_vert.pos_, 1 };
+            vertex.uv_ = src_vert.uv_;
+            vertex.normal_ = glm::normalize(transform3 * src_vert.normal_);
+            dst.add_vertex(vertex, weld_index);
+        }
+    }
+
+    void add_vertices(
+        dalp::Mesh_IndexedJoint& dst,
+        dalp::TVertexWeldIndex<dalp::VertexJoint>& weld_index,
+        const scene_t::Mesh& src,
+        const glm::mat4& transform
+    ) {
+        const auto transform3 = glm::mat3{ transform };
+
+        for (auto src_index : src.indices_) {
+            auto& src_vert = src.vertices_[src_index];
+
+            dalp::VertexJoint vertex;
+            vertex.pos_ = transform * glm::vec4{ src_vert.pos_, 1 };
+            vertex.uv_ = src_vert.uv_;
+            vertex.normal_ = glm::normalize(transform3 * src_vert.normal_);
+
+            const int valid_joint_count = std::min<int>(
+                4, src_vert.joints_.size()
+            );
+            for (int i = 0; i < valid_joint_count; ++i) {
+                vertex.joint_indices_[i] = src_vert.joints_[i].index_;
+                vertex.joint_weights_[i] = src_vert.joints_[i].weight_;
+            }
+            for (int i = valid_joint_count; i < dalp::NUM_JOINTS_PER_VERTEX;
+                 ++i) {
+                vertex.joint_indices_[i] = dalp::NULL_JID;
+            }
+
+            dst.add_vertex(vertex, weld_index);
+        }
+    }
+
+    // Mesh name and material name
+    using RenderPairKey = std::pair<std::string, std::string>;
+
+    // Transforms of static render pairs worth instancing, keyed so the
+    // output unit order doesn't depend on hashing
+    std::map<::RenderPairKey, std::vector<glm::mat4>> find_instanced_pairs(
+        const dalp::SceneIntermediate& scene,
+        const dalp::InstancingOptions& options
+    ) {
+        std::map<::RenderPairKey, std::vector<glm::mat4>> output;
+
+        for (auto& actor : scene.mesh_actors_) {
+            const auto actor_mat4 = scene.make_hierarchy_transform(actor);
+
+            for (auto& pair : actor.render_pairs_) {
+                const auto mesh = scene.find_mesh_by_name(pair.mesh_name_);
+                if (nullptr == mesh || !mesh->skeleton_name_.empty())
+                    continue;
+                if (nullptr == scene.find_material_by_name(pair.material_name_))
+                    continue;
+
+                output[{ pair.mesh_name_, pair.material_name_ }].push_back(
+                    actor_mat4
+                );
+            }
+        }
+
+        for (auto it = output.begin(); it != output.end();) {
+            const auto mesh = scene.find_mesh_by_name(it->first.first);
+            const auto count = it->second.size();
+            const auto baked_vertices = count * mesh->vertices_.size();
+
+            if (count < options.min_instances_ ||
+                baked_vertices <= options.max_baked_vertices_)
+                it = output.erase(it);
+            else
+                ++it;
+        }
+
+        return output;
+    }
+
     void convert_meshes(
-        dalp::Model& output, const dalp::SceneIntermediate& scene
+        dalp::Model& output,
+        const dalp::SceneIntermediate& scene,
+        const dalp::ModelConvertOptions& options
     ) {
-        for (auto& src_mesh_actor : scene.mesh_actors_) {
-            const auto actor_mat4 = scene.make_hierarchy_transform(
-                src_mesh_actor
+        std::map<::RenderPairKey, std::vector<glm::mat4>> instanced;
+        if (options.instancing_.has_value())
+            instanced = ::find_instanced_pairs(
+                scene, options.instancing_.value()
             );
-            const auto actor_mat3 = glm::mat3{ actor_mat4 };
+
+        std::vector<glm::mat4> actor_transforms;
+        actor_transforms.reserve(scene.mesh_actors_.size());
+        for (auto& actor : scene.mesh_actors_)
+            actor_transforms.push_back(scene.make_hierarchy_transform(actor));
+
+        const auto batching = options.batching_.has_value()
+                                  ? &options.batching_.value()
+                                  : nullptr;
+        const auto cells = ::assign_cells(actor_transforms, batching);
+        ::BatchUnitFinder batches{
+            output.units_indexed_,
+            batching ? batching->max_vertices_
+                     : std::numeric_limits<size_t>::max()
+        };
+
+        std::vector<dalp::TVertexWeldIndex<dalp::Vertex>> weld_indices;
+        std::vector<dalp::TVertexWeldIndex<dalp::VertexJoint>>
+            weld_indices_joint;
+
+        for (size_t i = 0; i < scene.mesh_actors_.size(); ++i) {
+            const auto& src_mesh_actor = scene.mesh_actors_[i];
+            const auto& actor_mat4 = actor_transforms[i];
 
             for (auto& pair : src_mesh_actor.render_pairs_) {
                 const auto src_mesh = scene.find_mesh_by_name(pair.mesh_name_);
@@ -171,25 +470,23 @@ namespace {
                 }
 
                 if (src_mesh->skeleton_name_.empty()) {
-                    auto& dst_pair = ::find_or_create_render_unit_by_material(
-                        output.units_indexed_, *src_material
+                    const ::RenderPairKey key{ pair.mesh_name_,
+                                               pair.material_name_ };
+                    if (instanced.end() != instanced.find(key))
+                        continue;
+
+                    auto& dst_pair = batches.find_or_create(
+                        cells[i], *src_material, src_mesh->vertices_.size()
                     );
 
                     dst_pair.name_ = src_mesh->name_;
                     dst_pair.material_ = *src_material;
-
-                    for (auto src_index : src_mesh->indices_) {
-                        auto& src_vert = src_mesh->vertices_[src_index];
-
-                        dalp::Vertex vertex;
-                        vertex.pos_ = actor_mat4 *
-                                      glm::vec4{ src_vert.pos_, 1 };
-                        vertex.uv_ = src_vert.uv_;
-                        vertex.normal_ = glm::normalize(
-                            actor_mat3 * src_vert.normal_
-                        );
-                        dst_pair.mesh_.add_vertex(vertex);
-                    }
+                    auto& weld_index = ::get_weld_index(
+                        weld_indices, output.units_indexed_, dst_pair
+                    );
+                    ::add_vertices(
+                        dst_pair.mesh_, weld_index, *src_mesh, actor_mat4
+                    );
                 } else {
                     auto& dst_pair = ::find_or_create_render_unit_by_material(
                         output.units_indexed_joint_, *src_material
@@ -197,38 +494,31 @@ namespace {
 
                     dst_pair.name_ = src_mesh->name_;
                     dst_pair.material_ = *src_material;
-
-                    for (auto src_index : src_mesh->indices_) {
-                        auto& src_vert = src_mesh->vertices_[src_index];
-
-                        dalp::VertexJoint vertex;
-                        vertex.pos_ = actor_mat4 *
-                                      glm::vec4{ src_vert.pos_, 1 };
-                        vertex.uv_ = src_vert.uv_;
-                        vertex.normal_ = glm::normalize(
-                            actor_mat3 * src_vert.normal_
-                        );
-
-                        const int valid_joint_count = std::min<int>(
-                            4, src_vert.joints_.size()
-                        );
-                        for (int i = 0; i < valid_joint_count; ++i) {
-                            vertex.joint_indices_[i] =
-                                src_vert.joints_[i].index_;
-                            vertex.joint_weights_[i] =
-                                src_vert.joints_[i].weight_;
-                        }
-                        for (int i = valid_joint_count;
-                             i < dalp::NUM_JOINTS_PER_VERTEX;
-                             ++i) {
-                            vertex.joint_indices_[i] = dalp::NULL_JID;
-                        }
-
-                        dst_pair.mesh_.add_vertex(vertex);
-                    }
+                    auto& weld_index = ::get_weld_index(
+                        weld_indices_joint,
+                        output.units_indexed_joint_,
+                        dst_pair
+                    );
+                    ::add_vertices(
+                        dst_pair.mesh_, weld_index, *src_mesh, actor_mat4
+                    );
                 }
             }
         }
+
+        // After baked units so those never merge into instanced ones
+        for (auto& [key, transforms] : instanced) {
+            const auto src_mesh = scene.find_mesh_by_name(key.first);
+            auto& dst_unit = output.units_indexed_.emplace_back();
+
+            dst_unit.name_ = src_mesh->name_;
+            dst_unit.material_ = *scene.find_material_by_name(key.second);
+            dalp::TVertexWeldIndex<dalp::Vertex> weld_index;
+            ::add_vertices(
+                dst_unit.mesh_, weld_index, *src_mesh, glm::mat4{ 1 }
+            );
+            dst_unit.instances_ = std::move(transforms);
+        }
     }
 
     void convert_skeleton(
@@ -267,6 +557,189 @@ namespace {
 }  // namespace
 
 
+// remove_duplicate_meshes
+namespace {
+
+    // Names aside, so meshes that only differ by name hash the same
+    size_t make_mesh_content_hash(const scene_t::Mesh& mesh) {
+        size_t output = std::hash<std::string>{}(mesh.skeleton_name_);
+
+        dal::hash_combine(output, mesh.vertices_.size());
+        for (auto& vert : mesh.vertices_)
+            dal::hash_combine(output, vert.make_hash());
+
+        dal::hash_combine(output, mesh.indices_.size());
+        for (const auto index : mesh.indices_)
+            dal::hash_combine(output, index);
+
+        return output;
+    }
+
+    bool are_same_content(const scene_t::Mesh& a, const scene_t::Mesh& b) {
+        if (a.skeleton_name_ != b.skeleton_name_)
+            return false;
+        if (a.indices_ != b.indices_)
+            return false;
+        return a.vertices_ == b.vertices_;
+    }
+
+}  // namespace
+
+
+// weld_vertices
+namespace {
+
+    class SpatialWeldGrid {
+
+    public:
+        explicit SpatialWeldGrid(const float cell_size)
+            : cell_size_(std::max(cell_size, 1e-6f)) {}
+
+        void reserve(size_t count) { this->cells_.reserve(count); }
+
+        // Calls `func` with every vertex index registered in the 3x3x3 cells
+        // around `pos`
+        template <typename TFunc>
+        void for_each_near(const glm::vec3& pos, TFunc&& func) const {
+            const auto center = this->make_cell(pos);
+
+            for (int64_t dx = -1; dx <= 1; ++dx) {
+                for (int64_t dy = -1; dy <= 1; ++dy) {
+                    for (int64_t dz = -1; dz <= 1; ++dz) {
+                        const Cell cell{ center.x_ + dx,
+                                         center.y_ + dy,
+                                         center.z_ + dz };
+                        const auto found = this->cells_.find(cell);
+                        if (this->cells_.end() == found)
+                            continue;
+
+                        for (const auto index : found->second) func(index);
+                    }
+                }
+            }
+        }
+
+        void add(const glm::vec3& pos, const uint32_t index) {
+            this->cells_[this->make_cell(pos)].push_back(index);
+        }
+
+    private:
+        struct Cell {
+            int64_t x_, y_, z_;
+
+            bool operator==(const Cell& rhs) const {
+                return x_ == rhs.x_ && y_ == rhs.y_ && z_ == rhs.z_;
+            }
+        };
+
+        struct CellHash {
+            size_t operator()(const Cell& c) const {
+                // Large primes from "Optimized Spatial Hashing for Collision
+                // Detection of Deformable Objects" (Teschner et al.)
+                const auto x = static_cast<uint64_t>(c.x_) * 73856093;
+                const auto y = static_cast<uint64_t>(c.y_) * 19349663;
+                const auto z = static_cast<uint64_t>(c.z_) * 83492791;
+                return static_cast<size_t>(x ^ y ^ z);
+            }
+        };
+
+        Cell make_cell(const glm::vec3& pos) const {
+            return Cell{
+                this->make_coord(pos.x),
+                this->make_coord(pos.y),
+                this->make_coord(pos.z),
+            };
+        }
+
+        // Clamped so that the cast is defined. NaN goes to cell 0, which is
+        // harmless since such vertices never pass `is_within_tolerance`.
+        int64_t make_coord(const float x) const {
+            constexpr float LIMIT = 1e18f;
+            const auto cell = std::floor(x / this->cell_size_);
+            if (std::isnan(cell))
+                return 0;
+            return static_cast<int64_t>(std::clamp(cell, -LIMIT, LIMIT));
+        }
+
+        std::unordered_map<Cell, std::vector<uint32_t>, CellHash> cells_;
+        float cell_size_;
+    };
+
+
+    // Written as `!(x <= tolerance)` so that vertices with NaN never weld
+    bool is_within_tolerance(
+        const scene_t::Vertex& a,
+        const scene_t::Vertex& b,
+        const dalp::VertexWeldTolerance& tolerance
+    ) {
+        if (!(glm::distance(a.pos_, b.pos_) <= tolerance.pos_))
+            return false;
+        if (!(glm::distance(a.normal_, b.normal_) <= tolerance.normal_))
+            return false;
+        if (!(glm::distance(a.uv_, b.uv_) <= tolerance.uv_))
+            return false;
+
+        if (a.joints_.size() != b.joints_.size())
+            return false;
+
+        for (size_t i = 0; i < a.joints_.size(); ++i) {
+            if (a.joints_[i].index_ != b.joints_[i].index_)
+                return false;
+            const auto weight_diff = a.joints_[i].weight_ -
+                                     b.joints_[i].weight_;
+            if (!(std::abs(weight_diff) <= tolerance.weight_))
+                return false;
+        }
+
+        return true;
+    }
+
+    // Each vertex snaps to the earliest kept vertex within tolerance, so the
+    // kept vertices never drift and the result does not depend on hash order.
+    void weld_vertices(
+        scene_t::Mesh& mesh, const dalp::VertexWeldTolerance& tolerance
+    ) {
+        const auto vertex_count = mesh.vertices_.size();
+
+        ::SpatialWeldGrid grid{ tolerance.pos_ };
+        grid.reserve(vertex_count);
+
+        std::vector<scene_t::Vertex> new_vertices;
+        std::vector<uint32_t> remap(vertex_count);
+
+        for (size_t i = 0; i < vertex_count; ++i) {
+            const auto& vert = mesh.vertices_[i];
+            auto found = std::numeric_limits<uint32_t>::max();
+
+            grid.for_each_near(vert.pos_, [&](const uint32_t candidate) {
+                if (candidate >= found)
+                    return;
+                if (::is_within_tolerance(
+                        new_vertices[candidate], vert, tolerance
+                    ))
+                    found = candidate;
+            });
+
+            if (std::numeric_limits<uint32_t>::max() == found) {
+                found = static_cast<uint32_t>(new_vertices.size());
+                grid.add(vert.pos_, found);
+                new_vertices.push_back(vert);
+            }
+
+            remap[i] = found;
+        }
+
+        if (new_vertices.size() == vertex_count)
+            return;
+
+        for (auto& index : mesh.indices_) index = remap[index];
+
+        mesh.vertices_ = std::move(new_vertices);
+    }
+
+}  // namespace
+
+
 // reduce_joints
 namespace {
 
@@ -749,6 +1222,15 @@ namespace {
             opaque.skeleton_name_ = mesh.skeleton_name_;
             transp.skeleton_name_ = mesh.skeleton_name_;
 
+            const auto transp_index_count = r.transp_tri_indices_.size() * 3;
+            const auto opaque_index_count = mesh.indices_.size() -
+                                            transp_index_count;
+            dalp::TVertexWeldIndex<scene_t::Vertex> opaque_index, transp_index;
+            transp.reserve(transp_index_count);
+            opaque.reserve(opaque_index_count);
+            transp_index.reserve(transp_index_count);
+            opaque_index.reserve(opaque_index_count);
+
             for (size_t tri_index = 0; tri_index < r.tri_count_; ++tri_index) {
                 const auto& i0 = mesh.indices_[tri_index * 3 + 0];
                 const auto& i1 = mesh.indices_[tri_index * 3 + 1];
@@ -762,13 +1244,13 @@ namespace {
                                       r.transp_tri_indices_.find(tri_index);
 
                 if (is_tranp) {
-                    transp.add_vertex(v0);
-                    transp.add_vertex(v1);
-                    transp.add_vertex(v2);
+                    transp.add_vertex(v0, transp_index);
+                    transp.add_vertex(v1, transp_index);
+                    transp.add_vertex(v2, transp_index);
                 } else {
-                    opaque.add_vertex(v0);
-                    opaque.add_vertex(v1);
-                    opaque.add_vertex(v2);
+                    opaque.add_vertex(v0, opaque_index);
+                    opaque.add_vertex(v1, opaque_index);
+                    opaque.add_vertex(v2, opaque_index);
                 }
             }
 
@@ -1024,15 +1506,36 @@ namespace dal::parser {
         scene.root_transform_ = glm::mat4{ 1 };
     }
 
-    void reduce_indexed_vertices(SceneIntermediate& scene) {
-        for (auto& mesh : scene.meshes_) {
-            scene_t::Mesh builder;
-            for (auto& index : mesh.indices_)
-                builder.add_vertex(mesh.vertices_[index]);
+    void reduce_indexed_vertices(
+        SceneIntermediate& scene, const uint32_t thread_count
+    ) {
+        dal::parallel_for(
+            scene.meshes_.size(), thread_count, [&](const size_t i) {
+                auto& mesh = scene.meshes_[i];
+
+                scene_t::Mesh builder;
+                dalp::TVertexWeldIndex<scene_t::Vertex> weld_index;
+                builder.reserve(mesh.indices_.size());
+                weld_index.reserve(mesh.indices_.size());
+                for (auto& index : mesh.indices_)
+                    builder.add_vertex(mesh.vertices_[index], weld_index);
+
+                std::swap(mesh.vertices_, builder.vertices_);
+                std::swap(mesh.indices_, builder.indices_);
+            }
+        );
+    }
 
-            std::swap(mesh.vertices_, builder.vertices_);
-            std::swap(mesh.indices_, builder.indices_);
-        }
+    void weld_vertices(
+        SceneIntermediate& scene,
+        const VertexWeldTolerance& tolerance,
+        const uint32_t thread_count
+    ) {
+        dal::parallel_for(
+            scene.meshes_.size(), thread_count, [&](const size_t i) {
+                ::weld_vertices(scene.meshes_[i], tolerance);
+            }
+        );
     }
 
     void remove_duplicate_materials(SceneIntermediate& scene) {
@@ -1066,6 +1569,63 @@ namespace dal::parser {
         }
     }
 
+    size_t remove_duplicate_meshes(
+        SceneIntermediate& scene, const uint32_t thread_count
+    ) {
+        auto& meshes = scene.meshes_;
+        std::vector<size_t> hashes(meshes.size());
+        dal::parallel_for(meshes.size(), thread_count, [&](const size_t i) {
+            hashes[i] = ::make_mesh_content_hash(meshes[i]);
+        });
+
+        ::StringReplaceMap replace_map;
+        std::unordered_map<size_t, std::vector<size_t>> kept_by_hash;
+        std::vector<bool> removed(meshes.size(), false);
+        size_t removed_count = 0;
+
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            auto& candidates = kept_by_hash[hashes[i]];
+            const scene_t::Mesh* found = nullptr;
+            for (const auto k : candidates) {
+                if (::are_same_content(meshes[k], meshes[i])) {
+                    found = &meshes[k];
+                    break;
+                }
+            }
+
+            if (nullptr == found) {
+                candidates.push_back(i);
+                continue;
+            }
+
+            if (meshes[i].name_ != found->name_)
+                replace_map.add(meshes[i].name_, found->name_);
+            removed[i] = true;
+            ++removed_count;
+        }
+
+        if (0 == removed_count)
+            return 0;
+
+        std::vector<scene_t::Mesh> new_meshes;
+        new_meshes.reserve(meshes.size() - removed_count);
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            if (!removed[i])
+                new_meshes.push_back(std::move(meshes[i]));
+        }
+        std::swap(meshes, new_meshes);
+
+        for (auto& mesh_actor : scene.mesh_actors_) {
+            for (auto& render_pair : mesh_actor.render_pairs_) {
+                render_pair.mesh_name_ = replace_map.get(
+                    render_pair.mesh_name_
+                );
+            }
+        }
+
+        return removed_count;
+    }
+
     void reduce_joints(SceneIntermediate& scene) {
         for (auto& skel : scene.skeletons_) {
             const auto result = ::reduce_joints(
@@ -1176,10 +1736,12 @@ namespace dal::parser {
 
     // Convert
 
-    Model convert_to_model_dmd(const SceneIntermediate& scene) {
+    Model convert_to_model_dmd(
+        const SceneIntermediate& scene, const ModelConvertOptions& options
+    ) {
         Model output;
 
-        ::convert_meshes(output, scene);
+        ::convert_meshes(output, scene, options);
 
         if (scene.skeletons_.size() > 1) {
             throw std::runtime_error{ "Multiple skeletons are not supported" };
@@ -1191,7 +1753,9 @@ namespace dal::parser {
             output.animations_.push_back(src_anim);
         }
 
+        compute_bounds(output);
         return output;
     }
 
 }  // namespace dal::parser
+
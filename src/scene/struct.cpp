@@ -1,10 +1,58 @@
 #include "daltools/scene/struct.h"
 
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
+#include "daltools/common/util.h"
+
+
+namespace {
+
+    // -0 compares equal to +0 so they must hash the same. NaN never compares
+    // equal to anything so whatever it hashes to is fine.
+    uint32_t float_bits_for_hash(const float v) {
+        if (0.f == v)
+            return 0;
+
+        uint32_t output;
+        std::memcpy(&output, &v, sizeof(output));
+        return output;
+    }
+
+    template <typename T>
+    void hash_combine_floats(size_t& seed, const T& vec) {
+        for (typename T::length_type i = 0; i < T::length(); ++i)
+            dal::hash_combine(seed, ::float_bits_for_hash(vec[i]));
+    }
+
+}  // namespace
+
 
 namespace dal::parser {
 
+    void AABB3::merge(const AABB3& other) {
+        this->min_ = glm::min(this->min_, other.min_);
+        this->max_ = glm::max(this->max_, other.max_);
+    }
+
+    // Arvo, "Transforming Axis-Aligned Bounding Boxes" (1990)
+    AABB3 AABB3::transform(const glm::mat4& m) const {
+        AABB3 output;
+        output.min_ = output.max_ = glm::vec3{ m[3] };
+
+        for (int c = 0; c < 3; ++c) {
+            for (int r = 0; r < 3; ++r) {
+                const auto a = m[c][r] * this->min_[c];
+                const auto b = m[c][r] * this->max_[c];
+                output.min_[r] += std::min(a, b);
+                output.max_[r] += std::max(a, b);
+            }
+        }
+        return output;
+    }
+
+
     bool Vertex::is_equal(const Vertex& other) const {
         return (
             this->pos_ == other.pos_ && this->uv_ == other.uv_ &&
@@ -22,6 +70,26 @@ namespace dal::parser {
     }
 
 
+    size_t Vertex::make_hash() const {
+        size_t output = 0;
+        ::hash_combine_floats(output, this->pos_);
+        ::hash_combine_floats(output, this->normal_);
+        ::hash_combine_floats(output, this->uv_);
+        return output;
+    }
+
+    size_t VertexJoint::make_hash() const {
+        size_t output = 0;
+        ::hash_combine_floats(output, this->pos_);
+        ::hash_combine_floats(output, this->normal_);
+        ::hash_combine_floats(output, this->uv_);
+        ::hash_combine_floats(output, this->joint_weights_);
+        for (int i = 0; i < NUM_JOINTS_PER_VERTEX; ++i)
+            dal::hash_combine(output, this->joint_indices_[i]);
+        return output;
+    }
+
+
     void Mesh_Straight::concat(const Mesh_Straight& other) {
         this->vertices_.insert(
             vertices_.end(), other.vertices_.begin(), other.vertices_.end()
@@ -98,7 +166,7 @@ namespace dal::parser {
     }
 
 
-    bool scene_t::Vertex::are_same(const scene_t::Vertex& other) {
+    bool scene_t::Vertex::are_same(const scene_t::Vertex& other) const {
         if (this->pos_ != other.pos_)
             return false;
         if (this->normal_ != other.normal_)
@@ -124,6 +192,22 @@ namespace dal::parser {
     }
 
 
+    size_t scene_t::Vertex::make_hash() const {
+        size_t output = 0;
+        ::hash_combine_floats(output, this->pos_);
+        ::hash_combine_floats(output, this->normal_);
+        ::hash_combine_floats(output, this->uv_);
+
+        dal::hash_combine(output, this->joints_.size());
+        for (auto& joint : this->joints_) {
+            dal::hash_combine(output, joint.index_);
+            dal::hash_combine(output, ::float_bits_for_hash(joint.weight_));
+        }
+
+        return output;
+    }
+
+
     void scene_t::Mesh::add_vertex(const scene_t::Vertex& vertex) {
         const auto vert_size = this->vertices_.size();
         for (size_t i = 0; i < vert_size; ++i) {
@@ -137,14 +221,30 @@ namespace dal::parser {
         this->vertices_.push_back(vertex);
     }
 
+    void scene_t::Mesh::add_vertex(
+        const scene_t::Vertex& vertex,
+        TVertexWeldIndex<scene_t::Vertex>& index
+    ) {
+        this->indices_.push_back(index.add(this->vertices_, vertex));
+    }
+
+    void scene_t::Mesh::reserve(const size_t index_count) {
+        this->indices_.reserve(this->indices_.size() + index_count);
+    }
+
     void scene_t::Mesh::concat(const scene_t::Mesh& other) {
         if (this->skeleton_name_ != other.skeleton_name_)
             throw std::runtime_error{
                 "Cannot concatenate meshes with different skeletons"
             };
 
+        TVertexWeldIndex<scene_t::Vertex> weld_index;
+        weld_index.build_from(this->vertices_);
+        weld_index.reserve(this->vertices_.size() + other.indices_.size());
+
+        this->reserve(other.indices_.size());
         for (const auto index : other.indices_) {
-            this->add_vertex(other.vertices_[index]);
+            this->add_vertex(other.vertices_[index], weld_index);
         }
     }
 
@@ -0,0 +1,454 @@
+#include "daltools/scene/tiling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+#include <nlohmann/json.hpp>
+
+
+namespace {
+
+    namespace dalp = dal::parser;
+    using scene_t = dalp::SceneIntermediate;
+    using json_t = nlohmann::json;
+
+
+    bool is_sphere_touching(
+        const glm::vec3& center, const float radius, const dalp::AABB3& aabb
+    ) {
+        const auto closest = glm::max(aabb.min_, glm::min(center, aabb.max_));
+        const auto d = closest - center;
+        return glm::dot(d, d) <= radius * radius;
+    }
+
+
+    // Mesh actor or light to be placed in a tile
+    struct TileItem {
+        const scene_t::IActor* actor_ = nullptr;
+        dalp::AABB3 bounds_;
+        // Point lights and spotlights only
+        const scene_t::PointLight* light_ = nullptr;
+        bool is_spotlight_ = false;
+
+        glm::vec2 key() const {
+            const auto center = (this->bounds_.min_ + this->bounds_.max_) *
+                                0.5f;
+            return glm::vec2{ center.x, center.z };
+        }
+    };
+
+
+    std::vector<::TileItem> collect_items(const scene_t& scene) {
+        std::vector<::TileItem> output;
+
+        std::unordered_map<std::string, std::optional<dalp::AABB3>> mesh_aabbs;
+        for (auto& mesh : scene.meshes_) {
+            auto& aabb = mesh_aabbs[mesh.name_];
+            for (auto& v : mesh.vertices_) {
+                if (!aabb.has_value())
+                    aabb = dalp::AABB3{ v.pos_, v.pos_ };
+                aabb->min_ = glm::min(aabb->min_, v.pos_);
+                aabb->max_ = glm::max(aabb->max_, v.pos_);
+            }
+        }
+
+        for (auto& actor : scene.mesh_actors_) {
+            const auto world = scene.make_hierarchy_transform(actor);
+
+            std::optional<dalp::AABB3> local;
+            for (auto& pair : actor.render_pairs_) {
+                const auto found = mesh_aabbs.find(pair.mesh_name_);
+                if (mesh_aabbs.end() == found || !found->second.has_value())
+                    continue;
+                if (local.has_value())
+                    local.value().merge(found->second.value());
+                else
+                    local = found->second;
+            }
+
+            // Actors without vertices are a point at their origin
+            auto& item = output.emplace_back();
+            item.actor_ = &actor;
+            item.bounds_ = local.value_or(dalp::AABB3{}).transform(world);
+        }
+
+        const auto add_light = [&](const scene_t::PointLight& light,
+                                   const bool is_spotlight) {
+            const glm::vec3 pos{ scene.make_hierarchy_transform(light)[3] };
+            auto& item = output.emplace_back();
+            item.actor_ = &light;
+            item.bounds_ = dalp::AABB3{ pos, pos };
+            item.light_ = &light;
+            item.is_spotlight_ = is_spotlight;
+        };
+        for (auto& light : scene.plights_) add_light(light, false);
+        for (auto& light : scene.slights_) add_light(light, true);
+
+        return output;
+    }
+
+}  // namespace
+
+
+// Partitioning
+namespace {
+
+    struct Partition {
+        std::vector<std::string> names_;
+        // Tile index of every item
+        std::vector<uint32_t> assignments_;
+    };
+
+
+    // Clamped so that the cast is defined even for huge or NaN positions
+    int64_t make_grid_coord(const float x, const float tile_size) {
+        constexpr float LIMIT = 1e18f;
+        const auto cell = std::floor(x / tile_size);
+        if (std::isnan(cell))
+            return 0;
+        return static_cast<int64_t>(std::clamp(cell, -LIMIT, LIMIT));
+    }
+
+    ::Partition partition_grid(
+        const std::vector<::TileItem>& items, const float tile_size
+    ) {
+        ::Partition output;
+        std::vector<std::pair<int64_t, int64_t>> cells;
+        std::map<std::pair<int64_t, int64_t>, uint32_t> cell_tiles;
+
+        for (auto& item : items) {
+            const auto key = item.key();
+            const auto& cell = cells.emplace_back(
+                ::make_grid_coord(key.x, tile_size),
+                ::make_grid_coord(key.y, tile_size)
+            );
+            cell_tiles.emplace(cell, 0);
+        }
+
+        // Sorted by cell so the output doesn't depend on actor order
+        for (auto& [cell, index] : cell_tiles) {
+            index = static_cast<uint32_t>(output.names_.size());
+            output.names_.push_back(
+                std::to_string(cell.first) + '_' + std::to_string(cell.second)
+            );
+        }
+
+        output.assignments_.reserve(items.size());
+        for (auto& cell : cells)
+            output.assignments_.push_back(cell_tiles.at(cell));
+
+        return output;
+    }
+
+
+    ::Partition partition_quadtree(
+        const std::vector<::TileItem>& items,
+        const float tile_size,
+        const size_t max_actors
+    ) {
+        ::Partition output;
+        output.assignments_.resize(items.size());
+        if (items.empty())
+            return output;
+
+        glm::vec2 min = items[0].key(), max = min;
+        for (auto& item : items) {
+            min = glm::min(min, item.key());
+            max = glm::max(max, item.key());
+        }
+        const auto extent = max - min;
+        const auto root_size = std::max({ extent.x, extent.y, tile_size });
+
+        std::vector<uint32_t> all(items.size());
+        for (uint32_t i = 0; i < all.size(); ++i) all[i] = i;
+
+        std::function<void(
+            std::vector<uint32_t>&, glm::vec2, float, const std::string&
+        )>
+            build;
+        build = [&](std::vector<uint32_t>& indices,
+                    const glm::vec2 origin,
+                    const float size,
+                    const std::string& name) {
+            if (indices.empty())
+                return;
+
+            const auto half = size * 0.5f;
+            // Negated so that a non-finite size stops splitting as well
+            if (indices.size() <= max_actors || !(half >= tile_size)) {
+                const auto tile = static_cast<uint32_t>(output.names_.size());
+                output.names_.push_back(name);
+                for (const auto i : indices) output.assignments_[i] = tile;
+                return;
+            }
+
+            const auto mid = origin + half;
+            std::vector<uint32_t> children[4];
+            for (const auto i : indices) {
+                const auto key = items[i].key();
+                const int quadrant = (key.x >= mid.x ? 1 : 0) |
+                                     (key.y >= mid.y ? 2 : 0);
+                children[quadrant].push_back(i);
+            }
+            indices.clear();
+            indices.shrink_to_fit();
+
+            for (int q = 0; q < 4; ++q) {
+                const glm::vec2 child_origin{ q & 1 ? mid.x : origin.x,
+                                              q & 2 ? mid.y : origin.y };
+                build(children[q], child_origin, half, name + char('0' + q));
+            }
+        };
+        build(all, min, root_size, "q");
+
+        return output;
+    }
+
+}  // namespace
+
+
+// Tile scenes
+namespace {
+
+    class TileSceneBuilder {
+
+    public:
+        TileSceneBuilder(const scene_t& src, scene_t& dst)
+            : src_(src), dst_(dst) {
+            this->dst_.name_ = src.name_;
+            this->dst_.root_transform_ = src.root_transform_;
+        }
+
+        void add_item(const ::TileItem& item) {
+            this->actor_names_.insert(item.actor_->name_);
+
+            if (item.is_spotlight_) {
+                this->dst_.slights_.push_back(
+                    static_cast<const scene_t::Spotlight&>(*item.light_)
+                );
+            } else if (nullptr != item.light_) {
+                this->dst_.plights_.push_back(*item.light_);
+            } else {
+                const auto& actor = static_cast<const scene_t::MeshActor&>(
+                    *item.actor_
+                );
+                this->dst_.mesh_actors_.push_back(actor);
+                for (auto& pair : actor.render_pairs_) {
+                    this->add_mesh(pair.mesh_name_);
+                    this->add_material(pair.material_name_);
+                }
+            }
+
+            this->pending_parents_.push_back(item.actor_);
+        }
+
+        // Call after every item is added
+        void finish() {
+            for (const auto actor : this->pending_parents_)
+                this->add_ancestors(*actor);
+
+            if (!this->dst_.skeletons_.empty())
+                this->dst_.animations_ = this->src_.animations_;
+        }
+
+    private:
+        void add_mesh(const std::string& name) {
+            if (!this->mesh_names_.insert(name).second)
+                return;
+            const auto mesh = this->src_.find_mesh_by_name(name);
+            if (nullptr == mesh)
+                return;
+
+            this->dst_.meshes_.push_back(*mesh);
+            if (!mesh->skeleton_name_.empty())
+                this->add_skeleton(mesh->skeleton_name_);
+        }
+
+        void add_material(const std::string& name) {
+            if (!this->material_names_.insert(name).second)
+                return;
+            if (const auto material = this->src_.find_material_by_name(name))
+                this->dst_.materials_.push_back(*material);
+        }
+
+        void add_skeleton(const std::string& name) {
+            if (!this->skeleton_names_.insert(name).second)
+                return;
+            if (const auto skeleton = this->src_.find_skeleton_by_name(name))
+                this->dst_.skeletons_.push_back(*skeleton);
+        }
+
+        // Ancestors placed in other tiles become transform only actors
+        void add_ancestors(const scene_t::IActor& actor) {
+            auto parent_name = actor.parent_name_;
+            while (!parent_name.empty()) {
+                const auto parent = this->src_.find_actor_by_name(parent_name);
+                if (nullptr == parent) {
+                    this->add_skeleton(parent_name);
+                    return;
+                }
+                if (!this->actor_names_.insert(parent_name).second)
+                    return;
+
+                auto& node = this->dst_.mesh_actors_.emplace_back();
+                node.name_ = parent->name_;
+                node.parent_name_ = parent->parent_name_;
+                node.transform_ = parent->transform_;
+                node.hidden_ = parent->hidden_;
+                parent_name = parent->parent_name_;
+            }
+        }
+
+        const scene_t& src_;
+        scene_t& dst_;
+        std::vector<const scene_t::IActor*> pending_parents_;
+        std::set<std::string> actor_names_;
+        std::set<std::string> mesh_names_;
+        std::set<std::string> material_names_;
+        std::set<std::string> skeleton_names_;
+    };
+
+}  // namespace
+
+
+namespace dal::parser {
+
+    WorldTiles split_into_tiles(
+        const SceneIntermediate& scene, const TilingOptions& options
+    ) {
+        const auto items = ::collect_items(scene);
+        const auto tile_size = std::max(options.tile_size_, 1e-6f);
+
+        ::Partition partition;
+        if (TilingOptions::Partition::quadtree == options.partition_) {
+            partition = ::partition_quadtree(
+                items, tile_size, options.max_actors_
+            );
+        } else {
+            partition = ::partition_grid(items, tile_size);
+        }
+
+        WorldTiles output;
+        const auto tile_count = partition.names_.size();
+        output.index_.tiles_.resize(tile_count);
+        output.scenes_.resize(tile_count);
+
+        std::vector<::TileSceneBuilder> builders;
+        builders.reserve(tile_count);
+        for (size_t i = 0; i < tile_count; ++i) {
+            output.index_.tiles_[i].name_ = partition.names_[i];
+            builders.emplace_back(scene, output.scenes_[i]);
+        }
+
+        std::vector<bool> has_bounds(tile_count, false);
+        for (size_t i = 0; i < items.size(); ++i) {
+            const auto t = partition.assignments_[i];
+            auto& tile = output.index_.tiles_[t];
+            builders[t].add_item(items[i]);
+
+            if (has_bounds[t])
+                tile.bounds_.merge(items[i].bounds_);
+            else
+                tile.bounds_ = items[i].bounds_;
+            has_bounds[t] = true;
+
+            if (nullptr != items[i].light_)
+                tile.lights_.push_back(items[i].actor_->name_);
+        }
+        for (auto& builder : builders) builder.finish();
+
+        for (auto& light : scene.dlights_)
+            output.index_.global_lights_.push_back(light.name_);
+
+        // A light reaching another tile makes that tile depend on its own
+        for (size_t i = 0; i < items.size(); ++i) {
+            const auto light = items[i].light_;
+            if (nullptr == light || light->max_distance_ <= 0)
+                continue;
+
+            const auto src_tile = partition.assignments_[i];
+            for (uint32_t t = 0; t < tile_count; ++t) {
+                auto& tile = output.index_.tiles_[t];
+                if (t == src_tile)
+                    continue;
+                if (!::is_sphere_touching(
+                        items[i].bounds_.min_,
+                        light->max_distance_,
+                        tile.bounds_
+                    ))
+                    continue;
+
+                auto& deps = tile.dependencies_;
+                if (deps.end() == std::find(deps.begin(), deps.end(), src_tile))
+                    deps.push_back(src_tile);
+            }
+        }
+        for (auto& tile : output.index_.tiles_)
+            std::sort(tile.dependencies_.begin(), tile.dependencies_.end());
+
+        return output;
+    }
+
+    std::string build_tile_index_json(const TileIndex& index) {
+        json_t tiles = json_t::array();
+        for (auto& tile : index.tiles_) {
+            auto& dst = tiles.emplace_back();
+            dst["name"] = tile.name_;
+            dst["file"] = tile.file_name_;
+            dst["aabb min"] = { tile.bounds_.min_.x,
+                                tile.bounds_.min_.y,
+                                tile.bounds_.min_.z };
+            dst["aabb max"] = { tile.bounds_.max_.x,
+                                tile.bounds_.max_.y,
+                                tile.bounds_.max_.z };
+            dst["dependencies"] = tile.dependencies_;
+            dst["lights"] = tile.lights_;
+        }
+
+        json_t output;
+        output["tiles"] = std::move(tiles);
+        output["global lights"] = index.global_lights_;
+        return output.dump(4);
+    }
+
+    std::optional<TileIndex> parse_tile_index_json(
+        const uint8_t* const file_content, const size_t content_size
+    ) {
+        const auto json_data = json_t::parse(
+            file_content, file_content + content_size, nullptr, false
+        );
+        if (json_data.is_discarded())
+            return std::nullopt;
+
+        try {
+            TileIndex output;
+            for (auto& src : json_data.at("tiles")) {
+                auto& tile = output.tiles_.emplace_back();
+                tile.name_ = src.at("name").get<std::string>();
+                tile.file_name_ = src.at("file").get<std::string>();
+                for (int i = 0; i < 3; ++i) {
+                    tile.bounds_.min_[i] = src.at("aabb min").at(i);
+                    tile.bounds_.max_[i] = src.at("aabb max").at(i);
+                }
+                src.at("dependencies").get_to(tile.dependencies_);
+                src.at("lights").get_to(tile.lights_);
+            }
+            json_data.at("global lights").get_to(output.global_lights_);
+
+            for (auto& tile : output.tiles_) {
+                for (const auto dep : tile.dependencies_) {
+                    if (dep >= output.tiles_.size())
+                        return std::nullopt;
+                }
+            }
+            return output;
+        } catch (const json_t::exception&) {
+            return std::nullopt;
+        }
+    }
+
+}  // namespace dal::parser
@@ -0,0 +1,231 @@
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "daltools/scene/bvh.h"
+
+
+namespace {
+
+    namespace dalp = dal::parser;
+
+
+    // Small random triangles spread over two units, skinned one included
+    dalp::Model make_triangle_soup(const size_t count, const uint32_t seed) {
+        std::mt19937 rng{ seed };
+        std::uniform_real_distribution<float> pos_dist{ -50, 50 };
+        std::uniform_real_distribution<float> offset_dist{ -2, 2 };
+
+        dalp::Model model;
+        auto& unit = model.units_indexed_.emplace_back();
+        auto& unit_joint = model.units_indexed_joint_.emplace_back();
+
+        for (size_t i = 0; i < count; ++i) {
+            const glm::vec3 center{ pos_dist(rng),
+                                    pos_dist(rng),
+                                    pos_dist(rng) };
+            for (int v = 0; v < 3; ++v) {
+                const glm::vec3 offset{ offset_dist(rng),
+                                        offset_dist(rng),
+                                        offset_dist(rng) };
+                if (i % 2) {
+                    auto& vert = unit.mesh_.vertices_.emplace_back();
+                    vert.pos_ = center + offset;
+                    unit.mesh_.indices_.push_back(
+                        unit.mesh_.vertices_.size() - 1
+                    );
+                } else {
+                    auto& vert = unit_joint.mesh_.vertices_.emplace_back();
+                    vert.pos_ = center + offset;
+                    unit_joint.mesh_.indices_.push_back(
+                        unit_joint.mesh_.vertices_.size() - 1
+                    );
+                }
+            }
+        }
+
+        return model;
+    }
+
+    struct Ray {
+        glm::vec3 origin_;
+        glm::vec3 dir_;
+    };
+
+    std::vector<Ray> make_rays(const size_t count, const uint32_t seed) {
+        std::mt19937 rng{ seed };
+        std::uniform_real_distribution<float> pos_dist{ -60, 60 };
+
+        std::vector<Ray> output;
+        for (size_t i = 0; i < count; ++i) {
+            auto& ray = output.emplace_back();
+            ray.origin_ = glm::vec3{ pos_dist(rng), pos_dist(rng), -80 };
+            const glm::vec3 target{ pos_dist(rng), pos_dist(rng), 80 };
+            ray.dir_ = glm::normalize(target - ray.origin_);
+        }
+        // Axis aligned directions exercise zero reciprocals
+        output.push_back({ glm::vec3(0, 0, -80), glm::vec3(0, 0, 1) });
+        output.push_back({ glm::vec3(-80, 0, 0), glm::vec3(1, 0, 0) });
+        return output;
+    }
+
+    template <typename _Mesh>
+    void brute_force_units(
+        const std::vector<dalp::RenderUnit<_Mesh>>& units,
+        const Ray& ray,
+        float& closest
+    ) {
+        for (auto& unit : units) {
+            const auto& mesh = unit.mesh_;
+            for (size_t i = 0; i < mesh.indices_.size(); i += 3) {
+                const auto p0 = mesh.vertices_[mesh.indices_[i + 0]].pos_;
+                const auto p1 = mesh.vertices_[mesh.indices_[i + 1]].pos_;
+                const auto p2 = mesh.vertices_[mesh.indices_[i + 2]].pos_;
+
+                const auto e1 = p1 - p0, e2 = p2 - p0;
+                const auto pvec = glm::cross(ray.dir_, e2);
+                const auto det = glm::dot(e1, pvec);
+                if (std::abs(det) < 1e-12f)
+                    continue;
+                const auto tvec = ray.origin_ - p0;
+                const auto u = glm::dot(tvec, pvec) / det;
+                const auto qvec = glm::cross(tvec, e1);
+                const auto v = glm::dot(ray.dir_, qvec) / det;
+                const auto t = glm::dot(e2, qvec) / det;
+                if (u >= 0 && v >= 0 && u + v <= 1 && t >= 0)
+                    closest = std::min(closest, t);
+            }
+        }
+    }
+
+    float brute_force(const dalp::Model& model, const Ray& ray) {
+        auto closest = std::numeric_limits<float>::infinity();
+        ::brute_force_units(model.units_indexed_, ray, closest);
+        ::brute_force_units(model.units_indexed_joint_, ray, closest);
+        return closest;
+    }
+
+
+    TEST(DaltestBvh, MatchesBruteForce) {
+        auto model = ::make_triangle_soup(3001, 5);
+        model.bvh_ = dalp::build_bvh(model);
+        ASSERT_TRUE(dalp::is_valid_bvh(model.bvh_, model));
+        ASSERT_EQ(model.bvh_.triangles_.size(), 3001);
+
+        size_t hit_count = 0;
+        for (auto& ray : ::make_rays(2000, 9)) {
+            const auto expected = ::brute_force(model, ray);
+            const auto hit = dalp::intersect_closest(
+                model, ray.origin_, ray.dir_, 1000
+            );
+            ASSERT_EQ(hit.has_value(), expected < 1000);
+            ASSERT_EQ(
+                dalp::intersect_any(model, ray.origin_, ray.dir_, 1000),
+                hit.has_value()
+            );
+            if (!hit.has_value())
+                continue;
+
+            ++hit_count;
+            ASSERT_NEAR(hit->distance_, expected, 1e-3f);
+
+            // Reported triangle and barycentrics give back the hit point
+            const auto& tri = hit->triangle_;
+            const auto index_of = [&](const auto& mesh, const int i) {
+                return mesh.indices_[3 * size_t{ tri.triangle_ } + i];
+            };
+            glm::vec3 p[3];
+            for (int i = 0; i < 3; ++i) {
+                if (tri.unit_ < model.units_indexed_.size()) {
+                    const auto& mesh = model.units_indexed_[tri.unit_].mesh_;
+                    p[i] = mesh.vertices_[index_of(mesh, i)].pos_;
+                } else {
+                    const auto& mesh = model.units_indexed_joint_[0].mesh_;
+                    p[i] = mesh.vertices_[index_of(mesh, i)].pos_;
+                }
+            }
+            const auto& b = hit->barycentric_;
+            const auto point = p[0] * (1 - b.x - b.y) + p[1] * b.x +
+                               p[2] * b.y;
+            const auto expected_point = ray.origin_ +
+                                        ray.dir_ * hit->distance_;
+            ASSERT_LT(glm::length(point - expected_point), 1e-3f);
+
+            // Shorter than the closest hit misses
+            ASSERT_FALSE(dalp::intersect_any(
+                model, ray.origin_, ray.dir_, expected * 0.999f
+            ));
+        }
+        ASSERT_GT(hit_count, 100);
+    }
+
+    TEST(DaltestBvh, Degenerate) {
+        dalp::Model model;
+        model.bvh_ = dalp::build_bvh(model);
+        ASSERT_TRUE(model.bvh_.empty());
+        ASSERT_FALSE(dalp::intersect_closest(
+            model, glm::vec3(0), glm::vec3(0, 0, 1), 10
+        ));
+
+        // Identical triangles can't be split by SAH
+        auto& unit = model.units_indexed_.emplace_back();
+        for (int i = 0; i < 3; ++i) {
+            auto& vert = unit.mesh_.vertices_.emplace_back();
+            vert.pos_ = glm::vec3(i == 1, i == 2, 5);
+        }
+        for (int i = 0; i < 100; ++i)
+            unit.mesh_.indices_.insert(unit.mesh_.indices_.end(), { 0, 1, 2 });
+
+        dalp::BvhOptions options;
+        options.margin_ = 0.01f;
+        model.bvh_ = dalp::build_bvh(model, options);
+        ASSERT_TRUE(dalp::is_valid_bvh(model.bvh_, model));
+        ASSERT_EQ(model.bvh_.nodes_[0].min_.z, 5 - options.margin_);
+
+        const auto hit = dalp::intersect_closest(
+            model, glm::vec3(0.25f, 0.25f, 0), glm::vec3(0, 0, 1), 10
+        );
+        ASSERT_TRUE(hit.has_value());
+        ASSERT_FLOAT_EQ(hit->distance_, 5);
+
+        // Broken hierarchies are rejected
+        auto broken = model.bvh_;
+        broken.nodes_[0].offset_ = 1000;
+        ASSERT_FALSE(dalp::is_valid_bvh(broken, model));
+        broken = model.bvh_;
+        broken.triangles_[0].triangle_ = 100;
+        ASSERT_FALSE(dalp::is_valid_bvh(broken, model));
+    }
+
+    TEST(DaltestBvh, Benchmark) {
+        auto model = ::make_triangle_soup(100000, 1);
+
+        const auto build_start = std::chrono::steady_clock::now();
+        model.bvh_ = dalp::build_bvh(model);
+        const auto build_end = std::chrono::steady_clock::now();
+
+        const auto rays = ::make_rays(100000, 2);
+        size_t hit_count = 0;
+        for (auto& ray : rays) {
+            if (dalp::intersect_closest(model, ray.origin_, ray.dir_, 1000))
+                ++hit_count;
+        }
+        const auto trace_end = std::chrono::steady_clock::now();
+
+        using ms = std::chrono::duration<double, std::milli>;
+        std::cout << "    Built " << model.bvh_.nodes_.size() << " nodes in "
+                  << ms(build_end - build_start).count() << " ms\n"
+                  << "    " << rays.size() / ms(trace_end - build_end).count()
+                  << " closest hit rays per ms, " << hit_count << " hits\n";
+    }
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
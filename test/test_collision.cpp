@@ -0,0 +1,234 @@
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "daltools/dmd/exporter.h"
+#include "daltools/dmd/parser.h"
+#include "daltools/scene/collision.h"
+
+
+namespace {
+
+    namespace dalp = dal::parser;
+
+
+    std::vector<glm::vec3> make_cube_corners() {
+        std::vector<glm::vec3> output;
+        for (int i = 0; i < 8; ++i) {
+            output.emplace_back(
+                i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f, i & 4 ? 1.f : -1.f
+            );
+        }
+        return output;
+    }
+
+    // Every point is behind or on every face, and faces point away from the
+    // center
+    void check_hull(
+        const dalp::CollisionGeometry& hull,
+        const std::vector<glm::vec3>& points
+    ) {
+        ASSERT_EQ(hull.indices_.size() % 3, 0);
+        glm::vec3 center{ 0 };
+        for (auto& v : hull.vertices_) center += v;
+        center /= static_cast<float>(hull.vertices_.size());
+
+        for (size_t i = 0; i < hull.indices_.size(); i += 3) {
+            const auto& a = hull.vertices_[hull.indices_[i + 0]];
+            const auto& b = hull.vertices_[hull.indices_[i + 1]];
+            const auto& c = hull.vertices_[hull.indices_[i + 2]];
+            const auto n = glm::normalize(glm::cross(b - a, c - a));
+            EXPECT_LT(glm::dot(n, center - a), 0);
+            for (auto& p : points) EXPECT_LE(glm::dot(n, p - a), 1e-4f);
+        }
+    }
+
+    // Cuboid spanning `min` to `max` as a scene mesh
+    void add_box(
+        dalp::SceneIntermediate::Mesh& mesh,
+        const glm::vec3& min,
+        const glm::vec3& max
+    ) {
+        static const int quads[6][4] = {
+            { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 },
+            { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 },
+        };
+
+        for (auto& quad : quads) {
+            const int corners[6] = { quad[0], quad[1], quad[2],
+                                     quad[0], quad[2], quad[3] };
+            for (const auto c : corners) {
+                dalp::SceneIntermediate::Vertex vertex;
+                vertex.pos_ = glm::vec3{ c & 1 ? max.x : min.x,
+                                         c & 2 ? max.y : min.y,
+                                         c & 4 ? max.z : min.z };
+                mesh.add_vertex(vertex);
+            }
+        }
+    }
+
+}  // namespace
+
+
+TEST(DaltestCollision, CubeHull) {
+    auto points = ::make_cube_corners();
+    // Interior and face points must not become hull vertices
+    points.emplace_back(0, 0, 0);
+    points.emplace_back(0.5f, 1, 0.2f);
+
+    const auto hull = dalp::build_convex_hull(points);
+    EXPECT_EQ(hull.vertices_.size(), 8);
+    EXPECT_EQ(hull.indices_.size(), 12 * 3);
+    ::check_hull(hull, points);
+}
+
+TEST(DaltestCollision, HullLimits) {
+    std::mt19937 rng{ 7 };
+    std::normal_distribution<float> dist;
+    std::vector<glm::vec3> points;
+    for (int i = 0; i < 2000; ++i)
+        points.emplace_back(dist(rng), dist(rng), dist(rng));
+
+    const auto full = dalp::build_convex_hull(points);
+    ::check_hull(full, points);
+    EXPECT_GT(full.vertices_.size(), 16);
+
+    // All faces are triangles, so a closed hull has 2V - 4 of them
+    const auto capped = dalp::build_convex_hull(points, 16);
+    EXPECT_EQ(capped.vertices_.size(), 16);
+    EXPECT_EQ(capped.indices_.size(), (2 * 16 - 4) * 3);
+
+    std::vector<glm::vec3> flat;
+    for (int i = 0; i < 10; ++i) flat.emplace_back(i % 3, 0, i / 3);
+    EXPECT_TRUE(dalp::build_convex_hull(flat).empty());
+}
+
+TEST(DaltestCollision, DegenerateHullInput) {
+    std::vector<glm::vec3> line;
+    for (int i = 0; i < 10; ++i) line.emplace_back(i, 2 * i, -i);
+    EXPECT_TRUE(dalp::build_convex_hull(line).empty());
+
+    // Duplicates and points on edges and faces add nothing
+    auto cube = ::make_cube_corners();
+    for (int i = 0; i < 8; ++i) {
+        const auto t = -1 + i * 0.25f;
+        cube.emplace_back(t, -1, -1);
+        cube.emplace_back(1, t, 1);
+        cube.emplace_back(t, t, 1);
+        cube.push_back(cube[i]);
+    }
+    const auto hull = dalp::build_convex_hull(cube);
+    EXPECT_EQ(hull.vertices_.size(), 8);
+    EXPECT_EQ(hull.indices_.size(), 12 * 3);
+    ::check_hull(hull, cube);
+
+    // Nearly flat slabs, which make sliver faces along their rims. The hull
+    // stays closed, so all faces are triangles and there are 2V - 4 of them.
+    for (unsigned seed = 0; seed < 20; ++seed) {
+        std::mt19937 rng{ seed };
+        std::uniform_real_distribution<float> dist{ -1, 1 };
+        std::vector<glm::vec3> slab;
+        for (int i = 0; i < 50; ++i) {
+            const auto x = dist(rng), y = dist(rng), z = dist(rng);
+            slab.emplace_back(x, y, i % 7 == 0 ? z * 1e-3f : 0.f);
+        }
+
+        const auto flat = dalp::build_convex_hull(slab);
+        ASSERT_FALSE(flat.empty());
+        EXPECT_EQ(flat.indices_.size(), (2 * flat.vertices_.size() - 4) * 3);
+        for (size_t i = 0; i < flat.indices_.size(); i += 3) {
+            const auto& a = flat.vertices_[flat.indices_[i + 0]];
+            const auto& b = flat.vertices_[flat.indices_[i + 1]];
+            const auto& c = flat.vertices_[flat.indices_[i + 2]];
+            EXPECT_GT(glm::length(glm::cross(b - a, c - a)), 0);
+        }
+    }
+}
+
+
+TEST(DaltestCollision, BuildCollision) {
+    dalp::SceneIntermediate scene;
+    scene.meshes_.resize(3);
+
+    // L shape, which one hull covers poorly
+    scene.meshes_[0].name_ = "ell";
+    ::add_box(scene.meshes_[0], { 0, 0, 0 }, { 4, 1, 1 });
+    ::add_box(scene.meshes_[0], { 0, 1, 0 }, { 1, 4, 1 });
+
+    scene.meshes_[1].name_ = "floor";
+    for (auto& p : { glm::vec3{ 0, 0, 0 },
+                     glm::vec3{ 1, 0, 0 },
+                     glm::vec3{ 1, 0, -1 } }) {
+        dalp::SceneIntermediate::Vertex vertex;
+        vertex.pos_ = p;
+        scene.meshes_[1].add_vertex(vertex);
+    }
+
+    scene.meshes_[2].name_ = "skinned";
+    scene.meshes_[2].skeleton_name_ = "armature";
+    ::add_box(scene.meshes_[2], { 0, 0, 0 }, { 1, 1, 1 });
+
+    for (int i = 0; i < 3; ++i) {
+        auto& actor = scene.mesh_actors_.emplace_back();
+        actor.name_ = "actor" + std::to_string(i);
+        actor.transform_.pos_ = glm::vec3{ 10.f * i, 0, 0 };
+        actor.render_pairs_.push_back({ "ell", "" });
+        actor.render_pairs_.push_back({ "skinned", "" });
+    }
+    scene.mesh_actors_[2].render_pairs_.push_back({ "floor", "" });
+
+    dalp::CollisionOptions options;
+    options.shape_ = dalp::CollisionShape::convex_decomposition;
+    const auto col = dalp::build_collision(scene, options);
+
+    // Shared mesh once, skinned one skipped
+    ASSERT_EQ(col.meshes_.size(), 2);
+    ASSERT_EQ(col.actors_.size(), 3);
+    EXPECT_EQ(col.actors_[0].meshes_, std::vector<uint32_t>{ 0 });
+    EXPECT_EQ(col.actors_[2].meshes_, (std::vector<uint32_t>{ 0, 1 }));
+    EXPECT_FLOAT_EQ(col.actors_[1].transform_[3][0], 10);
+
+    EXPECT_GE(col.meshes_[0].hulls_.size(), 2);
+    EXPECT_TRUE(col.meshes_[0].trimesh_.empty());
+    // Flat so it falls back to a trimesh
+    EXPECT_TRUE(col.meshes_[1].hulls_.empty());
+    EXPECT_EQ(col.meshes_[1].trimesh_.indices_.size(), 3);
+
+    options.shape_ = dalp::CollisionShape::convex_hull;
+    const auto single = dalp::build_collision(scene, options);
+    EXPECT_EQ(single.meshes_[0].hulls_.size(), 1);
+
+    // Round trip
+    const auto bin = dalp::build_binary_collision(
+        col, dal::CompressMethod::brotli
+    );
+    ASSERT_TRUE(bin.has_value());
+    const auto parsed = dalp::parse_collision(bin->data(), bin->size());
+    ASSERT_TRUE(parsed.has_value());
+    ASSERT_EQ(parsed->meshes_.size(), col.meshes_.size());
+    for (size_t i = 0; i < col.meshes_.size(); ++i) {
+        auto& a = col.meshes_[i];
+        auto& b = parsed->meshes_[i];
+        EXPECT_EQ(a.name_, b.name_);
+        ASSERT_EQ(a.hulls_.size(), b.hulls_.size());
+        for (size_t j = 0; j < a.hulls_.size(); ++j) {
+            EXPECT_EQ(a.hulls_[j].vertices_, b.hulls_[j].vertices_);
+            EXPECT_EQ(a.hulls_[j].indices_, b.hulls_[j].indices_);
+        }
+        EXPECT_EQ(a.trimesh_.indices_, b.trimesh_.indices_);
+    }
+    ASSERT_EQ(parsed->actors_.size(), col.actors_.size());
+    EXPECT_EQ(parsed->actors_[2].meshes_, col.actors_[2].meshes_);
+    EXPECT_EQ(parsed->actors_[1].transform_, col.actors_[1].transform_);
+
+    // Wrong magic numbers
+    auto wrong = bin.value();
+    wrong[3] = 'm';
+    EXPECT_FALSE(dalp::parse_collision(wrong.data(), wrong.size()));
+}
+
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,188 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include <gtest/gtest.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "daltools/scene/culling.h"
+
+
+namespace {
+
+    namespace dalp = dal::parser;
+
+
+    glm::mat4 make_view_proj() {
+        const auto proj = glm::perspective(
+            glm::radians(60.f), 16.f / 9.f, 0.1f, 100.f
+        );
+        const auto view = glm::lookAt(
+            glm::vec3(0), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0)
+        );
+        return proj * view;
+    }
+
+    std::vector<glm::mat4> make_transforms(
+        const size_t count, const bool rotate, const uint32_t seed
+    ) {
+        std::mt19937 rng{ seed };
+        std::uniform_real_distribution<float> pos_dist{ -120, 120 };
+        std::uniform_real_distribution<float> scale_dist{ 0.5f, 4 };
+        std::uniform_real_distribution<float> angle_dist{ 0, 6.28f };
+
+        std::vector<glm::mat4> output;
+        for (size_t i = 0; i < count; ++i) {
+            const glm::vec3 pos{ pos_dist(rng), pos_dist(rng), pos_dist(rng) };
+            auto m = glm::translate(glm::mat4{ 1 }, pos);
+            if (rotate) {
+                const glm::vec3 axis{ pos_dist(rng), pos_dist(rng), 1 };
+                m = glm::rotate(m, angle_dist(rng), glm::normalize(axis));
+            }
+            m = glm::scale(m, glm::vec3(scale_dist(rng), scale_dist(rng), 1));
+            output.push_back(m);
+        }
+        return output;
+    }
+
+    // Culled only if all 8 corners are outside the same clip plane
+    bool is_visible_ref(
+        const glm::mat4& view_proj,
+        const glm::mat4& transform,
+        const dalp::AABB3& aabb
+    ) {
+        const auto mvp = view_proj * transform;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            for (const float sign : { -1.f, 1.f }) {
+                bool all_outside = true;
+                for (int c = 0; c < 8; ++c) {
+                    const glm::vec4 local{
+                        (c & 1) ? aabb.max_.x : aabb.min_.x,
+                        (c & 2) ? aabb.max_.y : aabb.min_.y,
+                        (c & 4) ? aabb.max_.z : aabb.min_.z,
+                        1,
+                    };
+                    const auto clip = mvp * local;
+                    if (sign * clip[axis] <= clip.w)
+                        all_outside = false;
+                }
+                if (all_outside)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    bool get_bit(const std::vector<uint64_t>& mask, const size_t i) {
+        return (mask[i / 64] >> (i % 64)) & 1;
+    }
+
+
+    TEST(DaltestCulling, MatchesReference) {
+        const auto view_proj = ::make_view_proj();
+        const dalp::AABB3 aabb{ glm::vec3(-1, -2, -0.5f), glm::vec3(1, 1, 2) };
+
+        // Not a multiple of any SIMD width, and several blocks
+        for (const bool rotate : { false, true }) {
+            const auto transforms = ::make_transforms(10003, rotate, 7);
+            dalp::InstanceTransforms instances;
+            for (auto& m : transforms) instances.push_back(m);
+            ASSERT_EQ(instances.size(), transforms.size());
+
+            std::vector<uint64_t> visible;
+            const auto count = dalp::cull_instances(
+                view_proj, instances, aabb, visible, 4
+            );
+            ASSERT_EQ(visible.size(), (transforms.size() + 63) / 64);
+
+            size_t ref_count = 0, set_count = 0;
+            for (size_t i = 0; i < transforms.size(); ++i) {
+                const auto ref = ::is_visible_ref(
+                    view_proj, transforms[i], aabb
+                );
+                const auto bit = ::get_bit(visible, i);
+                ref_count += ref ? 1 : 0;
+                set_count += bit ? 1 : 0;
+
+                // Exact for axis aligned boxes, conservative otherwise
+                if (rotate) {
+                    ASSERT_TRUE(bit || !ref);
+                } else {
+                    ASSERT_EQ(bit, ref);
+                }
+            }
+            ASSERT_EQ(count, set_count);
+            ASSERT_GT(ref_count, 0);
+            ASSERT_LT(count, transforms.size() / 4);
+
+            // Bits past the last instance stay clear
+            ASSERT_EQ(visible.back() >> (transforms.size() % 64), 0);
+        }
+    }
+
+    TEST(DaltestCulling, SphereIsConservative) {
+        const auto view_proj = ::make_view_proj();
+        const dalp::AABB3 aabb{ glm::vec3(-1), glm::vec3(1, 3, 1) };
+        dalp::BoundingSphere sphere;
+        sphere.center_ = (aabb.min_ + aabb.max_) * 0.5f;
+        sphere.radius_ = glm::length(aabb.max_ - aabb.min_) * 0.5f;
+
+        const auto transforms = ::make_transforms(5000, true, 3);
+        dalp::InstanceTransforms instances;
+        for (auto& m : transforms) instances.push_back(m);
+
+        std::vector<uint64_t> visible_box, visible_sphere;
+        const auto box_count = dalp::cull_instances(
+            view_proj, instances, aabb, visible_box
+        );
+        const auto sphere_count = dalp::cull_instances(
+            view_proj, instances, sphere, visible_sphere
+        );
+        ASSERT_GE(sphere_count, box_count);
+
+        for (size_t i = 0; i < transforms.size(); ++i) {
+            if (::is_visible_ref(view_proj, transforms[i], aabb)) {
+                ASSERT_TRUE(::get_bit(visible_sphere, i));
+            }
+        }
+        ASSERT_LT(sphere_count, transforms.size() / 3);
+    }
+
+    TEST(DaltestCulling, Benchmark) {
+        constexpr size_t INSTANCE_COUNT = 1 << 18;
+        constexpr int REPEAT = 20;
+
+        const auto view_proj = ::make_view_proj();
+        const dalp::AABB3 aabb{ glm::vec3(-1), glm::vec3(1) };
+        const auto transforms = ::make_transforms(INSTANCE_COUNT, true, 1);
+        dalp::InstanceTransforms instances;
+        instances.reserve(transforms.size());
+        for (auto& m : transforms) instances.push_back(m);
+
+        std::vector<uint64_t> visible;
+        for (const uint32_t threads : { 1u, 0u }) {
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < REPEAT; ++i)
+                dalp::cull_instances(
+                    view_proj, instances, aabb, visible, threads
+                );
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+
+            const auto ms =
+                std::chrono::duration<double, std::milli>(elapsed).count();
+            std::cout << "    " << dalp::culling_simd_name() << ", "
+                      << (threads ? "1 thread" : "all threads") << ": "
+                      << INSTANCE_COUNT * REPEAT / ms
+                      << " instances culled per ms\n";
+        }
+    }
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,772 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "daltools/common/byte_tool.h"
+#include "daltools/common/konst.h"
+#include "daltools/common/quantize.h"
+#include "daltools/dmd/exporter.h"
+#include "daltools/dmd/parser.h"
+#include "daltools/dmd/view.h"
+#include "daltools/scene/bvh.h"
+#include "daltools/scene/modifier.h"
+
+
+namespace {
+
+    namespace dalp = dal::parser;
+
+
+    dalp::Model make_test_model() {
+        dalp::Model model;
+
+        auto& unit = model.units_indexed_.emplace_back();
+        unit.name_ = "quad";
+        for (int i = 0; i < 4; ++i) {
+            auto& vert = unit.mesh_.vertices_.emplace_back();
+            vert.pos_ = glm::vec3(i % 2, i / 2, 0);
+            vert.normal_ = glm::vec3(0, 0, 1);
+            vert.uv_ = glm::vec2(i % 2, i / 2);
+        }
+        unit.mesh_.indices_ = { 0, 1, 2, 1, 3, 2 };
+
+        model.units_indexed_joint_.emplace_back().name_ = "empty";
+        return model;
+    }
+
+
+    TEST(DaltestDmdFormat, LodRoundTrip) {
+        auto model = ::make_test_model();
+        auto& lod = model.units_indexed_[0].mesh_.lods_.emplace_back();
+        lod.indices_ = { 0, 3, 2 };
+        lod.error_ = 0.25f;
+
+        for (auto method : { dal::CompressMethod::none,
+                             dal::CompressMethod::brotli }) {
+            const auto bin = dalp::build_binary_model(model, method);
+            ASSERT_TRUE(bin.has_value());
+
+            const auto parsed = dalp::parse_dmd(bin->data(), bin->size());
+            ASSERT_TRUE(parsed.has_value());
+            ASSERT_EQ(parsed->units_indexed_.size(), 1);
+
+            const auto& lods = parsed->units_indexed_[0].mesh_.lods_;
+            ASSERT_EQ(lods.size(), 1);
+            ASSERT_EQ(lods[0].indices_, lod.indices_);
+            ASSERT_EQ(lods[0].error_, lod.error_);
+            ASSERT_TRUE(parsed->units_indexed_joint_[0].mesh_.lods_.empty());
+        }
+    }
+
+    TEST(DaltestDmdFormat, NoSectionWithoutLods) {
+        auto model = ::make_test_model();
+        const auto plain = dalp::build_binary_model(
+            model, dal::CompressMethod::none
+        );
+
+        dalp::ModelExportConfig config;
+        config.comp_method_ = dal::CompressMethod::none;
+        config.unit_bounds_ = true;
+        const auto with_bounds = dalp::build_binary_model(model, config);
+
+        model.units_indexed_[0].mesh_.lods_.emplace_back().indices_ = {
+            0, 3, 2
+        };
+        const auto with_lods = dalp::build_binary_model(
+            model, dal::CompressMethod::none
+        );
+
+        ASSERT_TRUE(plain.has_value());
+        ASSERT_TRUE(with_bounds.has_value());
+        ASSERT_TRUE(with_lods.has_value());
+
+        // Each is the plain one plus exactly one section, so a default export
+        // ends with the core data like files that predate sections. The
+        // payload is compared skipping the size field.
+        constexpr auto PAYLOAD_OFFSET = dalp::MAGIC_NUMBER_SIZE + 4 + 8;
+        const std::pair<const std::vector<uint8_t>*, int32_t> cases[] = {
+            { &with_bounds.value(), dalp::DMD_SECTION_BOUNDS },
+            { &with_lods.value(), dalp::DMD_SECTION_LODS },
+        };
+        for (auto& [bin, tag] : cases) {
+            ASSERT_LT(plain->size() + 12, bin->size());
+            ASSERT_TRUE(std::equal(
+                plain->begin() + PAYLOAD_OFFSET,
+                plain->end(),
+                bin->begin() + PAYLOAD_OFFSET
+            ));
+
+            const auto section = bin->data() + plain->size();
+            EXPECT_EQ(dalp::make_int32(section), tag);
+            EXPECT_EQ(
+                plain->size() + 12 + dalp::make_int64(section + 4),
+                bin->size()
+            );
+        }
+    }
+
+    TEST(DaltestDmdFormat, UnknownSectionIsSkipped) {
+        const auto model = ::make_test_model();
+        auto bin = dalp::build_binary_model(model, dal::CompressMethod::none);
+        ASSERT_TRUE(bin.has_value());
+
+        // Uncompressed payload ends at the end of the file
+        dalp::BinaryDataArray section;
+        section.append_int32(dalp::make_dmd_section_tag("TEST"));
+        section.append_int64(5);
+        section.append_str("abcd");
+        bin->insert(
+            bin->end(), section.data(), section.data() + section.size()
+        );
+
+        const auto parsed = dalp::parse_dmd(bin->data(), bin->size());
+        ASSERT_TRUE(parsed.has_value());
+        ASSERT_EQ(parsed->units_indexed_[0].mesh_.indices_.size(), 6);
+
+        // Truncated section
+        bin->pop_back();
+        ASSERT_FALSE(dalp::parse_dmd(bin->data(), bin->size()).has_value());
+    }
+
+    TEST(DaltestDmdFormat, MeshletRoundTrip) {
+        auto model = ::make_test_model();
+        auto& set = model.units_indexed_[0].mesh_.meshlets_;
+        auto& meshlet = set.meshlets_.emplace_back();
+        meshlet.vertex_count_ = 4;
+        meshlet.triangle_count_ = 2;
+        meshlet.center_ = glm::vec3{ 0.5f, 0.5f, 0 };
+        meshlet.radius_ = 0.75f;
+        meshlet.cone_apex_ = glm::vec3{ 0.5f, 0.5f, -1 };
+        meshlet.cone_axis_ = glm::vec3{ 0, 0, 1 };
+        meshlet.cone_cutoff_ = 0.25f;
+        set.vertices_ = { 0, 1, 2, 3 };
+        set.triangles_ = { 0, 1, 2, 1, 3, 2 };
+
+        const auto bin = dalp::build_binary_model(
+            model, dal::CompressMethod::zip
+        );
+        ASSERT_TRUE(bin.has_value());
+        const auto parsed = dalp::parse_dmd(bin->data(), bin->size());
+        ASSERT_TRUE(parsed.has_value());
+
+        const auto& result = parsed->units_indexed_[0].mesh_.meshlets_;
+        ASSERT_EQ(result.vertices_, set.vertices_);
+        ASSERT_EQ(result.triangles_, set.triangles_);
+        ASSERT_EQ(result.meshlets_.size(), 1);
+        ASSERT_EQ(result.meshlets_[0].triangle_count_, 2);
+        ASSERT_EQ(result.meshlets_[0].radius_, 0.75f);
+        ASSERT_EQ(result.meshlets_[0].cone_apex_, meshlet.cone_apex_);
+        ASSERT_EQ(result.meshlets_[0].cone_cutoff_, 0.25f);
+    }
+
+    TEST(DaltestDmdFormat, Index16RoundTrip) {
+        auto model = ::make_test_model();
+
+        // Too many vertices for 16 bits
+        auto& big = model.units_indexed_.emplace_back().mesh_;
+        big.vertices_.resize(70000);
+        big.indices_ = { 0, 1, 69999 };
+
+        dalp::ModelExportConfig config;
+        config.comp_method_ = dal::CompressMethod::none;
+        config.compact_indices_ = true;
+        const auto bin = dalp::build_binary_model(model, config);
+        ASSERT_TRUE(bin.has_value());
+
+        // Old readers see an unknown compression method
+        const auto comp_field = dalp::make_int32(
+            bin->data() + dalp::MAGIC_NUMBER_SIZE
+        );
+        ASSERT_EQ(comp_field >> 16, 1);
+
+        const auto parsed = dalp::parse_dmd(bin->data(), bin->size());
+        ASSERT_TRUE(parsed.has_value());
+        const auto& small = parsed->units_indexed_[0].mesh_;
+        ASSERT_EQ(small.index_width_, 2);
+        ASSERT_EQ(small.indices_, model.units_indexed_[0].mesh_.indices_);
+        ASSERT_EQ(parsed->units_indexed_[1].mesh_.index_width_, 4);
+        ASSERT_EQ(parsed->units_indexed_[1].mesh_.indices_, big.indices_);
+
+        config.compact_indices_ = false;
+        const auto wide = dalp::build_binary_model(model, config);
+        ASSERT_TRUE(wide.has_value());
+        const auto parsed_wide = dalp::parse_dmd(wide->data(), wide->size());
+        ASSERT_EQ(parsed_wide->units_indexed_[0].mesh_.index_width_, 4);
+
+        // 2 bytes saved on each of 6 indices, 4 spent on each of 3 widths
+        ASSERT_EQ(wide->size() - 6 * 2, bin->size() - 3 * 4);
+    }
+
+    TEST(DaltestDmdFormat, QuantizeScalars) {
+        for (const float v : { 0.f, 1.f, -2.5f, 0.333f, 65504.f, 1e-6f }) {
+            const auto back = dal::half_to_float(dal::float_to_half(v));
+            ASSERT_NEAR(back, v, std::abs(v) / 1024 + 1e-7f);
+        }
+        ASSERT_EQ(dal::float_to_half(1), 0x3C00);
+        ASSERT_TRUE(std::isinf(dal::half_to_float(dal::float_to_half(1e6f))));
+
+        ASSERT_EQ(dal::encode_unorm16(-1, 0, 2), 0);
+        ASSERT_EQ(dal::encode_unorm16(3, 0, 2), 65535);
+        ASSERT_EQ(dal::decode_unorm16(65535, -1, 2), 2);
+
+        for (int i = 0; i < 64; ++i) {
+            const glm::vec3 n = glm::normalize(glm::vec3(
+                std::sin(i * 0.7f), std::cos(i * 1.3f), std::sin(i * 2.9f)
+            ));
+            const auto back = dal::decode_oct16(dal::encode_oct16(n));
+            ASSERT_GT(glm::dot(n, back), std::cos(0.01f));
+        }
+    }
+
+    TEST(DaltestDmdFormat, QuantizedRoundTrip) {
+        auto model = ::make_test_model();
+        auto& mesh = model.units_indexed_[0].mesh_;
+        mesh.vertices_[3].pos_ = glm::vec3(10, 0.1f, -3);
+        mesh.vertices_[3].normal_ = glm::normalize(glm::vec3(1, -2, -3));
+        mesh.vertices_[3].uv_ = glm::vec2(0.3f, 1.7f);
+
+        auto& skinned = model.units_indexed_joint_[0].mesh_;
+        auto& joint_vert = skinned.vertices_.emplace_back();
+        joint_vert.pos_ = glm::vec3(1, 2, 3);
+        joint_vert.normal_ = glm::vec3(0, -1, 0);
+        joint_vert.uv_ = glm::vec2(0.5f);
+        joint_vert.joint_weights_ = glm::vec4(0.75f, 0.25f, 0, 0);
+        joint_vert.joint_indices_ = glm::ivec4(3, 1, -1, -1);
+        skinned.indices_ = { 0, 0, 0 };
+
+        const auto plain = dalp::build_binary_model(
+            model, dal::CompressMethod::none
+        );
+
+        using Format = dalp::VertexFormat;
+        mesh.vertex_format_.pos_ = Format::Position::unorm16;
+        mesh.vertex_format_.normal_ = Format::Normal::oct16;
+        mesh.vertex_format_.uv_ = Format::Uv::unorm16;
+        skinned.vertex_format_.uv_ = Format::Uv::float16;
+
+        const auto error = dalp::measure_quantization_error(model);
+        const auto bin = dalp::build_binary_model(
+            model, dal::CompressMethod::none
+        );
+        ASSERT_TRUE(plain.has_value());
+        ASSERT_TRUE(bin.has_value());
+        ASSERT_LT(bin->size(), plain->size());
+
+        const auto comp_field = dalp::make_int32(
+            bin->data() + dalp::MAGIC_NUMBER_SIZE
+        );
+        ASSERT_EQ(comp_field >> 16, 2);
+
+        const auto parsed = dalp::parse_dmd(bin->data(), bin->size());
+        ASSERT_TRUE(parsed.has_value());
+
+        const auto& p_mesh = parsed->units_indexed_[0].mesh_;
+        ASSERT_EQ(p_mesh.vertex_format_.pos_, Format::Position::unorm16);
+        ASSERT_EQ(p_mesh.vertex_format_.uv_, Format::Uv::unorm16);
+        ASSERT_EQ(p_mesh.indices_, mesh.indices_);
+        ASSERT_EQ(p_mesh.index_width_, 4);
+        for (size_t i = 0; i < mesh.vertices_.size(); ++i) {
+            const auto& a = mesh.vertices_[i];
+            const auto& b = p_mesh.vertices_[i];
+            ASSERT_LE(glm::distance(a.pos_, b.pos_), error.pos_ + 1e-6f);
+            ASSERT_GT(glm::dot(a.normal_, b.normal_), 0.9999f);
+            ASSERT_NEAR(a.uv_.x, b.uv_.x, error.uv_ + 1e-6f);
+            ASSERT_NEAR(a.uv_.y, b.uv_.y, error.uv_ + 1e-6f);
+        }
+
+        // Bounds are exact at the corners
+        ASSERT_EQ(p_mesh.vertices_[3].pos_.x, 10);
+        ASSERT_EQ(p_mesh.vertices_[3].pos_.z, -3);
+
+        const auto& p_vert = parsed->units_indexed_joint_[0].mesh_.vertices_[0];
+        ASSERT_EQ(p_vert.pos_, joint_vert.pos_);
+        ASSERT_EQ(p_vert.uv_, joint_vert.uv_);
+        ASSERT_EQ(p_vert.joint_weights_, joint_vert.joint_weights_);
+        ASSERT_EQ(p_vert.joint_indices_, joint_vert.joint_indices_);
+
+        // 10 meters across in 16 bits
+        ASSERT_GT(error.pos_, 0);
+        ASSERT_LT(error.pos_, 0.001f);
+        ASSERT_LT(error.normal_deg_, 0.01f);
+    }
+
+    TEST(DaltestDmdFormat, SkinFormatRoundTrip) {
+        using Format = dalp::VertexFormat;
+
+        auto model = ::make_test_model();
+        auto& mesh = model.units_indexed_joint_[0].mesh_;
+        const std::array<glm::vec4, 3> weights{
+            glm::vec4(0.2f, 0.8f, 0, 0),
+            glm::vec4(0, 0, 0.3f, 0),
+            glm::vec4(0.333f, 0.333f, 0, 0.334f),
+        };
+        for (size_t i = 0; i < weights.size(); ++i) {
+            auto& vert = mesh.vertices_.emplace_back();
+            vert.pos_ = glm::vec3(i);
+            vert.joint_indices_ = glm::ivec4(4, 250, 0, 17);
+            vert.joint_weights_ = weights[i];
+        }
+        mesh.indices_ = { 0, 1, 2 };
+
+        mesh.vertex_format_.influences_ = 2;
+        mesh.vertex_format_.joint_index_ = Format::JointIndex::uint8;
+        mesh.vertex_format_.joint_weight_ = Format::JointWeight::unorm8;
+
+        auto full_model = model;
+        full_model.units_indexed_joint_[0].mesh_.vertex_format_ = {};
+        const auto full = dalp::build_binary_model(
+            full_model, dal::CompressMethod::none
+        );
+        const auto bin = dalp::build_binary_model(
+            model, dal::CompressMethod::none
+        );
+        ASSERT_TRUE(bin.has_value());
+
+        const auto comp_field = dalp::make_int32(
+            bin->data() + dalp::MAGIC_NUMBER_SIZE
+        );
+        ASSERT_EQ(comp_field >> 16, 3);
+
+        const auto parsed = dalp::parse_dmd(bin->data(), bin->size());
+        ASSERT_TRUE(parsed.has_value());
+        const auto& p_mesh = parsed->units_indexed_joint_[0].mesh_;
+        ASSERT_EQ(p_mesh.vertex_format_.influences_, 2);
+        ASSERT_EQ(
+            p_mesh.vertex_format_.joint_index_, Format::JointIndex::uint8
+        );
+
+        // Sorted by weight, and exactly one in 8 bits
+        const auto& v0 = p_mesh.vertices_[0];
+        ASSERT_EQ(v0.joint_indices_, glm::ivec4(250, 4, -1, -1));
+        const auto sum_255 = v0.joint_weights_[0] * 255 +
+                             v0.joint_weights_[1] * 255;
+        ASSERT_EQ(sum_255, 255);
+        ASSERT_NEAR(v0.joint_weights_[0], 0.8f, 0.5f / 255);
+        ASSERT_EQ(v0.joint_weights_[2], 0);
+
+        // Single influence is normalized
+        const auto& v1 = p_mesh.vertices_[1];
+        ASSERT_EQ(v1.joint_indices_, glm::ivec4(0, -1, -1, -1));
+        ASSERT_EQ(v1.joint_weights_, glm::vec4(1, 0, 0, 0));
+
+        // The third influence is dropped and the rest renormalized
+        const auto& v2 = p_mesh.vertices_[2];
+        ASSERT_EQ(v2.joint_indices_[0], 17);
+        ASSERT_NEAR(v2.joint_weights_[0] + v2.joint_weights_[1], 1, 1e-6f);
+
+        // 2 x (1 + 1) bytes instead of 32 per vertex, minus the vertex
+        // format and index width fields of both units
+        ASSERT_EQ(full->size() - bin->size(), 3 * (32 - 4) - 2 * (4 + 4));
+
+        mesh.vertices_[1].joint_indices_[2] = 255;
+        ASSERT_EQ(
+            dalp::build_binary_model(model, dal::CompressMethod::none),
+            std::nullopt
+        );
+    }
+
+    TEST(DaltestDmdFormat, BoundsRoundTrip) {
+        auto model = ::make_test_model();
+        dalp::compute_bounds(model);
+        ASSERT_EQ(model.aabb_.max_, glm::vec3(1, 1, 0));
+
+        dalp::ModelExportConfig config;
+        config.unit_bounds_ = true;
+        const auto bin = dalp::build_binary_model(model, config);
+        ASSERT_TRUE(bin.has_value());
+        const auto parsed = dalp::parse_dmd(bin->data(), bin->size());
+        ASSERT_TRUE(parsed.has_value());
+
+        ASSERT_EQ(parsed->aabb_.min_, model.aabb_.min_);
+        ASSERT_EQ(parsed->aabb_.max_, model.aabb_.max_);
+        const auto& unit = parsed->units_indexed_[0];
+        ASSERT_EQ(unit.aabb_.max_, glm::vec3(1, 1, 0));
+        ASSERT_EQ(unit.sphere_.center_, glm::vec3(0.5f, 0.5f, 0));
+        ASSERT_FLOAT_EQ(unit.sphere_.radius_, std::sqrt(0.5f));
+
+        const auto without = dalp::build_binary_model(
+            model, dal::CompressMethod::brotli
+        );
+        ASSERT_TRUE(without.has_value());
+        const auto parsed_without = dalp::parse_dmd(
+            without->data(), without->size()
+        );
+        ASSERT_EQ(parsed_without->aabb_.max_, model.aabb_.max_);
+        ASSERT_EQ(parsed_without->units_indexed_[0].sphere_.radius_, 0);
+    }
+
+    TEST(DaltestDmdFormat, BvhRoundTrip) {
+        auto model = ::make_test_model();
+        model.bvh_ = dalp::build_bvh(model);
+        ASSERT_FALSE(model.bvh_.empty());
+
+        const auto bin = dalp::build_binary_model(
+            model, dal::CompressMethod::brotli
+        );
+        ASSERT_TRUE(bin.has_value());
+        auto parsed = dalp::parse_dmd(bin->data(), bin->size());
+        ASSERT_TRUE(parsed.has_value());
+
+        const auto& bvh = parsed->bvh_;
+        ASSERT_EQ(bvh.nodes_.size(), model.bvh_.nodes_.size());
+        ASSERT_EQ(bvh.triangles_.size(), 2);
+        ASSERT_EQ(bvh.nodes_[0].max_, glm::vec3(1, 1, 0));
+
+        const auto hit = dalp::intersect_closest(
+            parsed.value(), glm::vec3(0.75f, 0.75f, 1), glm::vec3(0, 0, -1), 2
+        );
+        ASSERT_TRUE(hit.has_value());
+        ASSERT_FLOAT_EQ(hit->distance_, 1);
+        ASSERT_EQ(hit->triangle_.triangle_, 1);
+
+        // A hierarchy pointing past the triangles fails the whole parse
+        model.bvh_.nodes_[0].count_ = 3;
+        model.bvh_.nodes_.resize(1);
+        const auto broken = dalp::build_binary_model(
+            model, dal::CompressMethod::none
+        );
+        ASSERT_FALSE(dalp::parse_dmd(broken->data(), broken->size()));
+    }
+
+    TEST(DaltestDmdFormat, InstanceRoundTrip) {
+        auto model = ::make_test_model();
+        auto& instances = model.units_indexed_[0].instances_;
+        for (int i = 0; i < 3; ++i) {
+            auto& m = instances.emplace_back(1);
+            m[3] = glm::vec4(i, 2 * i, 0, 1);
+        }
+
+        const auto bin = dalp::build_binary_model(
+            model, dal::CompressMethod::none
+        );
+        ASSERT_TRUE(bin.has_value());
+
+        // Readers skipping the section would draw all at the origin
+        const auto comp_field = dalp::make_int32(
+            bin->data() + dalp::MAGIC_NUMBER_SIZE
+        );
+        ASSERT_EQ(comp_field >> 16, 4);
+
+        const auto parsed = dalp::parse_dmd(bin->data(), bin->size());
+        ASSERT_TRUE(parsed.has_value());
+        ASSERT_EQ(parsed->units_indexed_[0].instances_, instances);
+        ASSERT_TRUE(parsed->units_indexed_joint_[0].instances_.empty());
+    }
+
+
+    TEST(DaltestDmdFormat, StreamingRoundTrip) {
+        // Larger than the internal buffer of the streaming reader
+        dalp::Model model;
+        auto& unit = model.units_indexed_.emplace_back();
+        unit.name_ = "grid";
+        for (int i = 0; i < 100000; ++i) {
+            auto& vert = unit.mesh_.vertices_.emplace_back();
+            vert.pos_ = glm::vec3(i % 300, i / 300, std::sin(i * 0.01f));
+            vert.normal_ = glm::vec3(0, 0, 1);
+            vert.uv_ = glm::vec2(i % 7, i % 13);
+            unit.mesh_.indices_.push_back((i * 7919) % 100000);
+        }
+        auto& straight = model.units_straight_.emplace_back();
+        straight.name_ = "soup";
+        straight.mesh_.vertices_.assign(3 * 30000, 0.5f);
+        straight.mesh_.uv_coordinates_.assign(2 * 30000, 0.25f);
+        straight.mesh_.normals_.assign(3 * 30000, 1);
+
+        for (auto method : { dal::CompressMethod::zip,
+                             dal::CompressMethod::brotli }) {
+            const auto bin = dalp::build_binary_model(model, method);
+            ASSERT_TRUE(bin.has_value());
+
+            const auto parsed = dalp::parse_dmd(bin->data(), bin->size());
+            ASSERT_TRUE(parsed.has_value());
+            ASSERT_EQ(parsed->units_indexed_.size(), 1);
+            const auto& mesh = parsed->units_indexed_[0].mesh_;
+            EXPECT_EQ(mesh.indices_, unit.mesh_.indices_);
+            ASSERT_EQ(mesh.vertices_.size(), unit.mesh_.vertices_.size());
+            EXPECT_EQ(
+                mesh.vertices_.back().pos_, unit.mesh_.vertices_.back().pos_
+            );
+            ASSERT_EQ(parsed->units_straight_.size(), 1);
+            EXPECT_EQ(
+                parsed->units_straight_[0].mesh_.normals_,
+                straight.mesh_.normals_
+            );
+
+            // Stream ends in the middle of the vertices
+            dalp::Model truncated;
+            EXPECT_EQ(
+                dalp::parse_dmd(truncated, bin->data(), bin->size() / 2),
+                dalp::ModelParseResult::decompression_failed
+            );
+
+            auto corrupted = bin.value();
+            for (size_t i = 40; i < corrupted.size(); i += 97)
+                corrupted[i] ^= 0x5A;
+            EXPECT_NE(
+                dalp::parse_dmd(truncated, corrupted.data(), corrupted.size()),
+                dalp::ModelParseResult::success
+            );
+        }
+    }
+
+    TEST(DaltestDmdFormat, BulkVertexRoundTrip) {
+        // More vertices than one chunk of the skinned bulk path
+        dalp::Model model;
+        auto& unit = model.units_indexed_joint_.emplace_back();
+        for (int i = 0; i < 10000; ++i) {
+            auto& vert = unit.mesh_.vertices_.emplace_back();
+            vert.pos_ = glm::vec3(i, -i, 0.5f);
+            vert.normal_ = glm::vec3(0, 1, 0);
+            vert.uv_ = glm::vec2(i % 3, 0.25f);
+            vert.joint_indices_ = glm::ivec4(i % 7, 1, 2, dalp::NULL_JID);
+            vert.joint_weights_ = glm::vec4(0.5f, 0.25f, 0.25f, 0);
+            unit.mesh_.indices_.push_back(9999 - i);
+        }
+
+        for (auto method : { dal::CompressMethod::none,
+                             dal::CompressMethod::brotli }) {
+            const auto bin = dalp::build_binary_model(model, method);
+            ASSERT_TRUE(bin.has_value());
+            const auto parsed = dalp::parse_dmd(bin->data(), bin->size());
+            ASSERT_TRUE(parsed.has_value());
+
+            const auto& mesh = parsed->units_indexed_joint_.at(0).mesh_;
+            EXPECT_EQ(mesh.indices_, unit.mesh_.indices_);
+            ASSERT_EQ(mesh.vertices_.size(), unit.mesh_.vertices_.size());
+            for (size_t i = 0; i < mesh.vertices_.size(); ++i) {
+                const auto& a = mesh.vertices_[i];
+                const auto& b = unit.mesh_.vertices_[i];
+                ASSERT_EQ(a.pos_, b.pos_);
+                ASSERT_EQ(a.uv_, b.uv_);
+                ASSERT_EQ(a.joint_indices_, b.joint_indices_);
+                ASSERT_EQ(a.joint_weights_, b.joint_weights_);
+            }
+        }
+
+        // A vertex count larger than the rest of the payload
+        auto bin = dalp::build_binary_model(model, dal::CompressMethod::none);
+        ASSERT_TRUE(bin.has_value());
+        bin->resize(bin->size() / 2);
+        EXPECT_THROW(
+            dalp::parse_dmd(bin->data(), bin->size()), std::runtime_error
+        );
+    }
+
+    TEST(DaltestDmdFormat, FramedRoundTrip) {
+        dalp::Model model;
+        auto& unit = model.units_indexed_.emplace_back();
+        unit.name_ = "grid";
+        for (int i = 0; i < 50000; ++i) {
+            auto& vert = unit.mesh_.vertices_.emplace_back();
+            vert.pos_ = glm::vec3(i % 300, i / 300, std::sin(i * 0.01f));
+            vert.uv_ = glm::vec2(i % 7, i % 13);
+            unit.mesh_.indices_.push_back(i);
+        }
+
+        for (auto method : { dal::CompressMethod::zip,
+                             dal::CompressMethod::brotli }) {
+            dalp::ModelExportConfig config;
+            config.comp_method_ = method;
+            config.block_size_ = 64 * 1024;
+            const auto bin = dalp::build_binary_model(model, config);
+            ASSERT_TRUE(bin.has_value());
+            // `DMD_FRAMED_PAYLOAD` bit of the little endian int32
+            EXPECT_TRUE(bin->at(dalp::MAGIC_NUMBER_SIZE + 1) & 0x01);
+
+            // Blocks each way of threading decode the same
+            for (uint32_t threads : { 1u, 4u }) {
+                const auto parsed = dalp::parse_dmd(
+                    bin->data(), bin->size(), threads
+                );
+                ASSERT_TRUE(parsed.has_value());
+                ASSERT_EQ(parsed->units_indexed_.size(), 1);
+                const auto& mesh = parsed->units_indexed_[0].mesh_;
+                EXPECT_EQ(mesh.indices_, unit.mesh_.indices_);
+                ASSERT_EQ(mesh.vertices_.size(), unit.mesh_.vertices_.size());
+                EXPECT_EQ(
+                    mesh.vertices_.back().pos_,
+                    unit.mesh_.vertices_.back().pos_
+                );
+            }
+
+            // Stored size of the first block beyond the end
+            constexpr auto index_pos = dalp::MAGIC_NUMBER_SIZE + 12 + 16;
+            auto broken = bin.value();
+            broken[index_pos + 6] = 0x7F;
+            dalp::Model output;
+            EXPECT_EQ(
+                dalp::parse_dmd(output, broken.data(), broken.size()),
+                dalp::ModelParseResult::decompression_failed
+            );
+
+            // Ends in the middle of the blocks
+            EXPECT_EQ(
+                dalp::parse_dmd(output, bin->data(), bin->size() / 2),
+                dalp::ModelParseResult::decompression_failed
+            );
+        }
+    }
+
+    TEST(DaltestDmdFormat, TocSelectiveLoading) {
+        auto model = ::make_test_model();
+        model.aabb_.max_ = glm::vec3(1, 1, 0);
+        model.skeleton_.joints_.emplace_back().name_ = "root";
+        model.animations_.emplace_back().name_ = "idle";
+        model.units_indexed_[0].mesh_.lods_.emplace_back().indices_ = {
+            0, 3, 2
+        };
+        model.bvh_ = dalp::build_bvh(model);
+
+        dalp::ModelExportConfig config;
+        config.table_of_contents_ = true;
+        config.unit_bounds_ = true;
+        const auto bin = dalp::build_binary_model(model, config);
+        ASSERT_TRUE(bin.has_value());
+
+        // 7 core parts, and bounds, LODs and the BVH
+        const auto toc = dalp::parse_dmd_toc(bin->data(), bin->size());
+        ASSERT_TRUE(toc.has_value());
+        ASSERT_EQ(toc->size(), 10);
+        EXPECT_EQ(toc->at(1).tag_, dalp::DMD_SECTION_SKELETON);
+        EXPECT_EQ(toc->back().tag_, dalp::DMD_SECTION_BVH);
+        for (auto& entry : *toc)
+            EXPECT_LE(entry.offset_ + entry.stored_size_, bin->size());
+
+        const auto full = dalp::parse_dmd(bin->data(), bin->size());
+        ASSERT_TRUE(full.has_value());
+        EXPECT_EQ(full->aabb_.max_, model.aabb_.max_);
+        EXPECT_EQ(full->animations_.size(), 1);
+        ASSERT_EQ(full->units_indexed_.size(), 1);
+        EXPECT_EQ(full->units_indexed_[0].mesh_.indices_.size(), 6);
+        EXPECT_EQ(full->units_indexed_[0].mesh_.lods_.size(), 1);
+        EXPECT_FALSE(full->bvh_.empty());
+
+        dalp::DmdSectionMask mask;
+        mask.skeleton_ = true;
+        mask.animations_ = true;
+        const auto anim = dalp::parse_dmd_sections(
+            dal::BinDataView{ bin->data(), bin->size() }, mask
+        );
+        ASSERT_TRUE(anim.has_value());
+        ASSERT_EQ(anim->skeleton_.joints_.size(), 1);
+        EXPECT_EQ(anim->skeleton_.joints_[0].name_, "root");
+        ASSERT_EQ(anim->animations_.size(), 1);
+        EXPECT_EQ(anim->animations_[0].name_, "idle");
+        EXPECT_TRUE(anim->units_indexed_.empty());
+        EXPECT_TRUE(anim->bvh_.empty());
+
+        // Units without what extends them
+        mask = {};
+        mask.units_ = true;
+        const auto units = dalp::parse_dmd_sections(
+            dal::BinDataView{ bin->data(), bin->size() }, mask
+        );
+        ASSERT_TRUE(units.has_value());
+        ASSERT_EQ(units->units_indexed_.size(), 1);
+        EXPECT_TRUE(units->units_indexed_[0].mesh_.lods_.empty());
+        EXPECT_TRUE(units->bvh_.empty());
+        EXPECT_TRUE(units->skeleton_.joints_.empty());
+
+        // Files without a table give the same result
+        const auto old = dalp::build_binary_model(
+            model, dal::CompressMethod::brotli
+        );
+        ASSERT_TRUE(old.has_value());
+        EXPECT_TRUE(dalp::parse_dmd_toc(old->data(), old->size())->empty());
+        const auto old_units = dalp::parse_dmd_sections(
+            dal::BinDataView{ old->data(), old->size() }, mask
+        );
+        ASSERT_TRUE(old_units.has_value());
+        EXPECT_EQ(old_units->units_indexed_.size(), 1);
+        EXPECT_TRUE(old_units->units_indexed_[0].mesh_.lods_.empty());
+        EXPECT_TRUE(old_units->animations_.empty());
+
+        // A table pointing past the end
+        auto broken = bin.value();
+        broken[dalp::MAGIC_NUMBER_SIZE + 12 + 8] = 0xFF;
+        broken[dalp::MAGIC_NUMBER_SIZE + 12 + 9] = 0xFF;
+        broken[dalp::MAGIC_NUMBER_SIZE + 12 + 10] = 0xFF;
+        EXPECT_FALSE(dalp::parse_dmd_toc(broken.data(), broken.size()));
+        EXPECT_FALSE(dalp::parse_dmd(broken.data(), broken.size()));
+    }
+
+    TEST(DaltestDmdFormat, ModelViewRoundTrip) {
+        auto model = ::make_test_model();
+        ASSERT_FALSE(dalp::build_binary_model_view(model).has_value());
+        model.units_indexed_joint_.clear();
+
+        auto& big = model.units_indexed_.emplace_back();
+        big.name_ = "big";
+        big.material_.name_ = "stone";
+        big.material_.albedo_map_ = "stone.ktx";
+        big.material_.roughness_ = 0.75f;
+        big.material_.transparency_ = true;
+        big.instances_.emplace_back(1)[3] = glm::vec4(1, 2, 3, 1);
+        for (uint32_t i = 0; i < 70000; ++i) {
+            big.mesh_.vertices_.emplace_back().pos_ = glm::vec3(i, 0, 0);
+            big.mesh_.indices_.push_back(i);
+        }
+        dalp::compute_bounds(model);
+
+        const auto bin = dalp::build_binary_model_view(model, true);
+        ASSERT_TRUE(bin.has_value());
+        ASSERT_EQ(bin->size() % 16, 0);
+        // Heap blocks are 16 byte aligned like mapped pages
+        const auto view = dalp::ModelView::open(bin->data(), bin->size());
+        ASSERT_TRUE(view.has_value());
+        ASSERT_EQ(view->unit_count(), 2);
+        ASSERT_EQ(view->aabb().max_, model.aabb_.max_);
+
+        const auto quad = view->unit(0);
+        const auto& src_quad = model.units_indexed_[0];
+        ASSERT_EQ(quad.name_, "quad");
+        ASSERT_TRUE(quad.material_.name_.empty());
+        ASSERT_EQ(quad.vertices_.size(), 4);
+        ASSERT_EQ(0, reinterpret_cast<uintptr_t>(quad.vertices_.data()) % 16);
+        ASSERT_TRUE(std::equal(
+            quad.vertices_.begin(),
+            quad.vertices_.end(),
+            src_quad.mesh_.vertices_.begin()
+        ));
+        ASSERT_TRUE(quad.indices32_.empty());
+        ASSERT_TRUE(std::equal(
+            quad.indices16_.begin(),
+            quad.indices16_.end(),
+            src_quad.mesh_.indices_.begin()
+        ));
+        ASSERT_TRUE(quad.instances_.empty());
+
+        // Too many vertices for 16-bit indices
+        const auto unit = view->unit(1);
+        ASSERT_EQ(unit.material_.name_, "stone");
+        ASSERT_STREQ(unit.material_.albedo_map_.data(), "stone.ktx");
+        ASSERT_EQ(unit.material_.roughness_, 0.75f);
+        ASSERT_TRUE(unit.material_.transparency_);
+        ASSERT_EQ(unit.sphere_.radius_, big.sphere_.radius_);
+        ASSERT_TRUE(unit.indices16_.empty());
+        ASSERT_EQ(unit.indices32_.size(), 70000);
+        ASSERT_EQ(unit.indices32_[69999], 69999);
+        ASSERT_EQ(unit.vertices_[123].pos_.x, 123);
+        ASSERT_EQ(unit.instances_.size(), 1);
+        ASSERT_EQ(unit.instances_[0], big.instances_[0]);
+
+        // Truncated, misaligned, or not a view file
+        ASSERT_FALSE(dalp::ModelView::open(bin->data(), bin->size() - 16));
+        std::vector<uint8_t> shifted(bin->size() + 1);
+        std::copy(bin->begin(), bin->end(), shifted.begin() + 1);
+        ASSERT_FALSE(dalp::ModelView::open(shifted.data() + 1, bin->size()));
+        const auto dmd = dalp::build_binary_model(
+            model, dal::CompressMethod::none
+        );
+        ASSERT_FALSE(dalp::ModelView::open(dmd->data(), dmd->size()));
+    }
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
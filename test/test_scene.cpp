@@ -0,0 +1,954 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "daltools/scene/modifier.h"
+#include "daltools/scene/tiling.h"
+
+
+namespace {
+
+    namespace dalp = dal::parser;
+
+
+    template <typename _Vertex>
+    dalp::TMesh_Indexed<_Vertex> add_vertices_naive(
+        const std::vector<_Vertex>& vertices
+    ) {
+        dalp::TMesh_Indexed<_Vertex> output;
+
+        for (auto& vert : vertices) {
+            bool found = false;
+            for (size_t i = 0; i < output.vertices_.size(); ++i) {
+                if (vert == output.vertices_[i]) {
+                    output.indices_.push_back(i);
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found) {
+                output.indices_.push_back(output.vertices_.size());
+                output.vertices_.push_back(vert);
+            }
+        }
+
+        return output;
+    }
+
+    std::vector<dalp::Vertex> gen_vertices(size_t count, int distinct) {
+        std::mt19937 rng{ 1234 };
+        std::uniform_int_distribution<int> dist{ 0, distinct - 1 };
+
+        std::vector<dalp::Vertex> output(count);
+        for (auto& vert : output) {
+            const auto v = static_cast<float>(dist(rng));
+            vert.pos_ = glm::vec3{ v, v * 2, -v };
+            vert.normal_ = glm::vec3{ 0, 1, 0 };
+            vert.uv_ = glm::vec2{ v * 0.5f, 0 };
+        }
+        return output;
+    }
+
+
+    TEST(DaltestScene, WeldIndexKeepsOrder) {
+        const auto vertices = ::gen_vertices(5000, 300);
+        const auto expected = ::add_vertices_naive(vertices);
+
+        dalp::Mesh_Indexed mesh;
+        dalp::TVertexWeldIndex<dalp::Vertex> index;
+        for (auto& vert : vertices) mesh.add_vertex(vert, index);
+
+        ASSERT_EQ(mesh.vertices_, expected.vertices_);
+        ASSERT_EQ(mesh.indices_, expected.indices_);
+    }
+
+    TEST(DaltestScene, WeldIndexSignedZeroAndNan) {
+        const auto nan = std::numeric_limits<float>::quiet_NaN();
+
+        dalp::Vertex a;
+        a.pos_ = glm::vec3{ 0, 0, 0 };
+        a.normal_ = glm::vec3{ 0, 0, 1 };
+        a.uv_ = glm::vec2{ 0, 0 };
+
+        auto b = a;
+        b.pos_.x = -0.f;
+
+        auto c = a;
+        c.uv_.y = nan;
+
+        dalp::Mesh_Indexed mesh;
+        dalp::TVertexWeldIndex<dalp::Vertex> index;
+        for (auto& v : { a, b, c, c }) mesh.add_vertex(v, index);
+
+        // NaN never compares equal, same as the linear scan
+        const auto expected = ::add_vertices_naive(
+            std::vector<dalp::Vertex>{ a, b, c, c }
+        );
+        ASSERT_EQ(mesh.indices_, expected.indices_);
+        ASSERT_EQ(mesh.vertices_.size(), 3);
+    }
+
+    TEST(DaltestScene, WeldIndexBuildFromExisting) {
+        const auto vertices = ::gen_vertices(1000, 50);
+
+        // Filled directly, like the DMD parser does
+        dalp::Mesh_Indexed mesh;
+        mesh.vertices_ = ::add_vertices_naive(vertices).vertices_;
+        const auto vertex_count = mesh.vertices_.size();
+
+        dalp::TVertexWeldIndex<dalp::Vertex> index;
+        index.build_from(mesh.vertices_);
+        for (auto& vert : vertices) mesh.add_vertex(vert, index);
+        ASSERT_EQ(mesh.vertices_.size(), vertex_count);
+
+        // Edited in place after welding, which needs no bookkeeping since
+        // meshes don't keep an index
+        mesh.vertices_[0].pos_.x += 100;
+        dalp::Mesh_Indexed other;
+        other.add_vertex(vertices.front());
+        mesh.concat(other);
+        ASSERT_EQ(mesh.vertices_.size(), vertex_count + 1);
+        ASSERT_EQ(mesh.indices_.back(), vertex_count);
+
+        // Moved into an empty mesh without copying
+        dalp::Mesh_Indexed moved;
+        dalp::TVertexWeldIndex<dalp::Vertex> moved_index;
+        const auto buffer = mesh.vertices_.data();
+        moved.concat(std::move(mesh), moved_index);
+        ASSERT_EQ(moved.vertices_.data(), buffer);
+        ASSERT_EQ(moved.vertices_.size(), vertex_count + 1);
+        moved.add_vertex(vertices.back(), moved_index);
+        ASSERT_EQ(moved.vertices_.size(), vertex_count + 1);
+    }
+
+    TEST(DaltestScene, SceneMeshJointAwareDedup) {
+        using scene_t = dalp::SceneIntermediate;
+
+        scene_t::Vertex a;
+        a.pos_ = glm::vec3{ 1, 2, 3 };
+        a.normal_ = glm::vec3{ 0, 1, 0 };
+        a.uv_ = glm::vec2{ 0.5, 0.5 };
+        a.joints_.push_back({ 3, 0.75f });
+        a.joints_.push_back({ 5, 0.25f });
+
+        auto b = a;
+        b.joints_.pop_back();
+
+        auto c = a;
+        c.joints_[1].index_ = 6;
+
+        scene_t::Mesh mesh;
+        dalp::TVertexWeldIndex<scene_t::Vertex> index;
+        mesh.reserve(6);
+        for (auto& v : { a, b, c, a, b, c }) mesh.add_vertex(v, index);
+
+        ASSERT_EQ(mesh.vertices_.size(), 3);
+        const std::vector<size_t> expected{ 0, 1, 2, 0, 1, 2 };
+        ASSERT_EQ(mesh.indices_, expected);
+
+        scene_t::Mesh merged;
+        merged.add_vertex(c);
+        merged.concat(mesh);
+        ASSERT_EQ(merged.vertices_.size(), 3);
+        ASSERT_EQ(merged.indices_.size(), 7);
+        ASSERT_EQ(merged.indices_[3], 0);
+
+        // Edited in place, then merged again
+        merged.vertices_[0].joints_[1].index_ = 7;
+        merged.concat(mesh);
+        ASSERT_EQ(merged.vertices_.size(), 4);
+        ASSERT_EQ(merged.indices_.back(), 3);
+    }
+
+    TEST(DaltestScene, ToleranceWelding) {
+        using scene_t = dalp::SceneIntermediate;
+
+        scene_t scene;
+        auto& mesh = scene.meshes_.emplace_back();
+        std::mt19937 rng{ 42 };
+        std::uniform_real_distribution<float> noise{ -1e-6f, 1e-6f };
+
+        // A grid of 20x20 points, each duplicated 3 times with float noise
+        for (int i = 0; i < 3; ++i) {
+            for (int x = 0; x < 20; ++x) {
+                for (int y = 0; y < 20; ++y) {
+                    auto& vert = mesh.vertices_.emplace_back();
+                    vert.pos_ = glm::vec3{ x + noise(rng), y + noise(rng), 0 };
+                    vert.normal_ = glm::vec3{ 0, 0, 1 };
+                    vert.uv_ = glm::vec2{ x * 0.05f, y * 0.05f + noise(rng) };
+                    mesh.indices_.push_back(mesh.indices_.size());
+                }
+            }
+        }
+
+        dalp::VertexWeldTolerance tolerance;
+        tolerance.pos_ = 1e-4f;
+        tolerance.uv_ = 1e-4f;
+        dalp::weld_vertices(scene, tolerance);
+
+        ASSERT_EQ(mesh.vertices_.size(), 400);
+        ASSERT_EQ(mesh.indices_.size(), 1200);
+        for (size_t i = 0; i < 400; ++i) {
+            ASSERT_EQ(mesh.indices_[i], i);
+            ASSERT_EQ(mesh.indices_[i + 400], i);
+            ASSERT_EQ(mesh.indices_[i + 800], i);
+        }
+    }
+
+    TEST(DaltestScene, ToleranceWeldingNan) {
+        using scene_t = dalp::SceneIntermediate;
+        const auto nan = std::numeric_limits<float>::quiet_NaN();
+
+        scene_t scene;
+        auto& mesh = scene.meshes_.emplace_back();
+        for (int i = 0; i < 7; ++i) {
+            auto& vert = mesh.vertices_.emplace_back();
+            vert.normal_ = glm::vec3{ 0, 0, 1 };
+            mesh.indices_.push_back(i);
+        }
+        // Same position as vertex 0 but NaN elsewhere
+        mesh.vertices_[1].uv_.x = nan;
+        mesh.vertices_[2].normal_.y = nan;
+        mesh.vertices_[3].pos_.z = nan;
+        mesh.vertices_[4].pos_ = glm::vec3{ nan };
+        mesh.vertices_[5].joints_.push_back({ 0, 1 });
+        mesh.vertices_[6].joints_.push_back({ 0, nan });
+
+        dalp::VertexWeldTolerance tolerance;
+        tolerance.pos_ = 1e-3f;
+        dalp::weld_vertices(scene, tolerance);
+
+        // Nothing welds, not even NaN vertices to each other
+        ASSERT_EQ(mesh.vertices_.size(), 7);
+        for (size_t i = 0; i < 7; ++i) ASSERT_EQ(mesh.indices_[i], i);
+    }
+
+    TEST(DaltestScene, ParallelConvertKeepsOrder) {
+        std::vector<dalp::RenderUnit<dalp::Mesh_Straight>> units(37);
+        for (size_t i = 0; i < units.size(); ++i) {
+            auto& unit = units[i];
+            unit.name_ = std::to_string(i);
+            for (size_t j = 0; j < 3 * (i + 1); ++j) {
+                const auto v = static_cast<float>(j % (i + 2));
+                unit.mesh_.vertices_.insert(
+                    unit.mesh_.vertices_.end(), { v, 0, 0 }
+                );
+                unit.mesh_.normals_.insert(
+                    unit.mesh_.normals_.end(), { 0, 0, 1 }
+                );
+                unit.mesh_.uv_coordinates_.insert(
+                    unit.mesh_.uv_coordinates_.end(), { 0, v }
+                );
+            }
+        }
+
+        const auto converted = dalp::convert_to_indexed(units, 4);
+        ASSERT_EQ(converted.size(), units.size());
+        for (size_t i = 0; i < units.size(); ++i) {
+            const auto expected = dalp::convert_to_indexed(units[i].mesh_);
+            ASSERT_EQ(converted[i].name_, units[i].name_);
+            ASSERT_EQ(converted[i].mesh_.vertices_, expected.vertices_);
+            ASSERT_EQ(converted[i].mesh_.indices_, expected.indices_);
+        }
+    }
+
+    TEST(DaltestScene, ConcatMatchesAddVertex) {
+        const auto vertices = ::gen_vertices(3000, 400);
+
+        std::vector<dalp::RenderUnit<dalp::Mesh_Indexed>> units(6);
+        for (size_t i = 0; i < vertices.size(); ++i)
+            units[i % 3 + (i % 2) * 3].mesh_.add_vertex(vertices[i]);
+        units[4].material_.roughness_ = 1;
+
+        std::vector<dalp::Mesh_Indexed> expected(2);
+        for (size_t i = 0; i < units.size(); ++i) {
+            auto& dst = expected[4 == i ? 1 : 0];
+            for (auto index : units[i].mesh_.indices_)
+                dst.add_vertex(units[i].mesh_.vertices_[index]);
+        }
+
+        const auto merged_copy = dalp::merge_by_material(units);
+        const auto merged_move = dalp::merge_by_material(std::move(units));
+
+        for (auto merged : { &merged_copy, &merged_move }) {
+            ASSERT_EQ(merged->size(), 2);
+            for (size_t i = 0; i < 2; ++i) {
+                const auto& mesh = merged->at(i).mesh_;
+                ASSERT_EQ(mesh.vertices_, expected[i].vertices_);
+                ASSERT_EQ(mesh.indices_, expected[i].indices_);
+            }
+        }
+    }
+
+    TEST(DaltestScene, VertexCacheOptimization) {
+        constexpr uint32_t GRID = 64;
+
+        // Triangles of a grid in random order, which is the worst case
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (uint32_t y = 0; y < GRID; ++y) {
+            for (uint32_t x = 0; x < GRID; ++x) {
+                const auto i = y * (GRID + 1) + x;
+                triangles.push_back({ i, i + 1, i + GRID + 1 });
+                triangles.push_back({ i + 1, i + GRID + 2, i + GRID + 1 });
+            }
+        }
+        std::shuffle(triangles.begin(), triangles.end(), std::mt19937{ 7 });
+
+        std::vector<uint32_t> indices;
+        for (auto& tri : triangles)
+            indices.insert(indices.end(), tri.begin(), tri.end());
+
+        const auto vertex_count = (GRID + 1) * (GRID + 1);
+        const auto before = dalp::analyze_vertex_cache(indices, vertex_count);
+        auto optimized = indices;
+        dalp::optimize_vertex_cache(optimized, vertex_count);
+        const auto after = dalp::analyze_vertex_cache(optimized, vertex_count);
+
+        ASSERT_EQ(after.triangle_count_, before.triangle_count_);
+        ASSERT_EQ(after.vertex_count_, vertex_count);
+        ASSERT_LT(after.acmr(), 1.0);
+        ASSERT_LT(after.acmr(), before.acmr() * 0.5);
+
+        // Without a cache every index is a transform
+        const auto uncached = dalp::analyze_vertex_cache(
+            optimized, vertex_count, 0
+        );
+        ASSERT_EQ(uncached.transform_count_, optimized.size());
+
+        // Same set of triangles, winding preserved
+        std::vector<std::array<uint32_t, 3>> result;
+        for (size_t i = 0; i < optimized.size(); i += 3) {
+            auto& tri = result.emplace_back();
+            std::copy_n(optimized.begin() + i, 3, tri.begin());
+        }
+        std::sort(triangles.begin(), triangles.end());
+        std::sort(result.begin(), result.end());
+        ASSERT_EQ(result, triangles);
+    }
+
+    TEST(DaltestScene, MeshCleanup) {
+        dalp::Model model;
+        auto& mesh = model.units_indexed_.emplace_back().mesh_;
+
+        mesh.vertices_.resize(6);
+        mesh.vertices_[0].pos_ = glm::vec3{ 0, 0, 0 };
+        mesh.vertices_[1].pos_ = glm::vec3{ 1, 0, 0 };
+        mesh.vertices_[2].pos_ = glm::vec3{ 0, 1, 0 };
+        mesh.vertices_[3].pos_ = glm::vec3{ 5, 5, 5 };  // Unused
+        mesh.vertices_[4].pos_ = glm::vec3{ 2, 0, 0 };  // Collinear
+        mesh.vertices_[5].pos_ = glm::vec3{ 1, 0, 0 };  // Welded onto 1
+        mesh.vertices_[5].uv_ = glm::vec2{ 1, 1 };
+        mesh.indices_ = {
+            2, 1, 0,  // Kept
+            0, 0, 1,  // Repeated index
+            0, 1, 4,  // Zero area
+            1, 5, 2,  // Zero area after welding
+            1, 0, 2,  // Same winding as the first
+            0, 1, 2,  // Opposite winding, kept
+        };
+
+        const auto report = dalp::cleanup_meshes(model);
+        ASSERT_EQ(report.degenerate_triangles_, 3);
+        ASSERT_EQ(report.duplicate_triangles_, 1);
+        ASSERT_EQ(report.unused_vertices_, 3);
+
+        const std::vector<uint32_t> expected{ 0, 1, 2, 2, 1, 0 };
+        ASSERT_EQ(mesh.indices_, expected);
+        ASSERT_EQ(mesh.vertices_.size(), 3);
+        ASSERT_EQ(mesh.vertices_[0].pos_, glm::vec3(0, 1, 0));
+        ASSERT_EQ(mesh.vertices_[2].pos_, glm::vec3(0, 0, 0));
+    }
+
+    template <typename _Vertex>
+    dalp::TMesh_Indexed<_Vertex> make_grid_mesh(const uint32_t size) {
+        dalp::TMesh_Indexed<_Vertex> mesh;
+
+        for (uint32_t y = 0; y <= size; ++y) {
+            for (uint32_t x = 0; x <= size; ++x) {
+                auto& vert = mesh.vertices_.emplace_back();
+                const auto fx = static_cast<float>(x) / size;
+                const auto fy = static_cast<float>(y) / size;
+                vert.pos_ = glm::vec3{ fx, fy, 0.01f * std::sin(fx * 6) };
+                vert.normal_ = glm::vec3{ 0, 0, 1 };
+                vert.uv_ = glm::vec2{ fx, fy };
+            }
+        }
+
+        for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) {
+                const auto i = y * (size + 1) + x;
+                const auto j = i + size + 1;
+                mesh.indices_.insert(
+                    mesh.indices_.end(), { i, i + 1, j, i + 1, j + 1, j }
+                );
+            }
+        }
+
+        return mesh;
+    }
+
+    TEST(DaltestScene, SimplifyKeepsBorders) {
+        const auto mesh = ::make_grid_mesh<dalp::Vertex>(40);
+        const auto lod = dalp::simplify_mesh(mesh, 0.25f, 0.05f);
+
+        const auto tri_count = mesh.indices_.size() / 3;
+        ASSERT_LE(lod.indices_.size() / 3, tri_count / 4);
+        ASSERT_LE(lod.error_, 0.05f);
+
+        std::vector<bool> used(mesh.vertices_.size(), false);
+        for (auto index : lod.indices_) {
+            ASSERT_LT(index, mesh.vertices_.size());
+            used[index] = true;
+        }
+
+        // Open borders stay where they are
+        for (uint32_t i = 0; i <= 40; ++i) {
+            ASSERT_TRUE(used[i]);
+            ASSERT_TRUE(used[40 * 41 + i]);
+        }
+
+        // No triangle is flipped
+        for (size_t i = 0; i < lod.indices_.size(); i += 3) {
+            const auto& p0 = mesh.vertices_[lod.indices_[i + 0]].pos_;
+            const auto& p1 = mesh.vertices_[lod.indices_[i + 1]].pos_;
+            const auto& p2 = mesh.vertices_[lod.indices_[i + 2]].pos_;
+            ASSERT_GT(glm::cross(p1 - p0, p2 - p0).z, 0);
+        }
+    }
+
+    TEST(DaltestScene, GenerateLodsSkinned) {
+        dalp::Model model;
+        auto& mesh = model.units_indexed_joint_.emplace_back().mesh_;
+        mesh = ::make_grid_mesh<dalp::VertexJoint>(32);
+        for (auto& vert : mesh.vertices_) {
+            vert.joint_indices_ = glm::ivec4{ 0, 1, -1, -1 };
+            const auto w = vert.pos_.x;
+            vert.joint_weights_ = glm::vec4{ w, 1 - w, 0, 0 };
+        }
+
+        dalp::LodOptions options;
+        options.ratios_ = { 0.5f, 0.25f };
+        dalp::generate_lods(model, options);
+
+        ASSERT_EQ(mesh.lods_.size(), 2);
+        ASSERT_LT(mesh.lods_[1].indices_.size(), mesh.lods_[0].indices_.size());
+        ASSERT_LE(mesh.lods_[0].error_, mesh.lods_[1].error_);
+
+        // Compaction must keep LODs pointing at the same vertices
+        const auto old_vertices = mesh.vertices_;
+        const auto old_lod = mesh.lods_[1].indices_;
+        dalp::optimize_vertex_fetch(mesh);
+        for (size_t i = 0; i < old_lod.size(); ++i) {
+            const auto& a = old_vertices[old_lod[i]];
+            const auto& b = mesh.vertices_[mesh.lods_[1].indices_[i]];
+            ASSERT_EQ(a, b);
+        }
+    }
+
+    TEST(DaltestScene, MeshletsCoverMesh) {
+        auto mesh = ::make_grid_mesh<dalp::Vertex>(40);
+        dalp::optimize_vertex_cache(mesh.indices_, mesh.vertices_.size());
+
+        dalp::MeshletOptions options;
+        options.max_vertices_ = 64;
+        options.max_triangles_ = 124;
+        const auto set = dalp::build_meshlets(mesh, options);
+
+        std::vector<std::array<uint32_t, 3>> expected, rebuilt;
+        for (size_t i = 0; i < mesh.indices_.size(); i += 3) {
+            auto& tri = expected.emplace_back();
+            std::copy_n(mesh.indices_.begin() + i, 3, tri.begin());
+        }
+
+        for (auto& m : set.meshlets_) {
+            ASSERT_LE(m.vertex_count_, options.max_vertices_);
+            ASSERT_LE(m.triangle_count_, options.max_triangles_);
+
+            for (uint32_t i = 0; i < m.vertex_count_; ++i) {
+                const auto v = set.vertices_[m.vertex_offset_ + i];
+                const auto& pos = mesh.vertices_[v].pos_;
+                ASSERT_LE(glm::distance(m.center_, pos), m.radius_ * 1.0001f);
+            }
+
+            for (uint32_t t = 0; t < m.triangle_count_; ++t) {
+                auto& tri = rebuilt.emplace_back();
+                for (int k = 0; k < 3; ++k) {
+                    const auto local =
+                        set.triangles_[m.triangle_offset_ + 3 * t + k];
+                    ASSERT_LT(local, m.vertex_count_);
+                    tri[k] = set.vertices_[m.vertex_offset_ + local];
+                }
+            }
+
+            // Nearly flat, so seen from far below everything is a backface
+            ASSERT_LT(m.cone_cutoff_, 1);
+            const glm::vec3 camera{ 0.5f, 0.5f, -100 };
+            const auto view = glm::normalize(m.cone_apex_ - camera);
+            ASSERT_GE(glm::dot(view, m.cone_axis_), m.cone_cutoff_);
+        }
+
+        std::sort(expected.begin(), expected.end());
+        std::sort(rebuilt.begin(), rebuilt.end());
+        ASSERT_EQ(rebuilt, expected);
+
+        // 40 triangles on average at least, a grid fits about 80
+        ASSERT_LT(set.meshlets_.size(), expected.size() / 40);
+    }
+
+    TEST(DaltestScene, SplitLargeUnits) {
+        dalp::Model model;
+        auto& unit = model.units_indexed_.emplace_back();
+        unit.name_ = "grid";
+        unit.material_.roughness_ = 0.3f;
+        unit.mesh_ = ::make_grid_mesh<dalp::Vertex>(40);
+        const auto original = unit.mesh_;
+
+        const auto added = dalp::split_large_units(model, 500);
+        ASSERT_GT(added, 0);
+        ASSERT_EQ(model.units_indexed_.size(), added + 1);
+        ASSERT_EQ(model.units_indexed_[1].name_, "grid#1");
+
+        size_t offset = 0;
+        for (auto& part : model.units_indexed_) {
+            ASSERT_LE(part.mesh_.vertices_.size(), 500);
+            ASSERT_EQ(part.material_.roughness_, 0.3f);
+
+            // Triangle order is kept across parts
+            for (auto index : part.mesh_.indices_) {
+                const auto& expected = original.vertices_[
+                    original.indices_[offset++]
+                ];
+                ASSERT_EQ(part.mesh_.vertices_[index], expected);
+            }
+        }
+        ASSERT_EQ(offset, original.indices_.size());
+    }
+
+    TEST(DaltestScene, SelectSkinFormat) {
+        using Format = dalp::VertexFormat;
+
+        dalp::Mesh_IndexedJoint mesh;
+        auto& a = mesh.vertices_.emplace_back();
+        a.joint_indices_ = glm::ivec4(3, -1, -1, -1);
+        a.joint_weights_ = glm::vec4(1, 0, 0, 0);
+        auto& b = mesh.vertices_.emplace_back();
+        b.joint_indices_ = glm::ivec4(7, 2, 9, -1);
+        b.joint_weights_ = glm::vec4(0.7f, 0.3f, 0, 0);
+
+        dalp::select_skin_format(mesh);
+        ASSERT_EQ(mesh.vertex_format_.influences_, 2);
+        ASSERT_EQ(mesh.vertex_format_.joint_index_, Format::JointIndex::uint8);
+        ASSERT_EQ(
+            mesh.vertex_format_.joint_weight_, Format::JointWeight::unorm8
+        );
+
+        mesh.vertices_[0].joint_indices_ = glm::ivec4(3, 300, 1, -1);
+        mesh.vertices_[0].joint_weights_ = glm::vec4(0.5f, 0.25f, 0.25f, 0);
+        dalp::SkinFormatOptions options;
+        options.max_weight_error_ = 0.0001f;
+        dalp::select_skin_format(mesh, options);
+        ASSERT_EQ(mesh.vertex_format_.influences_, 4);
+        ASSERT_EQ(
+            mesh.vertex_format_.joint_index_, Format::JointIndex::uint16
+        );
+        ASSERT_EQ(
+            mesh.vertex_format_.joint_weight_, Format::JointWeight::unorm16
+        );
+    }
+
+    TEST(DaltestScene, ComputeBounds) {
+        dalp::Model model;
+
+        // Big enough to be split into several tasks
+        auto& grid = model.units_indexed_joint_.emplace_back();
+        grid.mesh_ = ::make_grid_mesh<dalp::VertexJoint>(200);
+        for (auto& vert : grid.mesh_.vertices_)
+            vert.pos_ = vert.pos_ * 4.f + glm::vec3(-1, 2, 0);
+        grid.mesh_.vertices_[12345].pos_.z = 5;
+
+        auto& straight = model.units_straight_.emplace_back();
+        straight.mesh_.vertices_ = { 1, 1, 1, -3, 0, 2, 0, 0, 0 };
+
+        model.units_indexed_.emplace_back();
+
+        dalp::compute_bounds(model);
+
+        auto expected_min = grid.mesh_.vertices_[0].pos_;
+        auto expected_max = expected_min;
+        for (auto& vert : grid.mesh_.vertices_) {
+            expected_min = glm::min(expected_min, vert.pos_);
+            expected_max = glm::max(expected_max, vert.pos_);
+        }
+        ASSERT_EQ(grid.aabb_.min_, expected_min);
+        ASSERT_EQ(grid.aabb_.max_, expected_max);
+        ASSERT_EQ(grid.aabb_.max_, glm::vec3(3, 6, 5));
+
+        ASSERT_EQ(straight.aabb_.min_, glm::vec3(-3, 0, 0));
+        ASSERT_EQ(straight.aabb_.max_, glm::vec3(1, 1, 2));
+        ASSERT_EQ(model.aabb_.min_, glm::vec3(-3, 0, expected_min.z));
+        ASSERT_EQ(model.aabb_.max_, glm::vec3(3, 6, 5));
+
+        // Empty units are ignored
+        ASSERT_EQ(model.units_indexed_[0].sphere_.radius_, 0);
+
+        for (auto& vert : grid.mesh_.vertices_) {
+            const auto d = glm::distance(vert.pos_, grid.sphere_.center_);
+            ASSERT_LE(d, grid.sphere_.radius_ * 1.000001f);
+        }
+        ASSERT_EQ(straight.sphere_.center_, glm::vec3(-1, 0.5f, 1));
+        ASSERT_FLOAT_EQ(straight.sphere_.radius_, std::sqrt(4.f + 0.25f + 1));
+    }
+
+    TEST(DaltestScene, ConvertInstancing) {
+        using scene_t = dalp::SceneIntermediate;
+
+        scene_t scene;
+        scene.materials_.emplace_back().name_ = "rock";
+        auto& ground_material = scene.materials_.emplace_back();
+        ground_material.name_ = "ground";
+        ground_material.roughness_ = 1;
+
+        scene.meshes_.resize(2);
+        auto& rock = scene.meshes_[0];
+        rock.name_ = "rock";
+        for (int i = 0; i < 4; ++i) {
+            auto& vert = rock.vertices_.emplace_back();
+            vert.pos_ = glm::vec3(i % 2, i / 2, 0);
+            vert.normal_ = glm::vec3(0, 0, 1);
+        }
+        rock.indices_ = { 0, 1, 2, 1, 3, 2 };
+
+        auto& ground = scene.meshes_[1];
+        ground.name_ = "ground";
+        ground.vertices_ = { rock.vertices_[0], rock.vertices_[1] };
+        ground.vertices_.push_back(rock.vertices_[2]);
+        ground.indices_ = { 0, 1, 2 };
+
+        for (int i = 0; i < 5; ++i) {
+            auto& actor = scene.mesh_actors_.emplace_back();
+            actor.name_ = "rock" + std::to_string(i);
+            actor.transform_.pos_ = glm::vec3(10 * i, 0, 0);
+            actor.render_pairs_.push_back({ "rock", "rock" });
+        }
+        auto& ground_actor = scene.mesh_actors_.emplace_back();
+        ground_actor.name_ = "ground";
+        ground_actor.transform_.scale_ = glm::vec3(50);
+        ground_actor.render_pairs_.push_back({ "ground", "ground" });
+
+        dalp::ModelConvertOptions options;
+        options.instancing_.emplace().max_baked_vertices_ = 8;
+        const auto model = dalp::convert_to_model_dmd(scene, options);
+
+        ASSERT_EQ(model.units_indexed_.size(), 2);
+        const auto& baked = model.units_indexed_[0];
+        ASSERT_EQ(baked.name_, "ground");
+        ASSERT_TRUE(baked.instances_.empty());
+        ASSERT_EQ(baked.mesh_.vertices_[1].pos_, glm::vec3(50, 0, 0));
+
+        const auto& instanced = model.units_indexed_[1];
+        ASSERT_EQ(instanced.name_, "rock");
+        ASSERT_EQ(instanced.mesh_.vertices_.size(), 4);
+        const std::vector<uint32_t> local_indices{ 0, 1, 2, 1, 3, 2 };
+        ASSERT_EQ(instanced.mesh_.indices_, local_indices);
+        ASSERT_EQ(instanced.aabb_.max_, glm::vec3(1, 1, 0));
+        ASSERT_EQ(instanced.instances_.size(), 5);
+        ASSERT_EQ(instanced.instances_[3][3], glm::vec4(30, 0, 0, 1));
+
+        // Bounds cover every instance
+        ASSERT_EQ(model.aabb_.max_, glm::vec3(50, 50, 0));
+        auto far_scene = scene;
+        far_scene.mesh_actors_[4].transform_.pos_ = glm::vec3(100, 0, 0);
+        const auto far_model = dalp::convert_to_model_dmd(far_scene, options);
+        ASSERT_EQ(far_model.aabb_.max_, glm::vec3(101, 50, 0));
+
+        // Under the threshold everything is baked like without options
+        options.instancing_->max_baked_vertices_ = 20;
+        for (auto& x : { dalp::convert_to_model_dmd(scene, options),
+                         dalp::convert_to_model_dmd(scene) }) {
+            ASSERT_EQ(x.units_indexed_.size(), 2);
+            ASSERT_TRUE(x.units_indexed_[0].instances_.empty());
+            ASSERT_EQ(x.units_indexed_[0].mesh_.vertices_.size(), 20);
+        }
+
+        // Units only merge with ones drawn by the same instances
+        auto units = model.units_indexed_;
+        units[1].material_ = units[0].material_;
+        ASSERT_EQ(dalp::merge_by_material(units).size(), 2);
+    }
+
+    TEST(DaltestScene, RemoveDuplicateMeshes) {
+        using scene_t = dalp::SceneIntermediate;
+
+        scene_t scene;
+        scene.materials_.emplace_back().name_ = "mat";
+
+        scene_t::Mesh cube;
+        for (int i = 0; i < 3; ++i) {
+            auto& vert = cube.vertices_.emplace_back();
+            vert.pos_ = glm::vec3(i == 1, i == 2, 0);
+            vert.normal_ = glm::vec3(0, 0, 1);
+        }
+        cube.indices_ = { 0, 1, 2 };
+
+        for (auto name : { "Cube", "Cube.001", "Cube.002", "Other", "Skin" }) {
+            auto& mesh = scene.meshes_.emplace_back(cube);
+            mesh.name_ = name;
+
+            auto& actor = scene.mesh_actors_.emplace_back();
+            actor.name_ = name;
+            actor.transform_.pos_.x = 5 * scene.mesh_actors_.size();
+            actor.render_pairs_.push_back({ name, "mat" });
+        }
+        scene.meshes_[3].vertices_[2].uv_.x = 0.5f;
+        scene.meshes_[4].skeleton_name_ = "armature";
+
+        ASSERT_EQ(dalp::remove_duplicate_meshes(scene), 2);
+        ASSERT_EQ(scene.meshes_.size(), 3);
+        ASSERT_EQ(scene.meshes_[0].name_, "Cube");
+        ASSERT_EQ(scene.meshes_[1].name_, "Other");
+        ASSERT_EQ(scene.meshes_[2].name_, "Skin");
+
+        const std::vector<std::string> expected_names{
+            "Cube", "Cube", "Cube", "Other", "Skin"
+        };
+        for (size_t i = 0; i < expected_names.size(); ++i) {
+            const auto& pair = scene.mesh_actors_[i].render_pairs_[0];
+            ASSERT_EQ(pair.mesh_name_, expected_names[i]);
+        }
+        ASSERT_EQ(dalp::remove_duplicate_meshes(scene), 0);
+
+        // Now the copies can be instanced
+        dalp::ModelConvertOptions options;
+        options.instancing_.emplace().max_baked_vertices_ = 0;
+        const auto model = dalp::convert_to_model_dmd(scene, options);
+        size_t instance_count = 0;
+        for (auto& unit : model.units_indexed_)
+            instance_count += unit.instances_.size();
+        ASSERT_EQ(instance_count, 3);
+    }
+
+    TEST(DaltestScene, ConvertBatching) {
+        using scene_t = dalp::SceneIntermediate;
+
+        scene_t scene;
+        scene.materials_.emplace_back().name_ = "mat";
+        auto& mesh = scene.meshes_.emplace_back();
+        mesh.name_ = "tri";
+        for (int i = 0; i < 3; ++i) {
+            auto& vert = mesh.vertices_.emplace_back();
+            vert.pos_ = glm::vec3(i == 1, i == 2, 0);
+            vert.normal_ = glm::vec3(0, 0, 1);
+        }
+        mesh.indices_ = { 0, 1, 2 };
+
+        // 10 by 10 actors 10 apart
+        for (int i = 0; i < 100; ++i) {
+            auto& actor = scene.mesh_actors_.emplace_back();
+            actor.name_ = "tri" + std::to_string(i);
+            actor.transform_.pos_ = glm::vec3(i % 10, i / 10, 0) * 10.f;
+            actor.render_pairs_.push_back({ "tri", "mat" });
+        }
+
+        const auto count_vertices = [](const dalp::Model& model) {
+            size_t output = 0;
+            for (auto& unit : model.units_indexed_)
+                output += unit.mesh_.vertices_.size();
+            return output;
+        };
+
+        const auto merged = dalp::convert_to_model_dmd(scene);
+        ASSERT_EQ(merged.units_indexed_.size(), 1);
+        ASSERT_EQ(count_vertices(merged), 300);
+
+        dalp::ModelConvertOptions options;
+        auto& batching = options.batching_.emplace();
+        batching.cell_size_ = 50;
+        const auto grid = dalp::convert_to_model_dmd(scene, options);
+        ASSERT_EQ(grid.units_indexed_.size(), 4);
+        ASSERT_EQ(count_vertices(grid), 300);
+        for (auto& unit : grid.units_indexed_) {
+            ASSERT_EQ(unit.mesh_.vertices_.size(), 75);
+            const auto extent = unit.aabb_.max_ - unit.aabb_.min_;
+            ASSERT_LT(extent.x, 50);
+            ASSERT_LT(extent.y, 50);
+        }
+
+        batching.max_vertices_ = 30;
+        const auto bounded = dalp::convert_to_model_dmd(scene, options);
+        ASSERT_EQ(bounded.units_indexed_.size(), 12);
+        ASSERT_EQ(count_vertices(bounded), 300);
+        for (auto& unit : bounded.units_indexed_)
+            ASSERT_LE(unit.mesh_.vertices_.size(), 30);
+
+        batching.clustering_ = dalp::BatchingOptions::Clustering::kmeans;
+        batching.cluster_count_ = 4;
+        batching.max_vertices_ = 1000;
+        const auto kmeans = dalp::convert_to_model_dmd(scene, options);
+        ASSERT_EQ(kmeans.units_indexed_.size(), 4);
+        ASSERT_EQ(count_vertices(kmeans), 300);
+        for (auto& unit : kmeans.units_indexed_) {
+            const auto extent = unit.aabb_.max_ - unit.aabb_.min_;
+            ASSERT_LT(extent.x * extent.y, 91 * 91 / 2);
+        }
+
+        // Far beyond the int32 range of cells on either side
+        scene.mesh_actors_.resize(2);
+        scene.mesh_actors_[0].transform_.pos_ = glm::vec3(-1e30f, 0, 0);
+        scene.mesh_actors_[1].transform_.pos_ = glm::vec3(1e30f, 0, 0);
+        batching.clustering_ = dalp::BatchingOptions::Clustering::grid;
+        const auto far = dalp::convert_to_model_dmd(scene, options);
+        ASSERT_EQ(far.units_indexed_.size(), 2);
+    }
+
+
+    TEST(DaltestScene, SplitIntoTiles) {
+        using scene_t = dalp::SceneIntermediate;
+
+        scene_t scene;
+        scene.materials_.emplace_back().name_ = "mat";
+        scene.materials_.emplace_back().name_ = "unused";
+        auto& mesh = scene.meshes_.emplace_back();
+        mesh.name_ = "tri";
+        for (int i = 0; i < 3; ++i) {
+            auto& vert = mesh.vertices_.emplace_back();
+            vert.pos_ = glm::vec3(i == 1, 0, i == 2);
+        }
+        mesh.indices_ = { 0, 1, 2 };
+
+        // 10 by 10 actors 10 apart on the ground
+        for (int i = 0; i < 100; ++i) {
+            auto& actor = scene.mesh_actors_.emplace_back();
+            actor.name_ = "tri" + std::to_string(i);
+            actor.transform_.pos_ = glm::vec3(i % 10, 0, i / 10) * 10.f;
+            actor.render_pairs_.push_back({ "tri", "mat" });
+        }
+        // Placed by its parent far away from where it is defined
+        auto& child = scene.mesh_actors_.emplace_back();
+        child.name_ = "child";
+        child.parent_name_ = "tri99";
+        child.transform_.pos_ = glm::vec3(-85, 0, -85);
+        child.render_pairs_.push_back({ "tri", "mat" });
+
+        auto& lamp = scene.plights_.emplace_back();
+        lamp.name_ = "lamp";
+        lamp.transform_.pos_ = glm::vec3(45, 5, 45);
+        lamp.max_distance_ = 10;
+        scene.dlights_.emplace_back().name_ = "sun";
+
+        dalp::TilingOptions options;
+        options.tile_size_ = 50;
+        const auto grid = dalp::split_into_tiles(scene, options);
+        ASSERT_EQ(grid.index_.tiles_.size(), 4);
+        const std::vector<std::string> global_lights{ "sun" };
+        ASSERT_EQ(grid.index_.global_lights_, global_lights);
+
+        size_t actor_count = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            auto& tile = grid.index_.tiles_[i];
+            auto& tile_scene = grid.scenes_[i];
+            ASSERT_EQ(tile_scene.meshes_.size(), 1);
+            ASSERT_EQ(tile_scene.materials_.size(), 1);
+            ASSERT_LE(tile.bounds_.max_.x - tile.bounds_.min_.x, 50);
+
+            const auto model = dalp::convert_to_model_dmd(tile_scene);
+            ASSERT_EQ(model.units_indexed_.size(), 1);
+            for (auto& v : model.units_indexed_[0].mesh_.vertices_) {
+                ASSERT_GE(v.pos_.x, tile.bounds_.min_.x);
+                ASSERT_LE(v.pos_.x, tile.bounds_.max_.x);
+            }
+            actor_count += model.units_indexed_[0].mesh_.vertices_.size() / 3;
+        }
+        // The parent of "child" renders only in its own tile
+        ASSERT_EQ(actor_count, 101);
+
+        // The lamp in tile "0_0" reaches its three neighbors
+        ASSERT_EQ(grid.index_.tiles_[0].name_, "0_0");
+        ASSERT_EQ(grid.index_.tiles_[0].lights_[0], "lamp");
+        ASSERT_TRUE(grid.index_.tiles_[0].dependencies_.empty());
+        for (size_t i = 1; i < 4; ++i) {
+            const std::vector<uint32_t> expected{ 0 };
+            ASSERT_EQ(grid.index_.tiles_[i].dependencies_, expected);
+        }
+
+        options.partition_ = dalp::TilingOptions::Partition::quadtree;
+        options.tile_size_ = 10;
+        options.max_actors_ = 30;
+        const auto quadtree = dalp::split_into_tiles(scene, options);
+        size_t item_count = 0;
+        for (auto& tile_scene : quadtree.scenes_) {
+            size_t count = tile_scene.plights_.size();
+            for (auto& actor : tile_scene.mesh_actors_)
+                count += actor.render_pairs_.empty() ? 0 : 1;
+            ASSERT_LE(count, 30);
+            item_count += count;
+        }
+        ASSERT_EQ(item_count, 102);
+
+        // Index round trip
+        auto index = grid.index_;
+        index.tiles_[1].file_name_ = "level_0_1.dmd";
+        const auto json = dalp::build_tile_index_json(index);
+        const auto parsed = dalp::parse_tile_index_json(
+            reinterpret_cast<const uint8_t*>(json.data()), json.size()
+        );
+        ASSERT_TRUE(parsed.has_value());
+        ASSERT_EQ(parsed->tiles_.size(), 4);
+        ASSERT_EQ(parsed->tiles_[1].file_name_, "level_0_1.dmd");
+        ASSERT_EQ(parsed->tiles_[1].dependencies_, std::vector<uint32_t>{ 0 });
+        ASSERT_EQ(parsed->tiles_[0].lights_, index.tiles_[0].lights_);
+        ASSERT_EQ(parsed->tiles_[2].bounds_.max_, index.tiles_[2].bounds_.max_);
+        ASSERT_EQ(parsed->global_lights_, index.global_lights_);
+
+        const std::string broken = "{ \"tiles\": [ { \"name\": 1 } ] }";
+        ASSERT_FALSE(dalp::parse_tile_index_json(
+            reinterpret_cast<const uint8_t*>(broken.data()), broken.size()
+        ));
+    }
+
+
+    TEST(DaltestScene, SplitIntoTilesDegenerateSize) {
+        using scene_t = dalp::SceneIntermediate;
+
+        scene_t scene;
+        scene.materials_.emplace_back().name_ = "mat";
+        auto& mesh = scene.meshes_.emplace_back();
+        mesh.name_ = "tri";
+        for (int i = 0; i < 3; ++i) {
+            auto& vert = mesh.vertices_.emplace_back();
+            vert.pos_ = glm::vec3(i == 1, 0, i == 2);
+        }
+        mesh.indices_ = { 0, 1, 2 };
+
+        // More coincident actors than a quadtree tile may hold
+        for (int i = 0; i < 10; ++i) {
+            auto& actor = scene.mesh_actors_.emplace_back();
+            actor.name_ = "tri" + std::to_string(i);
+            actor.render_pairs_.push_back({ "tri", "mat" });
+        }
+
+        using Partition = dalp::TilingOptions::Partition;
+        for (const auto partition : { Partition::grid, Partition::quadtree }) {
+            for (const auto size : { 0.f, -1.f }) {
+                dalp::TilingOptions options;
+                options.partition_ = partition;
+                options.tile_size_ = size;
+                options.max_actors_ = 2;
+                const auto tiles = dalp::split_into_tiles(scene, options);
+                ASSERT_EQ(tiles.scenes_.size(), 1);
+                ASSERT_EQ(tiles.scenes_[0].mesh_actors_.size(), 10);
+            }
+        }
+    }
+
+}  // namespace
+
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}